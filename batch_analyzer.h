@@ -0,0 +1,374 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "engine.h"
+
+using namespace std;
+
+// Analyzes a stream of positions on a pool of threads, each with its own engine, and writes the results in input order.
+// Each thread takes between about 24 and 76 MB (see engine.h), so the number of threads is limited by memory as well as by cores.
+// The moves leading to a position are played out with no thinking time, so they never run the endgame solver.
+
+// INPUT: one position per line: the columns of the moves reaching it (a-g, e.g. "ddce", or "-" for the empty board),
+// optionally followed by limits for that position only: "depth=<n>" (max_depth_limit), "nodes=<n>" (max_nodes_per_move)
+// and/or "time=<seconds>" (thinking_time). Limits that aren't given are the defaults sent to the constructor. Blank lines are skipped.
+// OUTPUT: one line per position, "<columns> evaluation=<e> best=<column> depth=<d> nodes=<n>", where the evaluation is from the
+// perspective of the player to move, and nodes is how many positions the last search created. If a position can't be analyzed
+// (e.g., a column is full, or the game ends before its last move), its line is "<columns> error=<reason>" instead. A line is written as soon as it
+// and every line before it are done.
+
+struct analysis_limits
+{
+    int max_depth_limit;
+    int max_nodes_per_move; // 0 for no limit.
+    double thinking_time;
+};
+
+struct analysis_request
+{
+    string columns; // as given in the input.
+    vector<coordinate> moves; // the moves the columns stand for.
+    analysis_limits limits;
+    string error; // why the line couldn't be parsed (empty if it could).
+};
+
+struct analysis_result
+{
+    int evaluation;
+    int best_column; // -1 if the game is already over.
+    int depth;
+    long long nodes;
+};
+
+class batch_analyzer
+{
+public:
+    // Constructors:
+
+    batch_analyzer(int number_of_threadsP, const analysis_limits& default_limitsP);
+
+    // Helpers:
+    void analyze(istream& input, ostream& output); // returns once every position in input has been written to output.
+
+    // Public static methods:
+    static analysis_request parse_request(const string& line, const analysis_limits& default_limits);
+    static analysis_result analyze_position(engine& analyzing_engine, const analysis_request& request);
+    static string format_result(const analysis_request& request, const analysis_result& result);
+
+private:
+    // Private variables:
+    int number_of_threads;
+    analysis_limits default_limits;
+
+    // Shared by analyze() and the worker threads (all guarded by queue_mutex):
+    mutex queue_mutex;
+    condition_variable queue_changed;
+    deque<pair<int, analysis_request>> waiting_requests; // with their line number (counting only the positions).
+    bool is_input_finished;
+    map<int, string> finished_lines; // results that can't be written yet, since an earlier position isn't done.
+    int next_line_to_write;
+
+    // Private methods:
+    void run_worker(ostream& output);
+};
+
+// CONSTRUCTORS:
+
+batch_analyzer::batch_analyzer(int number_of_threadsP, const analysis_limits& default_limitsP)
+{
+    number_of_threads = max(1, number_of_threadsP);
+
+    default_limits = default_limitsP;
+
+    is_input_finished = false;
+
+    next_line_to_write = 0;
+}
+
+// HELPERS:
+
+void batch_analyzer::analyze(istream& input, ostream& output)
+{
+    is_input_finished = false;
+    finished_lines.clear();
+    next_line_to_write = 0;
+
+    vector<thread> workers;
+
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        workers.push_back(thread(&batch_analyzer::run_worker, this, ref(output)));
+    }
+
+    string line;
+
+    int line_number = 0;
+
+    while (getline(input, line))
+    {
+        if (line.find_first_not_of(" \t\r") == string::npos)
+        {
+            continue;
+        }
+
+        analysis_request request;
+
+        try
+        {
+            request = parse_request(line, default_limits);
+        }
+
+        catch (const exception& error) // the position's output line will say what was wrong (see run_worker()).
+        {
+            istringstream(line) >> request.columns;
+
+            request.error = error.what();
+        }
+
+        {
+            lock_guard<mutex> lock(queue_mutex);
+
+            waiting_requests.push_back({line_number, request});
+        }
+
+        queue_changed.notify_one();
+
+        line_number ++;
+    }
+
+    {
+        lock_guard<mutex> lock(queue_mutex);
+
+        is_input_finished = true;
+    }
+
+    queue_changed.notify_all();
+
+    for (thread& worker: workers)
+    {
+        worker.join();
+    }
+}
+
+// PUBLIC STATIC METHODS:
+
+analysis_request batch_analyzer::parse_request(const string& line, const analysis_limits& default_limits)
+{
+    analysis_request request;
+    request.limits = default_limits;
+
+    istringstream words(line);
+
+    words >> request.columns;
+
+    vector<int> pieces_per_column(position::max_col_index + 1, 0);
+
+    for (char c: (request.columns == "-") ? string() : request.columns)
+    {
+        int col = tolower(c) - 'a';
+
+        if (col < 0 || col > position::max_col_index || pieces_per_column[col] > position::max_row_index)
+        {
+            throw runtime_error("Invalid column in the moves sent to batch_analyzer::parse_request()\n");
+        }
+
+        request.moves.push_back({position::max_row_index - pieces_per_column[col], col});
+
+        pieces_per_column[col] ++;
+    }
+
+    string word;
+
+    while (words >> word)
+    {
+        size_t equals_sign = word.find('=');
+
+        string name = word.substr(0, equals_sign);
+        string value = (equals_sign == string::npos) ? "" : word.substr(equals_sign + 1);
+
+        if (value.empty())
+        {
+            throw runtime_error("Limit without a value sent to batch_analyzer::parse_request()\n");
+        }
+
+        if (name == "depth")
+        {
+            request.limits.max_depth_limit = stoi(value);
+        }
+
+        else if (name == "nodes")
+        {
+            request.limits.max_nodes_per_move = stoi(value);
+        }
+
+        else if (name == "time")
+        {
+            request.limits.thinking_time = stod(value);
+        }
+
+        else
+        {
+            throw runtime_error("Unknown limit sent to batch_analyzer::parse_request()\n");
+        }
+    }
+
+    return request;
+}
+
+analysis_result batch_analyzer::analyze_position(engine& analyzing_engine, const analysis_request& request)
+{
+    // Like get_to_chosen_starting_position() in main.cpp: play out the moves without thinking (to get the amplifying vectors),
+    // then think on the last position with the limits. The player to move at the end is 'C', so the evaluation is from their
+    // perspective.
+
+    analyzing_engine.set_thinking_time(0);
+    analyzing_engine.set_max_nodes_per_move(0);
+
+    bool does_comp_move_first = request.moves.size() % 2 == 0;
+
+    unique_ptr<position> pt = analyzing_engine.think_on_game_position(does_comp_move_first, true);
+
+    for (int i = 0; i < static_cast<int>(request.moves.size()); i++)
+    {
+        if (i == static_cast<int>(request.moves.size()) - 1)
+        {
+            analyzing_engine.set_thinking_time(request.limits.thinking_time);
+            analyzing_engine.set_max_depth_limit(request.limits.max_depth_limit);
+            analyzing_engine.set_max_nodes_per_move(request.limits.max_nodes_per_move);
+        }
+
+        vector<vector<char>> temp_board = pt->get_board();
+
+        temp_board[request.moves[i].row][request.moves[i].col] = pt->get_is_comp_turn() ? 'C' : 'U';
+
+        long long nodes_before = analyzing_engine.get_number_of_nodes();
+
+        pt = analyzing_engine.think_on_game_position(temp_board, !pt->get_is_comp_turn(), request.moves[i], pt->get_squares_amplifying_comp_2(),
+                                                     pt->get_squares_amplifying_comp_3(), pt->get_squares_amplifying_user_2(),
+                                                     pt->get_squares_amplifying_user_3(), true);
+
+        if (pt->did_computer_win() || pt->did_opponent_win() || pt->is_game_drawn())
+        {
+            if (i != static_cast<int>(request.moves.size()) - 1)
+            {
+                throw runtime_error("The game is over before the last move sent to batch_analyzer::analyze_position()\n");
+            }
+
+            return {pt->get_evaluation(), -1, 0, analyzing_engine.get_number_of_nodes() - nodes_before};
+        }
+
+        if (i == static_cast<int>(request.moves.size()) - 1)
+        {
+            analysis_result result;
+            result.evaluation = pt->get_evaluation();
+            result.depth = pt->find_multi_pv().depth;
+            result.best_column = analyzing_engine.find_best_move_for_comp(*pt).col;
+            result.nodes = analyzing_engine.get_number_of_nodes() - nodes_before;
+
+            return result;
+        }
+    }
+
+    // No moves, so it's the empty board:
+
+    long long nodes_before = analyzing_engine.get_number_of_nodes();
+
+    analyzing_engine.set_thinking_time(request.limits.thinking_time);
+    analyzing_engine.set_max_depth_limit(request.limits.max_depth_limit);
+    analyzing_engine.set_max_nodes_per_move(request.limits.max_nodes_per_move);
+
+    pt = analyzing_engine.think_on_game_position(true, true);
+
+    return {pt->get_evaluation(), analyzing_engine.find_best_move_for_comp(*pt).col, pt->find_multi_pv().depth,
+            analyzing_engine.get_number_of_nodes() - nodes_before};
+}
+
+string batch_analyzer::format_result(const analysis_request& request, const analysis_result& result)
+{
+    ostringstream line;
+
+    line << request.columns << " evaluation=" << result.evaluation << " best="
+         << (result.best_column == -1 ? '-' : static_cast<char>('a' + result.best_column)) << " depth=" << result.depth
+         << " nodes=" << result.nodes;
+
+    return line.str();
+}
+
+// PRIVATE METHODS:
+
+void batch_analyzer::run_worker(ostream& output)
+{
+    engine analyzing_engine;
+
+    analyzing_engine.set_number_of_defence_threads(1); // the other cores are busy with their own positions.
+
+    while (true)
+    {
+        pair<int, analysis_request> job;
+
+        {
+            unique_lock<mutex> lock(queue_mutex);
+
+            queue_changed.wait(lock, [this]() {return !waiting_requests.empty() || is_input_finished;});
+
+            if (waiting_requests.empty())
+            {
+                return;
+            }
+
+            job = waiting_requests.front();
+
+            waiting_requests.pop_front();
+        }
+
+        string reason = job.second.error;
+
+        string line;
+
+        if (reason.empty())
+        {
+            try
+            {
+                line = format_result(job.second, analyze_position(analyzing_engine, job.second));
+            }
+
+            catch (const runtime_error& error)
+            {
+                reason = error.what();
+            }
+        }
+
+        if (!reason.empty())
+        {
+            reason.erase(remove(reason.begin(), reason.end(), '\n'), reason.end());
+
+            line = job.second.columns + " error=" + reason;
+        }
+
+        lock_guard<mutex> lock(queue_mutex);
+
+        finished_lines[job.first] = line;
+
+        // Write every line that's ready, in order:
+
+        while (!finished_lines.empty() && finished_lines.begin()->first == next_line_to_write)
+        {
+            output << finished_lines.begin()->second << "\n" << flush;
+
+            finished_lines.erase(finished_lines.begin());
+
+            next_line_to_write ++;
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "bitboard.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define BATCH_EVALUATOR_HAS_AVX2_KERNEL
+#endif
+
+using namespace std;
+
+// Scores every move of a position in one pass, for ordering the moves one ply before depth_limit (where every future
+// position is a leaf). This is only a move ordering heuristic: the leaves themselves are still evaluated one at a time by
+// position::evaluate_at_depth_limit(), so it changes which moves get pruned, but not any leaf's evaluation. A move's score is from the perspective of the player making the move: threat_value for each of their
+// threat squares (squares that would make a 4-in-a-row) after the move, plus good_threat_bonus for each one on a row that suits
+// them (odd rows, counting from the bottom, for whoever moved first, and even rows for the other player), minus the same for
+// the opponent.
+
+// All the work is bitboard shifts and ANDs (the same as bitboard::compute_winning_squares()), so on CPUs with AVX2 it's done
+// for 4 moves at once, one move per 64-bit lane. Otherwise (or if the program wasn't compiled with GCC for x86-64), each move
+// is scored on its own. Both give exactly the same scores ("check_move_ordering_kernels" in main.cpp checks this).
+
+// The leaves aren't evaluated in batches on purpose. smart_evaluation() goes through the amplifying vectors in order, and whether a
+// square counts (and how much) depends on the squares counted before it, so it can't be split into lanes. And a leaf's amplifying
+// vectors only exist once the leaf has been constructed and its last move analyzed, one at a time, in between alpha-beta cutoffs.
+// A leaf evaluation is a few percent of a search anyways (see the search profiler), so there's little for a batch to save.
+
+class batch_evaluator
+{
+public:
+    // Public static methods:
+
+    static void evaluate_moves(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores);
+    // Fills scores with the score of each move in move_bits (the bit of the square the piece lands on), using the AVX2 kernel if
+    // the CPU has it.
+
+    static void evaluate_moves_scalar(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores);
+    static void evaluate_moves_avx2(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores);
+    // The two kernels evaluate_moves() picks between. Only call evaluate_moves_avx2() if is_avx2_supported is true.
+
+    static bool find_is_avx2_supported();
+
+    // Public static variables:
+    static const bool is_avx2_supported; // true if the CPU (and compiler) can run the AVX2 kernel.
+    static const uint64_t odd_rows_mask; // the squares on rows 1, 3 and 5 (counting from the bottom), which suit the first player.
+    static const int threat_value;
+    static const int good_threat_bonus;
+
+private:
+    // Private static methods:
+
+    static int score_from_threats(uint64_t mover_threats, uint64_t opponent_threats, bool is_mover_first_player);
+};
+
+// Initializing the static variables:
+
+const bool batch_evaluator::is_avx2_supported = batch_evaluator::find_is_avx2_supported();
+const uint64_t batch_evaluator::odd_rows_mask = bitboard::bottom_mask * ((1ULL << 0) | (1ULL << 2) | (1ULL << 4));
+const int batch_evaluator::threat_value = 10;
+const int batch_evaluator::good_threat_bonus = 10;
+
+// PUBLIC STATIC METHODS:
+
+void batch_evaluator::evaluate_moves(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores)
+{
+    if (is_avx2_supported)
+    {
+        evaluate_moves_avx2(parent, move_bits, scores);
+    }
+
+    else
+    {
+        evaluate_moves_scalar(parent, move_bits, scores);
+    }
+}
+
+void batch_evaluator::evaluate_moves_scalar(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores)
+{
+    scores.resize(move_bits.size());
+
+    bool is_mover_first_player = parent.number_of_moves % 2 == 0;
+
+    uint64_t opponent_pieces = parent.all_pieces ^ parent.current_pieces;
+
+    for (int i = 0; i < static_cast<int>(move_bits.size()); i++)
+    {
+        uint64_t mask = parent.all_pieces | move_bits[i];
+
+        uint64_t mover_threats = bitboard::compute_winning_squares(parent.current_pieces | move_bits[i], mask);
+        uint64_t opponent_threats = bitboard::compute_winning_squares(opponent_pieces, mask);
+
+        scores[i] = score_from_threats(mover_threats, opponent_threats, is_mover_first_player);
+    }
+}
+
+#ifdef BATCH_EVALUATOR_HAS_AVX2_KERNEL
+
+__attribute__((target("avx2"))) static inline __m256i find_winning_squares_avx2(__m256i pieces, __m256i mask)
+{
+    // The same as bitboard::compute_winning_squares(), on 4 boards at once.
+
+    __m256i r = _mm256_and_si256(_mm256_and_si256(_mm256_slli_epi64(pieces, 1), _mm256_slli_epi64(pieces, 2)),
+                                 _mm256_slli_epi64(pieces, 3));
+
+    for (int shift: {bitboard::height + 1, bitboard::height, bitboard::height + 2})
+    {
+        __m256i p = _mm256_and_si256(_mm256_slli_epi64(pieces, shift), _mm256_slli_epi64(pieces, 2 * shift));
+
+        r = _mm256_or_si256(r, _mm256_and_si256(p, _mm256_slli_epi64(pieces, 3 * shift)));
+        r = _mm256_or_si256(r, _mm256_and_si256(p, _mm256_srli_epi64(pieces, shift)));
+
+        p = _mm256_and_si256(_mm256_srli_epi64(pieces, shift), _mm256_srli_epi64(pieces, 2 * shift));
+
+        r = _mm256_or_si256(r, _mm256_and_si256(p, _mm256_slli_epi64(pieces, shift)));
+        r = _mm256_or_si256(r, _mm256_and_si256(p, _mm256_srli_epi64(pieces, 3 * shift)));
+    }
+
+    return _mm256_andnot_si256(mask, _mm256_and_si256(r, _mm256_set1_epi64x(bitboard::board_mask)));
+}
+
+__attribute__((target("avx2"))) void batch_evaluator::evaluate_moves_avx2(const bitboard& parent, const vector<uint64_t>& move_bits,
+                                                                         vector<int>& scores)
+{
+    scores.resize(move_bits.size());
+
+    bool is_mover_first_player = parent.number_of_moves % 2 == 0;
+
+    const __m256i current_pieces = _mm256_set1_epi64x(parent.current_pieces);
+    const __m256i all_pieces = _mm256_set1_epi64x(parent.all_pieces);
+    const __m256i opponent_pieces = _mm256_set1_epi64x(parent.all_pieces ^ parent.current_pieces);
+
+    for (int first = 0; first < static_cast<int>(move_bits.size()); first += 4)
+    {
+        uint64_t lanes[4] = {0, 0, 0, 0}; // unused lanes get no move (they're evaluated, but ignored).
+
+        for (int i = first; i < first + 4 && i < static_cast<int>(move_bits.size()); i++)
+        {
+            lanes[i - first] = move_bits[i];
+        }
+
+        __m256i moves = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+
+        __m256i mask = _mm256_or_si256(all_pieces, moves);
+
+        uint64_t mover_threats[4];
+        uint64_t opponent_threats[4];
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mover_threats), find_winning_squares_avx2(_mm256_or_si256(current_pieces, moves), mask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(opponent_threats), find_winning_squares_avx2(opponent_pieces, mask));
+
+        for (int i = first; i < first + 4 && i < static_cast<int>(move_bits.size()); i++)
+        {
+            scores[i] = score_from_threats(mover_threats[i - first], opponent_threats[i - first], is_mover_first_player);
+        }
+    }
+}
+
+bool batch_evaluator::find_is_avx2_supported()
+{
+    __builtin_cpu_init(); // needed, since this runs while the static variables are initialized.
+
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+void batch_evaluator::evaluate_moves_avx2(const bitboard& parent, const vector<uint64_t>& move_bits, vector<int>& scores)
+{
+    evaluate_moves_scalar(parent, move_bits, scores); // never called, since is_avx2_supported is false.
+}
+
+bool batch_evaluator::find_is_avx2_supported()
+{
+    return false;
+}
+
+#endif
+
+// PRIVATE STATIC METHODS:
+
+int batch_evaluator::score_from_threats(uint64_t mover_threats, uint64_t opponent_threats, bool is_mover_first_player)
+{
+    uint64_t mover_good_rows = is_mover_first_player ? odd_rows_mask : bitboard::board_mask ^ odd_rows_mask;
+
+    int threats = bitboard::population_count(mover_threats) - bitboard::population_count(opponent_threats);
+
+    int good_threats = bitboard::population_count(mover_threats & mover_good_rows) -
+                       bitboard::population_count(opponent_threats & bitboard::board_mask & ~mover_good_rows);
+
+    return threat_value * threats + good_threat_bonus * good_threats;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+class bitboard // Compact 64-bit representation of a board, for the exact solvers that need to play through millions of positions.
+{
+public:
+    // Layout: each column takes 7 bits (6 squares plus 1 empty sentinel bit on top, so lines can't wrap into the next column).
+    // Bit (col * 7 + height) is the square in column col, height squares up from the bottom. In terms of the 2-D vector of char
+    // board used by the position class, height = max_row_index - row (since row 0 is the TOP row there).
+
+    // Constructors:
+
+    bitboard(); // empty board.
+
+    bitboard(const vector<vector<char>>& board, char piece_to_move);
+    // Builds the bitboard from a position's board. piece_to_move ('C' or 'U') is whose turn it is in that board.
+
+    // Helpers:
+    bool can_play(int col) const; // returns true if column col isn't full.
+    void play(int col); // plays a piece for the player whose turn it is in column col. Column must not be full.
+    void play_move_bit(uint64_t move_bit); // plays the move represented by a single bit (the square the piece lands on).
+    bool is_winning_move(int col) const; // returns true if playing in col makes a 4-in-a-row for the player whose turn it is.
+    bool can_win_next() const; // returns true if the player whose turn it is can win immediately.
+    uint64_t key() const; // unique key of the position (includes whose turn it is, implicitly through number_of_moves parity).
+    uint64_t mirrored_key() const; // key of the position reflected left-to-right.
+    uint64_t possible() const; // bitmap of the squares that can be played right now.
+    uint64_t possible_non_losing_moves() const; // playable squares that don't lose immediately. Returns 0 if every move loses.
+    uint64_t winning_squares_of_player_to_move() const; // empty squares completing a 4-in-a-row for the player whose turn it is.
+    uint64_t winning_squares_of_opponent() const; // empty squares completing a 4-in-a-row for the player who just moved.
+    int number_of_empty_squares() const;
+    int move_score(uint64_t move_bit) const; // number of winning squares the player to move would have after move_bit (for move ordering).
+
+    // Public variables:
+    uint64_t current_pieces; // pieces of the player whose turn it is.
+    uint64_t all_pieces; // every piece on the board (both players).
+    int number_of_moves; // how many pieces are on the board.
+
+    // Public static variables:
+    static const int width = 7;
+    static const int height = 6;
+    static const uint64_t bottom_mask; // bit of the bottom square of every column.
+    static const uint64_t board_mask; // every real square on the board (no sentinel bits).
+
+    // Public static methods:
+    static uint64_t top_mask_col(int col); // bit of the top square of column col.
+    static uint64_t bottom_mask_col(int col); // bit of the bottom square of column col.
+    static uint64_t column_mask(int col); // every square of column col.
+    static int bit_index(int row, int col); // bit index of board[row][col] (row 0 is the top row, as in the position class).
+    static uint64_t compute_winning_squares(uint64_t pieces, uint64_t mask);
+    // Returns every empty square that would complete a 4-in-a-row for pieces (on a board with all pieces = mask).
+    static bool has_four_in_a_row(uint64_t pieces); // returns true if pieces contains a 4-in-a-row.
+    static int population_count(uint64_t bits); // number of set bits.
+    static uint64_t mirror(uint64_t bits); // reflects a bitmap left-to-right (column 0 <-> column 6, etc).
+};
+
+// Initializing the static variables:
+
+const uint64_t bitboard::bottom_mask = 0x40810204081ULL; // bit 0 of each 7-bit column.
+const uint64_t bitboard::board_mask = bitboard::bottom_mask * ((1ULL << bitboard::height) - 1);
+
+// CONSTRUCTORS:
+
+bitboard::bitboard()
+{
+    current_pieces = 0;
+    all_pieces = 0;
+    number_of_moves = 0;
+}
+
+bitboard::bitboard(const vector<vector<char>>& board, char piece_to_move)
+{
+    current_pieces = 0;
+    all_pieces = 0;
+    number_of_moves = 0;
+
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            if (board[row][col] != ' ')
+            {
+                uint64_t square = 1ULL << bit_index(row, col);
+
+                all_pieces |= square;
+
+                number_of_moves ++;
+
+                if (board[row][col] == piece_to_move)
+                {
+                    current_pieces |= square;
+                }
+            }
+        }
+    }
+}
+
+// HELPERS:
+
+bool bitboard::can_play(int col) const
+{
+    return (all_pieces & top_mask_col(col)) == 0;
+}
+
+void bitboard::play(int col)
+{
+    play_move_bit((all_pieces + bottom_mask_col(col)) & column_mask(col));
+}
+
+void bitboard::play_move_bit(uint64_t move_bit)
+{
+    current_pieces ^= all_pieces; // switch perspective to the other player (who hasn't moved yet)...
+
+    all_pieces |= move_bit; // ...and the new piece belongs to the player who just moved, which is now the opponent.
+
+    number_of_moves ++;
+}
+
+bool bitboard::is_winning_move(int col) const
+{
+    return (winning_squares_of_player_to_move() & possible() & column_mask(col)) != 0;
+}
+
+bool bitboard::can_win_next() const
+{
+    return (winning_squares_of_player_to_move() & possible()) != 0;
+}
+
+uint64_t bitboard::key() const
+{
+    return current_pieces + all_pieces;
+}
+
+uint64_t bitboard::mirrored_key() const
+{
+    return mirror(current_pieces) + mirror(all_pieces);
+}
+
+uint64_t bitboard::possible() const
+{
+    return (all_pieces + bottom_mask) & board_mask;
+}
+
+uint64_t bitboard::possible_non_losing_moves() const
+{
+    uint64_t possible_mask = possible();
+
+    uint64_t opponent_win = winning_squares_of_opponent();
+
+    uint64_t forced_moves = possible_mask & opponent_win;
+
+    if (forced_moves)
+    {
+        if (forced_moves & (forced_moves - 1)) // opponent has two immediate wins, so nothing saves the player.
+        {
+            return 0;
+        }
+
+        possible_mask = forced_moves; // the player must block the opponent's only immediate win.
+    }
+
+    return possible_mask & ~(opponent_win >> 1); // never play directly under a square where the opponent wins.
+}
+
+uint64_t bitboard::winning_squares_of_player_to_move() const
+{
+    return compute_winning_squares(current_pieces, all_pieces);
+}
+
+uint64_t bitboard::winning_squares_of_opponent() const
+{
+    return compute_winning_squares(current_pieces ^ all_pieces, all_pieces);
+}
+
+int bitboard::number_of_empty_squares() const
+{
+    return width * height - number_of_moves;
+}
+
+int bitboard::move_score(uint64_t move_bit) const
+{
+    return population_count(compute_winning_squares(current_pieces | move_bit, all_pieces | move_bit));
+}
+
+// PUBLIC STATIC METHODS:
+
+uint64_t bitboard::top_mask_col(int col)
+{
+    return 1ULL << ((height - 1) + col * (height + 1));
+}
+
+uint64_t bitboard::bottom_mask_col(int col)
+{
+    return 1ULL << (col * (height + 1));
+}
+
+uint64_t bitboard::column_mask(int col)
+{
+    return ((1ULL << height) - 1) << (col * (height + 1));
+}
+
+int bitboard::bit_index(int row, int col)
+{
+    return col * (height + 1) + (height - 1 - row);
+}
+
+uint64_t bitboard::compute_winning_squares(uint64_t pieces, uint64_t mask)
+{
+    // Vertical (only squares directly above 3 pieces):
+
+    uint64_t r = (pieces << 1) & (pieces << 2) & (pieces << 3);
+
+    // Horizontal, then the two diagonals. For each direction, a square wins if it has 3 pieces on one side, or
+    // 2 on one side and 1 on the other.
+
+    for (int shift: {height + 1, height, height + 2})
+    {
+        uint64_t p = (pieces << shift) & (pieces << (2 * shift));
+
+        r |= p & (pieces << (3 * shift));
+        r |= p & (pieces >> shift);
+
+        p = (pieces >> shift) & (pieces >> (2 * shift));
+
+        r |= p & (pieces << shift);
+        r |= p & (pieces >> (3 * shift));
+    }
+
+    return r & (board_mask ^ mask);
+}
+
+bool bitboard::has_four_in_a_row(uint64_t pieces)
+{
+    for (int shift: {1, height, height + 1, height + 2})
+    {
+        uint64_t m = pieces & (pieces >> shift);
+
+        if (m & (m >> (2 * shift)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int bitboard::population_count(uint64_t bits)
+{
+    int count = 0;
+
+    while (bits)
+    {
+        bits &= bits - 1;
+
+        count ++;
+    }
+
+    return count;
+}
+
+uint64_t bitboard::mirror(uint64_t bits)
+{
+    uint64_t result = 0;
+
+    for (int col = 0; col < width; col++)
+    {
+        uint64_t column_bits = (bits >> (col * (height + 1))) & ((1ULL << (height + 1)) - 1);
+
+        result |= column_bits << ((width - 1 - col) * (height + 1));
+    }
+
+    return result;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include "proof_number_solver.h"
+
+using namespace std;
+
+// The threads find_best_move_for_comp() checks the losing side's defences on (see position::find_users_quickest_wins()).
+
+// Each thread has its own proof-number solver, whose table is kept between jobs like quick_win_solver's. The helper threads
+// are created the first time a job needs them, and then wait for the next job, so a move doesn't pay for starting threads.
+
+class defence_thread_pool
+{
+public:
+    // Constructors:
+
+    defence_thread_pool(int solver_TT_size_log_2P);
+
+    ~defence_thread_pool(); // stops the helper threads, and waits for them to finish.
+
+    // Helpers:
+    void run(int number_of_threads, const function<void(proof_number_solver&)>& job);
+    // Runs job on number_of_threads threads at once (the calling thread, and number_of_threads - 1 helpers), each with its own
+    // solver. Returns once every one of them has finished.
+
+private:
+    // Private variables:
+    int solver_TT_size_log_2;
+    vector<unique_ptr<proof_number_solver>> solvers; // solvers[0] is for the calling thread, and solvers[h + 1] for helper h.
+    vector<thread> helpers;
+
+    // Shared with the helpers (all guarded by job_mutex):
+    mutex job_mutex;
+    condition_variable job_started; // a new job, or the pool is stopping.
+    condition_variable job_finished; // the last helper in the job finished its part.
+    const function<void(proof_number_solver&)>* current_job;
+    long long job_number; // goes up by 1 for each job, so a helper can tell a new job from the one it already did.
+    int number_of_helpers_in_job; // helpers 0 to number_of_helpers_in_job - 1 take part in current_job.
+    int number_of_helpers_running;
+    bool is_stopping;
+
+    // Private methods:
+    void run_helper(int helper_index, long long last_job_number);
+};
+
+// CONSTRUCTORS:
+
+defence_thread_pool::defence_thread_pool(int solver_TT_size_log_2P)
+{
+    solver_TT_size_log_2 = solver_TT_size_log_2P;
+
+    current_job = nullptr;
+
+    job_number = 0;
+
+    number_of_helpers_in_job = 0;
+    number_of_helpers_running = 0;
+
+    is_stopping = false;
+}
+
+defence_thread_pool::~defence_thread_pool()
+{
+    {
+        lock_guard<mutex> lock(job_mutex);
+
+        is_stopping = true;
+    }
+
+    job_started.notify_all();
+
+    for (thread& helper: helpers)
+    {
+        helper.join();
+    }
+}
+
+// HELPERS:
+
+void defence_thread_pool::run(int number_of_threads, const function<void(proof_number_solver&)>& job)
+{
+    number_of_threads = max(1, number_of_threads);
+
+    // No helper is in a job here, so the solvers and helpers can be added to:
+
+    while (static_cast<int>(solvers.size()) < number_of_threads)
+    {
+        solvers.push_back(make_unique<proof_number_solver>(solver_TT_size_log_2));
+    }
+
+    while (static_cast<int>(helpers.size()) < number_of_threads - 1)
+    {
+        helpers.push_back(thread(&defence_thread_pool::run_helper, this, static_cast<int>(helpers.size()), job_number));
+    }
+
+    {
+        lock_guard<mutex> lock(job_mutex);
+
+        current_job = &job;
+
+        job_number ++;
+
+        number_of_helpers_in_job = number_of_threads - 1;
+        number_of_helpers_running = number_of_threads - 1;
+    }
+
+    job_started.notify_all();
+
+    job(*solvers[0]); // the calling thread does its share too.
+
+    unique_lock<mutex> lock(job_mutex);
+
+    job_finished.wait(lock, [this]() {return number_of_helpers_running == 0;});
+
+    current_job = nullptr;
+}
+
+// PRIVATE METHODS:
+
+void defence_thread_pool::run_helper(int helper_index, long long last_job_number)
+{
+    unique_lock<mutex> lock(job_mutex);
+
+    while (true)
+    {
+        job_started.wait(lock, [&]() {return is_stopping || job_number != last_job_number;});
+
+        if (is_stopping)
+        {
+            return;
+        }
+
+        last_job_number = job_number;
+
+        if (helper_index >= number_of_helpers_in_job) // a smaller job than the pool.
+        {
+            continue;
+        }
+
+        const function<void(proof_number_solver&)>& job = *current_job;
+
+        lock.unlock();
+
+        job(*solvers[helper_index + 1]);
+
+        lock.lock();
+
+        number_of_helpers_running --;
+
+        if (number_of_helpers_running == 0)
+        {
+            job_finished.notify_one();
+        }
+    }
+}
@@ -0,0 +1,769 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include "bitboard.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// FILE FORMAT of the endgame database:
+    // An endgame_database_header, then the data blocks, then the block index (one endgame_database_block_index_entry per block).
+    // The entries are sorted by canonical key. Each block stores up to entries_per_block entries, and each entry is written as a
+    // varint of ((key - previous key in the block) << 2 | outcome code), where the first entry of a block is relative to the
+    // block's first_key (so its difference is 0). Outcome codes are 0 for a loss, 1 for a draw and 2 for a win, from the
+    // perspective of the player to move.
+
+struct endgame_database_header
+{
+    char magic[8]; // "C4EGDB1" and a null character.
+    uint32_t max_empty_squares; // every reachable position with at most this many empty squares is in the database.
+    uint32_t entries_per_block;
+    uint64_t number_of_entries;
+    uint64_t number_of_blocks;
+    uint64_t index_offset; // where in the file the block index starts.
+};
+
+struct endgame_database_block_index_entry
+{
+    uint64_t first_key; // canonical key of the first entry in the block.
+    uint64_t data_offset; // where in the file the block's data starts.
+};
+
+class endgame_database // Read-only, memory-mapped table of solved positions, written by endgame_database_generator.
+{
+public:
+    // Constructors:
+
+    endgame_database();
+
+    ~endgame_database();
+
+    // Helpers:
+    bool load(const string& file_name); // maps the file into memory. Returns false if the file doesn't exist or isn't a database.
+    void unload(); // unmaps the file (if one is loaded).
+    bool is_loaded() const;
+    int get_max_empty_squares() const;
+    bool probe(const bitboard& position_to_probe, int& outcome) const;
+    // If the position is in the database, sets outcome (+1 win, 0 draw, -1 loss, for the player to move) and returns true.
+
+    // Public static methods:
+    static uint64_t canonical_key(const bitboard& b); // the smaller of the position's key and its mirror image's key.
+    static void write_varint(vector<unsigned char>& buffer, uint64_t value);
+    static uint64_t read_varint(const unsigned char*& data);
+
+private:
+    // Private variables:
+    const unsigned char* mapped_data; // the whole file, mapped into memory. nullptr if nothing is loaded.
+    size_t mapped_size;
+    const endgame_database_header* header;
+    const endgame_database_block_index_entry* block_index;
+
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#else
+    int file_descriptor;
+#endif
+};
+
+class endgame_database_generator // Builds an endgame database by enumerating and solving every reachable position with few empty squares.
+{
+public:
+    // Constructors:
+
+    endgame_database_generator(int max_empty_squaresP, int number_of_threadsP, const string& work_directoryP);
+
+    // Helpers:
+    void generate(const vector<bitboard>& roots, const string& output_file_name);
+    // Enumerates every position reachable from roots with at most max_empty_squares empty squares, solves them all, and writes
+    // the database to output_file_name. The work is split into tasks that are written to their own part files in
+    // work_directory, so an interrupted run continues where it left off when started again with the same roots and settings.
+
+    // Public static variables:
+    static const int split_depth; // how many moves past the roots the work gets split into separate tasks.
+    static const uint32_t entries_per_block;
+
+private:
+    // Private variables:
+    int max_empty_squares;
+    int number_of_threads;
+    string work_directory;
+    vector<bitboard> tasks; // positions whose descendants are enumerated and solved as one unit of work.
+    uint64_t tasks_fingerprint; // identifies this set of tasks in the part file names (so parts of a different run are never reused).
+    atomic<int> next_task; // index of the next task a worker thread should take.
+    atomic<int> number_of_tasks_done;
+    mutex output_mutex; // for printing progress from several threads.
+
+    // Private methods:
+    void find_tasks(const bitboard& current, int plies_left, unordered_set<uint64_t>& seen);
+    void run_worker(); // takes tasks until there are none left. Each worker thread runs this.
+    void complete_task(int task_index);
+    void enumerate_descendants(const bitboard& current, unordered_map<uint64_t, signed char>& solved,
+                               unordered_set<uint64_t>& visited);
+    // Walks through the positions with more than max_empty_squares empty squares, solving every position it reaches
+    // that is within the limit.
+    int solve_all_descendants(const bitboard& current, unordered_map<uint64_t, signed char>& solved);
+    // Returns the outcome of current (for the player to move), after solving and recording it and every non-terminal position after it.
+    string part_file_name(int task_index) const;
+    void merge_part_files(const string& output_file_name);
+};
+
+// Initializing the static variables:
+
+const int endgame_database_generator::split_depth = 4;
+const uint32_t endgame_database_generator::entries_per_block = 256;
+
+// ENDGAME_DATABASE CONSTRUCTORS:
+
+endgame_database::endgame_database()
+{
+    mapped_data = nullptr;
+    mapped_size = 0;
+    header = nullptr;
+    block_index = nullptr;
+
+#ifdef _WIN32
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = nullptr;
+#else
+    file_descriptor = -1;
+#endif
+}
+
+endgame_database::~endgame_database()
+{
+    unload();
+}
+
+// ENDGAME_DATABASE HELPERS:
+
+bool endgame_database::load(const string& file_name)
+{
+    unload();
+
+#ifdef _WIN32
+    file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    mapped_size = static_cast<size_t>(file_size.QuadPart);
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping_handle != nullptr)
+    {
+        mapped_data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    file_descriptor = open(file_name.c_str(), O_RDONLY);
+
+    if (file_descriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat file_info;
+    fstat(file_descriptor, &file_info);
+    mapped_size = static_cast<size_t>(file_info.st_size);
+
+    if (mapped_size > 0)
+    {
+        void* address = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+        if (address != MAP_FAILED)
+        {
+            mapped_data = static_cast<const unsigned char*>(address);
+        }
+    }
+#endif
+
+    if (mapped_data == nullptr || mapped_size < sizeof(endgame_database_header))
+    {
+        unload();
+
+        return false;
+    }
+
+    header = reinterpret_cast<const endgame_database_header*>(mapped_data);
+
+    if (strcmp(header->magic, "C4EGDB1") != 0 ||
+        header->index_offset + header->number_of_blocks * sizeof(endgame_database_block_index_entry) > mapped_size)
+    {
+        unload();
+
+        return false;
+    }
+
+    block_index = reinterpret_cast<const endgame_database_block_index_entry*>(mapped_data + header->index_offset);
+
+    return true;
+}
+
+void endgame_database::unload()
+{
+#ifdef _WIN32
+    if (mapped_data != nullptr)
+    {
+        UnmapViewOfFile(mapped_data);
+    }
+
+    if (mapping_handle != nullptr)
+    {
+        CloseHandle(mapping_handle);
+    }
+
+    if (file_handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file_handle);
+    }
+
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = nullptr;
+#else
+    if (mapped_data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(mapped_data), mapped_size);
+    }
+
+    if (file_descriptor >= 0)
+    {
+        close(file_descriptor);
+    }
+
+    file_descriptor = -1;
+#endif
+
+    mapped_data = nullptr;
+    mapped_size = 0;
+    header = nullptr;
+    block_index = nullptr;
+}
+
+bool endgame_database::is_loaded() const
+{
+    return (header != nullptr);
+}
+
+int endgame_database::get_max_empty_squares() const
+{
+    if (header == nullptr)
+    {
+        return -1;
+    }
+
+    return static_cast<int>(header->max_empty_squares);
+}
+
+bool endgame_database::probe(const bitboard& position_to_probe, int& outcome) const
+{
+    if (header == nullptr || header->number_of_blocks == 0 ||
+        position_to_probe.number_of_empty_squares() > static_cast<int>(header->max_empty_squares))
+    {
+        return false;
+    }
+
+    uint64_t key = canonical_key(position_to_probe);
+
+    // Binary search for the last block whose first_key is <= key:
+
+    uint64_t low = 0;
+    uint64_t high = header->number_of_blocks; // the answer is in [low, high).
+
+    while (high - low > 1)
+    {
+        uint64_t middle = (low + high) / 2;
+
+        if (block_index[middle].first_key <= key)
+        {
+            low = middle;
+        }
+
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (block_index[low].first_key > key)
+    {
+        return false;
+    }
+
+    // Now decode the block's entries in order until reaching (or passing) the key:
+
+    uint64_t entries_in_block = header->entries_per_block;
+
+    if (low == header->number_of_blocks - 1)
+    {
+        entries_in_block = header->number_of_entries - low * header->entries_per_block;
+    }
+
+    const unsigned char* data = mapped_data + block_index[low].data_offset;
+
+    uint64_t current_key = block_index[low].first_key;
+
+    for (uint64_t i = 0; i < entries_in_block; i++)
+    {
+        uint64_t value = read_varint(data);
+
+        current_key += (value >> 2);
+
+        if (current_key == key)
+        {
+            outcome = static_cast<int>(value & 3) - 1;
+
+            return true;
+        }
+
+        if (current_key > key)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// ENDGAME_DATABASE PUBLIC STATIC METHODS:
+
+uint64_t endgame_database::canonical_key(const bitboard& b)
+{
+    return min(b.key(), b.mirrored_key());
+}
+
+void endgame_database::write_varint(vector<unsigned char>& buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back(static_cast<unsigned char>(value & 0x7F) | 0x80);
+
+        value >>= 7;
+    }
+
+    buffer.push_back(static_cast<unsigned char>(value));
+}
+
+uint64_t endgame_database::read_varint(const unsigned char*& data)
+{
+    uint64_t value = 0;
+
+    int shift = 0;
+
+    while (*data & 0x80)
+    {
+        value |= static_cast<uint64_t>(*data & 0x7F) << shift;
+
+        shift += 7;
+
+        data ++;
+    }
+
+    value |= static_cast<uint64_t>(*data) << shift;
+
+    data ++;
+
+    return value;
+}
+
+// ENDGAME_DATABASE_GENERATOR CONSTRUCTORS:
+
+endgame_database_generator::endgame_database_generator(int max_empty_squaresP, int number_of_threadsP, const string& work_directoryP)
+{
+    if (max_empty_squaresP < 0 || max_empty_squaresP > bitboard::width * bitboard::height)
+    {
+        throw runtime_error("max_empty_squares is out of range in endgame_database_generator()\n");
+    }
+
+    max_empty_squares = max_empty_squaresP;
+    number_of_threads = max(1, number_of_threadsP);
+    work_directory = work_directoryP;
+    tasks_fingerprint = 0;
+    next_task = 0;
+    number_of_tasks_done = 0;
+}
+
+// ENDGAME_DATABASE_GENERATOR HELPERS:
+
+void endgame_database_generator::generate(const vector<bitboard>& roots, const string& output_file_name)
+{
+    // First, split the work into tasks. Tasks are sorted by canonical key, so the same roots always give the same task
+    // indices (which is what lets a later run pick up the part files of an earlier, interrupted one).
+
+    unordered_set<uint64_t> seen;
+
+    tasks.clear();
+
+    for (const bitboard& root: roots)
+    {
+        find_tasks(root, split_depth, seen);
+    }
+
+    sort(tasks.begin(), tasks.end(), [](const bitboard& first, const bitboard& second)
+    {
+        return endgame_database::canonical_key(first) < endgame_database::canonical_key(second);
+    });
+
+    tasks_fingerprint = 1469598103934665603ULL;
+
+    for (const bitboard& task: tasks)
+    {
+        tasks_fingerprint = (tasks_fingerprint ^ endgame_database::canonical_key(task)) * 1099511628211ULL;
+    }
+
+    tasks_fingerprint ^= static_cast<uint64_t>(max_empty_squares);
+
+    cout << "Endgame database: " << tasks.size() << " tasks, " << number_of_threads << " threads.\n";
+
+    // Now solve the tasks in parallel:
+
+    next_task = 0;
+    number_of_tasks_done = 0;
+
+    vector<thread> workers;
+
+    for (int i = 0; i < number_of_threads; i++)
+    {
+        workers.emplace_back(&endgame_database_generator::run_worker, this);
+    }
+
+    for (thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    merge_part_files(output_file_name);
+}
+
+void endgame_database_generator::find_tasks(const bitboard& current, int plies_left, unordered_set<uint64_t>& seen)
+{
+    if (!seen.insert(endgame_database::canonical_key(current)).second) // already reached this position another way.
+    {
+        return;
+    }
+
+    if (plies_left == 0 || current.number_of_empty_squares() <= max_empty_squares)
+    {
+        tasks.push_back(current);
+
+        return;
+    }
+
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        if (current.can_play(col) && !current.is_winning_move(col)) // positions after a win are over, so they're never stored.
+        {
+            bitboard child = current;
+            child.play(col);
+
+            find_tasks(child, plies_left - 1, seen);
+        }
+    }
+}
+
+void endgame_database_generator::run_worker()
+{
+    while (true)
+    {
+        int task_index = next_task++;
+
+        if (task_index >= static_cast<int>(tasks.size()))
+        {
+            return;
+        }
+
+        complete_task(task_index);
+
+        int done = ++number_of_tasks_done;
+
+        lock_guard<mutex> lock(output_mutex);
+
+        cout << "\rSolved " << done << " / " << tasks.size() << " tasks" << flush;
+    }
+}
+
+void endgame_database_generator::complete_task(int task_index)
+{
+    string file_name = part_file_name(task_index);
+
+    if (ifstream(file_name, ios::binary).good()) // this task was finished by an earlier run.
+    {
+        return;
+    }
+
+    unordered_map<uint64_t, signed char> solved; // canonical key --> outcome, for every position within max_empty_squares.
+    unordered_set<uint64_t> visited; // canonical keys of the positions with too many empty squares that were already walked through.
+
+    if (tasks[task_index].number_of_empty_squares() <= max_empty_squares)
+    {
+        solve_all_descendants(tasks[task_index], solved);
+    }
+
+    else
+    {
+        enumerate_descendants(tasks[task_index], solved, visited);
+    }
+
+    vector<uint64_t> entries;
+
+    for (const pair<const uint64_t, signed char>& current: solved)
+    {
+        entries.push_back((current.first << 2) | static_cast<uint64_t>(current.second + 1));
+    }
+
+    sort(entries.begin(), entries.end());
+
+    // Write to a temporary file first and rename it once complete, so a part file that exists is always a finished one.
+
+    string temporary_file_name = file_name + ".tmp";
+
+    ofstream fout(temporary_file_name, ios::binary);
+
+    if (fout.fail())
+    {
+        throw runtime_error("Could not write " + temporary_file_name + " in complete_task()\n");
+    }
+
+    fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(uint64_t));
+
+    fout.close();
+
+    if (rename(temporary_file_name.c_str(), file_name.c_str()) != 0)
+    {
+        throw runtime_error("Could not rename " + temporary_file_name + " in complete_task()\n");
+    }
+}
+
+void endgame_database_generator::enumerate_descendants(const bitboard& current, unordered_map<uint64_t, signed char>& solved,
+                                                       unordered_set<uint64_t>& visited)
+{
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        if (!current.can_play(col) || current.is_winning_move(col))
+        {
+            continue;
+        }
+
+        bitboard child = current;
+        child.play(col);
+
+        if (child.number_of_empty_squares() <= max_empty_squares)
+        {
+            solve_all_descendants(child, solved);
+        }
+
+        else if (visited.insert(endgame_database::canonical_key(child)).second)
+        {
+            enumerate_descendants(child, solved, visited);
+        }
+    }
+}
+
+int endgame_database_generator::solve_all_descendants(const bitboard& current, unordered_map<uint64_t, signed char>& solved)
+{
+    if (current.number_of_empty_squares() == 0) // board full, and nobody won.
+    {
+        return 0;
+    }
+
+    uint64_t key = endgame_database::canonical_key(current);
+
+    unordered_map<uint64_t, signed char>::const_iterator found = solved.find(key);
+
+    if (found != solved.end())
+    {
+        return found->second;
+    }
+
+    // Every child gets solved (not just enough of them to prove the outcome), since every reachable position is recorded.
+    // Working backwards from the children like this is what makes the whole subtree cost one visit per position.
+
+    int outcome = -1;
+
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        if (!current.can_play(col))
+        {
+            continue;
+        }
+
+        if (current.is_winning_move(col))
+        {
+            outcome = 1;
+
+            continue;
+        }
+
+        bitboard child = current;
+        child.play(col);
+
+        outcome = max(outcome, -solve_all_descendants(child, solved));
+    }
+
+    solved[key] = static_cast<signed char>(outcome);
+
+    return outcome;
+}
+
+string endgame_database_generator::part_file_name(int task_index) const
+{
+    ostringstream name;
+
+    name << work_directory << "/egdb_" << max_empty_squares << "_" << hex << tasks_fingerprint << dec << "_part_" << task_index << ".bin";
+
+    return name.str();
+}
+
+void endgame_database_generator::merge_part_files(const string& output_file_name)
+{
+    cout << "\nMerging part files into " << output_file_name << "\n";
+
+    // Each part file is already sorted, so a k-way merge produces the sorted, duplicate-free list of entries
+    // without having to hold all of them in memory at once.
+
+    vector<unique_ptr<ifstream>> parts;
+
+    typedef pair<uint64_t, int> entry_and_part; // an entry, and which part file it came from.
+
+    priority_queue<entry_and_part, vector<entry_and_part>, greater<entry_and_part>> heap;
+
+    for (int i = 0; i < static_cast<int>(tasks.size()); i++)
+    {
+        parts.push_back(make_unique<ifstream>(part_file_name(i), ios::binary));
+
+        uint64_t entry = 0;
+
+        if (parts[i]->read(reinterpret_cast<char*>(&entry), sizeof(uint64_t)))
+        {
+            heap.push({entry, i});
+        }
+    }
+
+    string temporary_file_name = output_file_name + ".tmp";
+
+    ofstream fout(temporary_file_name, ios::binary);
+
+    if (fout.fail())
+    {
+        throw runtime_error("Could not write " + temporary_file_name + " in merge_part_files()\n");
+    }
+
+    endgame_database_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, "C4EGDB1");
+    header.max_empty_squares = static_cast<uint32_t>(max_empty_squares);
+    header.entries_per_block = entries_per_block;
+
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header)); // placeholder, rewritten at the end.
+
+    vector<endgame_database_block_index_entry> block_index;
+    vector<unsigned char> block_data;
+
+    uint64_t data_offset = sizeof(header);
+    uint64_t previous_key = 0;
+    uint64_t number_of_entries = 0;
+    bool is_first_entry = true;
+
+    while (!heap.empty())
+    {
+        entry_and_part smallest = heap.top();
+        heap.pop();
+
+        uint64_t entry = 0;
+
+        if (parts[smallest.second]->read(reinterpret_cast<char*>(&entry), sizeof(uint64_t)))
+        {
+            heap.push({entry, smallest.second});
+        }
+
+        uint64_t key = smallest.first >> 2;
+        uint64_t outcome_code = smallest.first & 3;
+
+        if (!is_first_entry && key == previous_key) // the same position, solved by more than one task.
+        {
+            continue;
+        }
+
+        if (number_of_entries % entries_per_block == 0) // start a new block:
+        {
+            fout.write(reinterpret_cast<const char*>(block_data.data()), block_data.size());
+
+            data_offset += block_data.size();
+
+            block_data.clear();
+
+            block_index.push_back({key, data_offset});
+
+            previous_key = key;
+        }
+
+        endgame_database::write_varint(block_data, ((key - previous_key) << 2) | outcome_code);
+
+        previous_key = key;
+        is_first_entry = false;
+        number_of_entries ++;
+    }
+
+    fout.write(reinterpret_cast<const char*>(block_data.data()), block_data.size());
+
+    data_offset += block_data.size();
+
+    while (data_offset % 8 != 0) // so the block index is aligned once the file is mapped into memory.
+    {
+        fout.put(0);
+
+        data_offset ++;
+    }
+
+    header.number_of_entries = number_of_entries;
+    header.number_of_blocks = block_index.size();
+    header.index_offset = data_offset;
+
+    fout.write(reinterpret_cast<const char*>(block_index.data()), block_index.size() * sizeof(endgame_database_block_index_entry));
+
+    fout.seekp(0);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    fout.close();
+
+    parts.clear();
+
+    remove(output_file_name.c_str());
+
+    if (rename(temporary_file_name.c_str(), output_file_name.c_str()) != 0)
+    {
+        throw runtime_error("Could not rename " + temporary_file_name + " in merge_part_files()\n");
+    }
+
+    cout << "Wrote " << number_of_entries << " positions in " << block_index.size() << " blocks ("
+         << (data_offset + block_index.size() * sizeof(endgame_database_block_index_entry)) << " bytes).\n";
+}
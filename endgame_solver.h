@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "bitboard.h"
+
+using namespace std;
+
+struct endgame_solver_result // What the endgame solver returns for a position.
+{
+    int outcome; // +1 if the player to move wins, 0 if the game is drawn, -1 if the player to move loses (all with perfect play).
+    int best_column; // a column achieving outcome. If outcome is -1 (every move loses), it's simply some legal column.
+};
+
+struct endgame_solver_TT_entry // One slot of the solver's own transposition table.
+{
+    uint64_t key; // bitboard key of the position stored in this slot (0 if the slot is empty).
+    signed char lower_bound; // the outcome of the position (from the player to move's perspective) is >= lower_bound...
+    signed char upper_bound; // ...and <= upper_bound. Both equal once the outcome is proven exactly.
+};
+
+class endgame_solver // Exact win/draw/loss solver, used once there are few enough empty squares left to see to the end of the game.
+{
+public:
+    // Constructors:
+
+    endgame_solver();
+
+    // Helpers:
+    endgame_solver_result solve(const vector<vector<char>>& board, char piece_to_move);
+    // Solves board exactly, where piece_to_move ('C' or 'U') is whose turn it is. Nobody may have won already in board,
+    // and board can't be full.
+
+    endgame_solver_result solve(const bitboard& position_to_solve); // same as above, but the position is already a bitboard.
+
+    int get_outcome(const bitboard& position_to_solve); // only the outcome part of solve() (skips finding a best move).
+                                                        // The first call allocates the TT (16 MB).
+
+    long long get_number_of_nodes() const; // how many nodes the solver has visited (over all calls, PURELY FOR TESTING!).
+
+    void reset_transposition_table(); // empties the solver's transposition table.
+
+    // Public static variables:
+    static const int TT_size_log_2;
+    static const int TT_size; // number of slots in the solver's transposition table (2 to the power of TT_size_log_2).
+    static const vector<int> column_order; // columns in the order they should be tried (center first).
+
+private:
+    // Private variables:
+    vector<endgame_solver_TT_entry> transposition_table; // direct-mapped: a position goes in slot find_index_in_TT(key), replacing whatever was there.
+    long long number_of_nodes;
+
+    // Private methods:
+    int negamax(const bitboard& current, int alpha, int beta);
+    // Returns the outcome of current (from the player to move's perspective) if it's strictly between alpha and beta.
+    // If it's <= alpha, returns an upper bound of the outcome that is <= alpha. If it's >= beta, returns a lower bound >= beta.
+    // The solver only ever calls this with null windows (beta = alpha + 1), so each call answers one yes/no question.
+
+    void store_in_TT(uint64_t key, int lower_bound, int upper_bound);
+    size_t find_index_in_TT(uint64_t key) const;
+    void sort_moves(const bitboard& current, uint64_t moves, vector<uint64_t>& sorted_moves) const;
+    // Fills sorted_moves with the bits of moves, ordered from most to least promising.
+};
+
+// Initializing the static variables:
+
+const int endgame_solver::TT_size_log_2 = 20;
+const int endgame_solver::TT_size = 1 << endgame_solver::TT_size_log_2;
+const vector<int> endgame_solver::column_order = {3, 2, 4, 1, 5, 0, 6};
+
+// CONSTRUCTORS:
+
+endgame_solver::endgame_solver()
+{
+    // transposition_table is left empty until the first call to get_outcome(), so an engine that never reaches an endgame
+    // doesn't pay for it.
+
+    number_of_nodes = 0;
+}
+
+// HELPERS:
+
+endgame_solver_result endgame_solver::solve(const vector<vector<char>>& board, char piece_to_move)
+{
+    return solve(bitboard(board, piece_to_move));
+}
+
+endgame_solver_result endgame_solver::solve(const bitboard& position_to_solve)
+{
+    endgame_solver_result result;
+    result.outcome = get_outcome(position_to_solve);
+    result.best_column = -1;
+
+    // Now find a column that achieves the outcome. Each check is again a single null window search, and nearly all of
+    // them are answered straight from the TT filled in by get_outcome().
+
+    for (int col: column_order)
+    {
+        if (!position_to_solve.can_play(col))
+        {
+            continue;
+        }
+
+        if (result.best_column == -1)
+        {
+            result.best_column = col; // any legal column will do if the player to move is lost anyways.
+        }
+
+        if (position_to_solve.is_winning_move(col))
+        {
+            if (result.outcome == 1)
+            {
+                result.best_column = col;
+
+                break;
+            }
+
+            continue;
+        }
+
+        if (result.outcome == -1)
+        {
+            break;
+        }
+
+        bitboard child = position_to_solve;
+        child.play(col);
+
+        if (child.can_win_next()) // col lets the opponent win right away.
+        {
+            continue;
+        }
+
+        // The child's outcome is from the opponent's perspective, so col achieves result.outcome if the child is <= -outcome:
+
+        if (-negamax(child, -result.outcome, -result.outcome + 1) >= result.outcome)
+        {
+            result.best_column = col;
+
+            break;
+        }
+    }
+
+    return result;
+}
+
+int endgame_solver::get_outcome(const bitboard& position_to_solve)
+{
+    if (transposition_table.empty())
+    {
+        transposition_table.resize(TT_size, {0, -1, 1});
+    }
+
+    if (position_to_solve.can_win_next())
+    {
+        return 1;
+    }
+
+    // Two null window searches settle the outcome: first "is it a win?", then "is it at least a draw?".
+
+    if (negamax(position_to_solve, 0, 1) >= 1)
+    {
+        return 1;
+    }
+
+    if (negamax(position_to_solve, -1, 0) <= -1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+long long endgame_solver::get_number_of_nodes() const
+{
+    return number_of_nodes;
+}
+
+void endgame_solver::reset_transposition_table()
+{
+    fill(transposition_table.begin(), transposition_table.end(), endgame_solver_TT_entry{0, -1, 1});
+}
+
+// PRIVATE METHODS:
+
+int endgame_solver::negamax(const bitboard& current, int alpha, int beta)
+{
+    // Pre-condition: the player to move cannot win immediately (the caller has already checked this).
+
+    number_of_nodes ++;
+
+    if (current.number_of_moves == bitboard::width * bitboard::height) // board is full, and nobody won.
+    {
+        return 0;
+    }
+
+    uint64_t next = current.possible_non_losing_moves();
+
+    if (next == 0) // every move lets the opponent win right away.
+    {
+        return -1;
+    }
+
+    if (current.number_of_moves >= bitboard::width * bitboard::height - 2)
+    {
+        // At most 2 squares left, no immediate win for either side, and the player to move has a safe move. Draw.
+
+        return 0;
+    }
+
+    uint64_t key = current.key();
+
+    const endgame_solver_TT_entry& entry = transposition_table[find_index_in_TT(key)];
+
+    int lower_bound = -1;
+    int upper_bound = 1;
+
+    if (entry.key == key)
+    {
+        lower_bound = entry.lower_bound;
+        upper_bound = entry.upper_bound;
+
+        if (lower_bound >= beta)
+        {
+            return lower_bound;
+        }
+
+        if (upper_bound <= alpha)
+        {
+            return upper_bound;
+        }
+
+        alpha = max(alpha, lower_bound);
+        beta = min(beta, upper_bound);
+
+        if (alpha >= beta)
+        {
+            return alpha;
+        }
+    }
+
+    vector<uint64_t> sorted_moves;
+    sort_moves(current, next, sorted_moves);
+
+    int best_score = -1;
+
+    for (uint64_t move_bit: sorted_moves)
+    {
+        bitboard child = current;
+        child.play_move_bit(move_bit);
+
+        int score = -negamax(child, -beta, -max(alpha, best_score));
+
+        if (score >= beta)
+        {
+            store_in_TT(key, score, upper_bound); // a lower bound: the position is at least this good.
+
+            return score;
+        }
+
+        best_score = max(best_score, score);
+    }
+
+    if (best_score <= alpha)
+    {
+        store_in_TT(key, lower_bound, best_score); // an upper bound: every move was tried and none does better.
+    }
+
+    else
+    {
+        store_in_TT(key, best_score, best_score); // exact.
+    }
+
+    return best_score;
+}
+
+void endgame_solver::store_in_TT(uint64_t key, int lower_bound, int upper_bound)
+{
+    endgame_solver_TT_entry& entry = transposition_table[find_index_in_TT(key)];
+
+    entry.key = key;
+    entry.lower_bound = static_cast<signed char>(lower_bound);
+    entry.upper_bound = static_cast<signed char>(upper_bound);
+}
+
+size_t endgame_solver::find_index_in_TT(uint64_t key) const
+{
+    // Fibonacci hashing: the key's low bits only describe the first few columns, so they can't be used as the index directly.
+
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - TT_size_log_2);
+}
+
+void endgame_solver::sort_moves(const bitboard& current, uint64_t moves, vector<uint64_t>& sorted_moves) const
+{
+    // Moves creating more of the player's own winning squares go first. Ties keep the center-first column_order.
+
+    vector<int> scores;
+
+    for (int col: column_order)
+    {
+        uint64_t move_bit = moves & bitboard::column_mask(col);
+
+        if (move_bit)
+        {
+            int score = current.move_score(move_bit);
+
+            int i = sorted_moves.size();
+
+            sorted_moves.push_back(move_bit);
+            scores.push_back(score);
+
+            while (i > 0 && scores[i-1] < score) // insertion sort, since there are at most 7 moves.
+            {
+                sorted_moves[i] = sorted_moves[i-1];
+                scores[i] = scores[i-1];
+
+                i--;
+            }
+
+            sorted_moves[i] = move_bit;
+            scores[i] = score;
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "position.h"
+
+using namespace std;
+
+// An engine owns everything a search keeps between moves or is configured by: its TT, solvers, evaluation cache, limits,
+// settings and statistics (its engine_state, see position.h). Every position it creates points to that state, so several
+// engines can exist at once, each with its own TT, and be used from any thread (but only one thread at a time per engine).
+// The positions an engine returns must not outlive it.
+
+// An engine takes about 24 MB as soon as it's made (the TT's buckets), and up to about 76 MB once it has used its two solvers
+// and its cache, plus 8 MB per defence thread once it has looked for a defence (see the MEMORY note in position.h). The read-only
+// tables are shared by all the engines, and nothing else is kept per thread.
+
+class engine
+{
+public:
+    // Constructors:
+
+    engine();
+    // Starts off with an empty TT, solvers and cache, no statistics, no iteration_callback, no tracer, no stop_flag, and the
+    // default settings and limits (see engine_state in position.h).
+
+    // Helpers:
+    unique_ptr<position> think_on_game_position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+                                                const vector<treasure_spot>& squares_amplifying_comp_2P,
+                                                const vector<treasure_spot>& squares_amplifying_comp_3P,
+                                                const vector<treasure_spot>& squares_amplifying_user_2P,
+                                                const vector<treasure_spot>& squares_amplifying_user_3P, bool starting_new_game);
+    unique_ptr<position> think_on_game_position(bool is_comp_turnP, bool starting_new_game);
+    // The same as position's static think_on_game_position() functions, with this engine's state.
+
+    coordinate find_best_move_for_comp(position& root); // root must have come from this engine's think_on_game_position().
+
+    void reset_evaluation_cache(); // empties smart_evaluation_cache, e.g., so that searches being compared each start without one.
+
+    // Getters:
+    engine_settings get_settings() const;
+    double get_thinking_time() const;
+    int get_max_depth_limit() const;
+    int get_max_nodes_per_move() const;
+    long long get_number_of_nodes() const; // how many positions this engine has created (over all calls, PURELY FOR TESTING!).
+    search_statistics get_search_statistics() const; // of the last think_on_game_position() call (see engine_state::statistics).
+    const engine_state& get_state() const; // everything else, e.g., the other counters (PURELY FOR TESTING!).
+
+    // Setters:
+    void set_settings(const engine_settings& settings);
+    void set_thinking_time(double thinking_timeP);
+    void set_max_depth_limit(int max_depth_limitP);
+    void set_max_nodes_per_move(int max_nodes_per_moveP);
+    void set_multi_pv_count(int multi_pv_countP);
+    void set_number_of_defence_threads(int number_of_defence_threadsP);
+    void set_iteration_callback(const function<bool(const position&)>& iteration_callbackP); // see engine_state::iteration_callback.
+    void set_tracer(search_tracer* tracerP); // see engine_state::tracer. The tracer must outlive its use by this engine.
+    void set_stop_flag(const atomic<bool>* stop_flagP); // see engine_state::stop_flag. The flag must outlive its use by this engine.
+    void set_check_smart_evaluation(bool check_smart_evaluationP); // see engine_state::check_smart_evaluation (PURELY FOR TESTING!).
+
+private:
+    // Private variables:
+    engine_state state;
+};
+
+// CONSTRUCTORS:
+
+engine::engine()
+{
+    // state starts off with the values it's initialized to in position.h.
+}
+
+// HELPERS:
+
+unique_ptr<position> engine::think_on_game_position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+                                                    const vector<treasure_spot>& squares_amplifying_comp_2P,
+                                                    const vector<treasure_spot>& squares_amplifying_comp_3P,
+                                                    const vector<treasure_spot>& squares_amplifying_user_2P,
+                                                    const vector<treasure_spot>& squares_amplifying_user_3P, bool starting_new_game)
+{
+    return position::think_on_game_position(state, boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
+                                            squares_amplifying_user_2P, squares_amplifying_user_3P, starting_new_game);
+}
+
+unique_ptr<position> engine::think_on_game_position(bool is_comp_turnP, bool starting_new_game)
+{
+    return position::think_on_game_position(state, is_comp_turnP, starting_new_game);
+}
+
+coordinate engine::find_best_move_for_comp(position& root)
+{
+    return root.find_best_move_for_comp(); // uses quick_win_solver and the defence solvers of root's state (this engine's).
+}
+
+void engine::reset_evaluation_cache()
+{
+    state.smart_evaluation_cache.reset();
+}
+
+// GETTERS:
+
+engine_settings engine::get_settings() const
+{
+    return state.settings;
+}
+
+double engine::get_thinking_time() const
+{
+    return state.thinking_time;
+}
+
+int engine::get_max_depth_limit() const
+{
+    return state.max_depth_limit;
+}
+
+int engine::get_max_nodes_per_move() const
+{
+    return state.max_nodes_per_move;
+}
+
+long long engine::get_number_of_nodes() const
+{
+    return state.counter;
+}
+
+search_statistics engine::get_search_statistics() const
+{
+    return state.statistics;
+}
+
+const engine_state& engine::get_state() const
+{
+    return state;
+}
+
+// SETTERS:
+
+void engine::set_settings(const engine_settings& settings)
+{
+    if (state.settings.parameters != settings.parameters) // the cached evaluations used the old weights.
+    {
+        state.smart_evaluation_cache.reset();
+    }
+
+    state.settings = settings;
+}
+
+void engine::set_thinking_time(double thinking_timeP)
+{
+    state.thinking_time = thinking_timeP;
+}
+
+void engine::set_max_depth_limit(int max_depth_limitP)
+{
+    state.max_depth_limit = max_depth_limitP;
+}
+
+void engine::set_max_nodes_per_move(int max_nodes_per_moveP)
+{
+    state.max_nodes_per_move = max_nodes_per_moveP;
+}
+
+void engine::set_multi_pv_count(int multi_pv_countP)
+{
+    state.multi_pv_count = multi_pv_countP;
+}
+
+void engine::set_number_of_defence_threads(int number_of_defence_threadsP)
+{
+    state.number_of_defence_threads = number_of_defence_threadsP;
+}
+
+void engine::set_iteration_callback(const function<bool(const position&)>& iteration_callbackP)
+{
+    state.iteration_callback = iteration_callbackP;
+}
+
+void engine::set_tracer(search_tracer* tracerP)
+{
+    state.tracer = tracerP;
+}
+
+void engine::set_stop_flag(const atomic<bool>* stop_flagP)
+{
+    state.stop_flag = stop_flagP;
+}
+
+void engine::set_check_smart_evaluation(bool check_smart_evaluationP)
+{
+    state.check_smart_evaluation = check_smart_evaluationP;
+}
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "engine.h"
+#include "self_play.h"
+#include "batch_analyzer.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A line-based text protocol over an input and output stream (like UCI for chess), so other programs (match managers,
+// scripts) can drive the engine without the interactive prompts in main.cpp. Commands:
+
+// "uci"                              -> "id name ..." and "uciok".
+// "isready"                          -> "readyok" (right away, even during a search).
+// "ucinewgame"                       -> the empty board, and the next search starts with an empty TT.
+// "position startpos [moves d d c]"  -> the position reached by the moves (columns a-g) from the empty board.
+// "go [depth <n>] [nodes <n>] [movetime <ms>] [infinite]"
+//                                    -> searches the position for the player to move, on the search thread. An "info" line is written
+//                                       after each iteration of iterative deepening, and then "bestmove <column>" ("bestmove (none)"
+//                                       if the game is over). With a depth or node limit but no movetime, there's no time limit.
+// "stop"                             -> ends the search right away, with the result of the last iteration it finished (see
+//                                       engine_state::stop_flag).
+// "quit"                             -> stops the search (like "stop") and returns from run(). So does the input running out.
+// Anything wrong with a command gets an "info string <reason>" line.
+// If compiled with SEARCH_PROFILER, each search also writes "info string" lines with its time in each phase (see search_profiler.h).
+
+// An info line is "info depth <d> seldepth <d> score cp <evaluation> nodes <n> nps <n> time <ms> pv <columns>", where seldepth is
+// the deepest ply looked at (see search_statistics in position.h), and the evaluation is from the
+// perspective of the player to move. For a forced win, "cp <evaluation>" is "mate <n>" instead: n is how many of their own moves
+// the player to move needs to win (negative if they're the one getting mated). If the length isn't known, it's "win" or "loss".
+
+// The game is kept like in self_play.h: the first player's pieces are 'C' and the second player's are 'U', and to search for 'U'
+// their pieces (and amplifying vectors) get swapped. If a "position" command only adds moves to the one before it, just the new
+// moves are played, so sending the whole game before every "go" (like a match manager does) stays cheap.
+// For the same reason, every search runs on one long-lived search thread, instead of a new thread for each "go".
+
+class engine_protocol
+{
+public:
+    // Constructors:
+
+    engine_protocol(const engine_settings& search_settingsP); // the engine searches with search_settingsP.
+
+    // Helpers:
+    void run(istream& input, ostream& output); // returns after "quit", or once input runs out (see above).
+
+    // Public static methods:
+    static string format_score(int evaluation); // "cp <evaluation>", "mate <n>", "win" or "loss" (see above).
+
+private:
+    // Private variables:
+    engine protocol_engine;
+    analysis_limits default_limits; // for a "go" with no limits.
+
+    // The game (see above):
+    vector<coordinate> moves;
+    vector<vector<char>> board;
+    vector<treasure_spot> squares_amplifying_C_2;
+    vector<treasure_spot> squares_amplifying_C_3;
+    vector<treasure_spot> squares_amplifying_U_2;
+    vector<treasure_spot> squares_amplifying_U_3;
+    bool is_game_over;
+    bool is_new_game; // if true, the next search resets the TT.
+    char last_side_searched; // 'C' or 'U'. The TT gets reset when it changes, since 'U' sees their own pieces as 'C'.
+
+    // The search thread (the game and engine are only used by one thread at a time: search_thread while is_search_pending):
+    thread search_thread;
+    mutex search_mutex;
+    condition_variable search_state_changed;
+    bool is_search_pending; // true from "go" until the search thread has written bestmove.
+    bool is_shutting_down;
+    analysis_limits pending_limits;
+    atomic<bool> stop_requested;
+    mutex output_mutex;
+    ostream* search_output;
+    steady_clock::time_point search_start_time;
+    int number_of_info_lines; // written during the current search.
+
+    // Private methods:
+    void set_up_position(istringstream& words, ostream& output);
+    void start_search(istringstream& words, ostream& output);
+    void run_search_thread(); // waits for each "go", and searches.
+    void search(const analysis_limits& limits);
+    bool write_info(const position& root, const search_statistics& statistics);
+    // Also the engine's iteration_callback. Returns false once "stop" has been sent.
+    void wait_for_search();
+    void reset_board();
+    void play_move(int col); // throws runtime_error if col is full or invalid, or the game is already over.
+    void write_line(ostream& output, const string& line);
+};
+
+// CONSTRUCTORS:
+
+engine_protocol::engine_protocol(const engine_settings& search_settingsP)
+{
+    protocol_engine.set_settings(search_settingsP);
+
+    default_limits = {protocol_engine.get_max_depth_limit(), protocol_engine.get_max_nodes_per_move(), protocol_engine.get_thinking_time()};
+
+    protocol_engine.set_iteration_callback([this](const position& root)
+    {
+        return write_info(root, protocol_engine.get_search_statistics());
+    });
+
+    protocol_engine.set_stop_flag(&stop_requested);
+
+    is_search_pending = false;
+    is_shutting_down = false;
+
+    stop_requested = false;
+
+    search_output = &cout;
+
+    number_of_info_lines = 0;
+
+    is_new_game = true;
+
+    last_side_searched = ' ';
+
+    reset_board();
+}
+
+// HELPERS:
+
+void engine_protocol::run(istream& input, ostream& output)
+{
+    is_shutting_down = false;
+
+    search_thread = thread(&engine_protocol::run_search_thread, this);
+
+    string line;
+
+    while (getline(input, line))
+    {
+        istringstream words(line);
+
+        string command;
+
+        if (!(words >> command))
+        {
+            continue;
+        }
+
+        if (command == "uci")
+        {
+            write_line(output, "id name Connect Four AI");
+            write_line(output, "uciok");
+        }
+
+        else if (command == "isready")
+        {
+            write_line(output, "readyok");
+        }
+
+        else if (command == "ucinewgame")
+        {
+            wait_for_search();
+
+            reset_board();
+
+            is_new_game = true;
+        }
+
+        else if (command == "position")
+        {
+            wait_for_search();
+
+            set_up_position(words, output);
+        }
+
+        else if (command == "go")
+        {
+            wait_for_search();
+
+            start_search(words, output);
+        }
+
+        else if (command == "stop")
+        {
+            stop_requested = true;
+
+            wait_for_search();
+        }
+
+        else if (command == "quit")
+        {
+            stop_requested = true;
+
+            break;
+        }
+
+        else
+        {
+            write_line(output, "info string Unknown command " + command);
+        }
+    }
+
+    stop_requested = true; // whether after "quit" or because input ran out (nothing could send "stop" any more).
+
+    wait_for_search();
+
+    {
+        lock_guard<mutex> lock(search_mutex);
+
+        is_shutting_down = true;
+    }
+
+    search_state_changed.notify_all();
+
+    search_thread.join();
+}
+
+// PUBLIC STATIC METHODS:
+
+string engine_protocol::format_score(int evaluation)
+{
+    if (position::is_forced_win_for_comp(evaluation))
+    {
+        int win_distance = position::find_win_distance(evaluation);
+
+        return (win_distance >= position::unknown_win_distance) ? "win" : "mate " + to_string((win_distance + 1) / 2);
+    }
+
+    if (position::is_forced_win_for_user(evaluation))
+    {
+        int win_distance = position::find_win_distance(evaluation);
+
+        return (win_distance >= position::unknown_win_distance) ? "loss" : "mate -" + to_string(win_distance / 2);
+    }
+
+    return "cp " + to_string(evaluation);
+}
+
+// PRIVATE METHODS:
+
+void engine_protocol::set_up_position(istringstream& words, ostream& output)
+{
+    string word;
+
+    words >> word;
+
+    if (word != "startpos")
+    {
+        write_line(output, "info string Expected startpos after position");
+
+        return;
+    }
+
+    vector<int> columns;
+
+    if (words >> word && word != "moves")
+    {
+        write_line(output, "info string Expected moves after startpos");
+
+        return;
+    }
+
+    while (words >> word)
+    {
+        for (char c: word) // so "d d c" and "ddc" are the same.
+        {
+            columns.push_back(tolower(c) - 'a');
+        }
+    }
+
+    // If the game so far isn't the start of columns, play columns out from the empty board:
+
+    bool continues_game = moves.size() <= columns.size();
+
+    for (int i = 0; i < static_cast<int>(moves.size()) && continues_game; i++)
+    {
+        continues_game = moves[i].col == columns[i];
+    }
+
+    if (!continues_game)
+    {
+        reset_board();
+    }
+
+    try
+    {
+        for (int i = moves.size(); i < static_cast<int>(columns.size()); i++)
+        {
+            play_move(columns[i]);
+        }
+    }
+
+    catch (const runtime_error& error)
+    {
+        string reason = error.what();
+
+        reason.erase(remove(reason.begin(), reason.end(), '\n'), reason.end());
+
+        write_line(output, "info string " + reason + " (the position is the one before that move)");
+    }
+}
+
+void engine_protocol::start_search(istringstream& words, ostream& output)
+{
+    analysis_limits limits = default_limits;
+
+    bool has_time_limit = false;
+    bool has_other_limit = false;
+
+    string name;
+
+    try
+    {
+        while (words >> name)
+        {
+            if (name == "infinite")
+            {
+                limits.max_depth_limit = 42;
+                limits.max_nodes_per_move = 0;
+
+                has_other_limit = true;
+
+                continue;
+            }
+
+            string value;
+
+            words >> value;
+
+            if (name == "depth")
+            {
+                limits.max_depth_limit = stoi(value);
+
+                has_other_limit = true;
+            }
+
+            else if (name == "nodes")
+            {
+                limits.max_nodes_per_move = stoi(value);
+
+                has_other_limit = true;
+            }
+
+            else if (name == "movetime")
+            {
+                limits.thinking_time = stod(value) / 1000;
+
+                has_time_limit = true;
+            }
+
+            else
+            {
+                throw invalid_argument("Unknown limit " + name);
+            }
+        }
+    }
+
+    catch (const exception& error) // stoi() and stod() throw invalid_argument when value isn't a number.
+    {
+        write_line(output, "info string Bad go command (" + string(error.what()) + ")");
+
+        return;
+    }
+
+    if (has_other_limit && !has_time_limit)
+    {
+        limits.thinking_time = 1000000; // only the other limits (or "stop") end the iterative deepening.
+    }
+
+    stop_requested = false;
+
+    search_output = &output;
+
+    {
+        lock_guard<mutex> lock(search_mutex);
+
+        pending_limits = limits;
+
+        is_search_pending = true;
+    }
+
+    search_state_changed.notify_all();
+}
+
+void engine_protocol::run_search_thread()
+{
+    while (true)
+    {
+        analysis_limits limits;
+
+        {
+            unique_lock<mutex> lock(search_mutex);
+
+            search_state_changed.wait(lock, [this]() {return is_search_pending || is_shutting_down;});
+
+            if (!is_search_pending)
+            {
+                return;
+            }
+
+            limits = pending_limits;
+        }
+
+        search(limits);
+
+        {
+            lock_guard<mutex> lock(search_mutex);
+
+            is_search_pending = false;
+        }
+
+        search_state_changed.notify_all();
+    }
+}
+
+void engine_protocol::search(const analysis_limits& limits)
+{
+    if (is_game_over)
+    {
+        write_line(*search_output, "bestmove (none)");
+
+        return;
+    }
+
+    try
+    {
+        const bool is_C_turn = moves.size() % 2 == 0;
+
+        const bool starting_new_game = is_new_game || last_side_searched != (is_C_turn ? 'C' : 'U');
+
+        is_new_game = false;
+
+        last_side_searched = is_C_turn ? 'C' : 'U';
+
+        protocol_engine.set_thinking_time(limits.thinking_time);
+        protocol_engine.set_max_depth_limit(limits.max_depth_limit);
+        protocol_engine.set_max_nodes_per_move(limits.max_nodes_per_move);
+
+        search_start_time = steady_clock::now();
+
+        number_of_info_lines = 0;
+
+        unique_ptr<position> pt;
+
+        if (moves.empty())
+        {
+            pt = protocol_engine.think_on_game_position(true, starting_new_game);
+        }
+
+        else if (is_C_turn)
+        {
+            pt = protocol_engine.think_on_game_position(board, true, moves.back(), squares_amplifying_C_2, squares_amplifying_C_3,
+                                                        squares_amplifying_U_2, squares_amplifying_U_3, starting_new_game);
+        }
+
+        else // U's pieces become the comp's pieces:
+        {
+            pt = protocol_engine.think_on_game_position(self_play::swap_pieces(board), true, moves.back(), squares_amplifying_U_2,
+                                                        squares_amplifying_U_3, squares_amplifying_C_2, squares_amplifying_C_3,
+                                                        starting_new_game);
+        }
+
+        if (number_of_info_lines == 0) // e.g., the endgame solver handled it, so there were no iterations.
+        {
+            write_info(*pt, protocol_engine.get_search_statistics());
+        }
+
+#ifdef SEARCH_PROFILER
+        stringstream profile_lines;
+
+        search_phase_timer::print_profile(profile_lines, search_phase_timer::profile, "info string ");
+
+        string profile_line;
+
+        while (getline(profile_lines, profile_line))
+        {
+            write_line(*search_output, profile_line);
+        }
+#endif
+
+        coordinate best_move = protocol_engine.find_best_move_for_comp(*pt);
+
+        write_line(*search_output, string("bestmove ") + static_cast<char>('a' + best_move.col));
+    }
+
+    catch (const runtime_error& error)
+    {
+        string reason = error.what();
+
+        reason.erase(remove(reason.begin(), reason.end(), '\n'), reason.end());
+
+        write_line(*search_output, "info string " + reason);
+        write_line(*search_output, "bestmove (none)");
+    }
+}
+
+bool engine_protocol::write_info(const position& root, const search_statistics& statistics)
+{
+    multi_pv_result result = root.find_multi_pv();
+
+    duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - search_start_time);
+
+    ostringstream line;
+
+    line << "info depth " << result.depth << " seldepth " << statistics.max_depth << " score " << format_score(root.get_evaluation())
+         << " nodes " << statistics.nodes << " nps " << static_cast<long long>(statistics.nodes / max(time_span.count(), 1e-6))
+         << " time " << static_cast<long long>(time_span.count() * 1000);
+
+    if (!result.lines.empty())
+    {
+        line << " pv";
+
+        for (const coordinate& current: result.lines[0].moves)
+        {
+            line << " " << static_cast<char>('a' + current.col);
+        }
+    }
+
+    write_line(*search_output, line.str());
+
+    number_of_info_lines ++;
+
+    return !stop_requested;
+}
+
+void engine_protocol::wait_for_search()
+{
+    unique_lock<mutex> lock(search_mutex);
+
+    search_state_changed.wait(lock, [this]() {return !is_search_pending;});
+}
+
+void engine_protocol::reset_board()
+{
+    moves.clear();
+
+    board = vector<vector<char>>(position::max_row_index + 1, vector<char>(position::max_col_index + 1, ' '));
+
+    squares_amplifying_C_2.clear();
+    squares_amplifying_C_3.clear();
+    squares_amplifying_U_2.clear();
+    squares_amplifying_U_3.clear();
+
+    is_game_over = false;
+}
+
+void engine_protocol::play_move(int col)
+{
+    if (is_game_over)
+    {
+        throw runtime_error("The game is already over in engine_protocol::play_move()\n");
+    }
+
+    if (col < 0 || col > position::max_col_index || board[0][col] != ' ')
+    {
+        throw runtime_error("Invalid or full column sent to engine_protocol::play_move()\n");
+    }
+
+    int row = position::max_row_index;
+
+    while (board[row][col] != ' ')
+    {
+        row --;
+    }
+
+    board[row][col] = (moves.size() % 2 == 0) ? 'C' : 'U';
+
+    moves.push_back({row, col});
+
+    // Get the position after the move with no thinking, like self_play::play_game() does, for the amplifying vectors and to see if
+    // the game is over. The turn has to be the real one ('C' to move after 'U' moved), since it decides whose threats the last move's
+    // squares are added to. With no thinking time, the endgame solver doesn't run on it.
+
+    const double old_thinking_time = protocol_engine.get_thinking_time();
+
+    protocol_engine.set_thinking_time(0);
+
+    unique_ptr<position> after_move = protocol_engine.think_on_game_position(board, moves.size() % 2 == 0, moves.back(), squares_amplifying_C_2,
+                                                                              squares_amplifying_C_3, squares_amplifying_U_2,
+                                                                              squares_amplifying_U_3, false);
+
+    protocol_engine.set_thinking_time(old_thinking_time);
+
+    squares_amplifying_C_2 = after_move->get_squares_amplifying_comp_2();
+    squares_amplifying_C_3 = after_move->get_squares_amplifying_comp_3();
+    squares_amplifying_U_2 = after_move->get_squares_amplifying_user_2();
+    squares_amplifying_U_3 = after_move->get_squares_amplifying_user_3();
+
+    is_game_over = after_move->did_computer_win() || after_move->did_opponent_win() || after_move->is_game_drawn();
+}
+
+void engine_protocol::write_line(ostream& output, const string& line)
+{
+    lock_guard<mutex> lock(output_mutex);
+
+    output << line << "\n" << flush;
+}
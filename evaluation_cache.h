@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+struct evaluation_cache_entry // One slot of the evaluation cache.
+{
+    uint64_t key; // key of the board stored in this slot (0 if the slot is empty).
+    int evaluation; // the static evaluation of that board, from the comp's perspective.
+};
+
+class evaluation_cache // Remembers static evaluations, so a board reached again doesn't have to be evaluated from scratch.
+{
+public:
+    // Unlike the position class's TT, nothing but the evaluation is stored, so far more boards fit. That helps with boards
+    // whose TT entry got replaced, or that never got one (e.g., when got_value_from_pruned_child).
+    // The key has to stand for everything the evaluation depends on. For smart_evaluation(), that's the board AND the amplifying
+    // vectors (see position::find_evaluation_cache_key()), since the same board reached by other moves can be evaluated differently.
+
+    // Constructors:
+
+    evaluation_cache(int size_log_2P = default_size_log_2); // the cache gets 2 to the power of size_log_2P slots.
+
+    // Helpers:
+    bool find(uint64_t key, int& evaluation); // returns true (and sets evaluation) if the board with key is in the cache.
+    void store(uint64_t key, int evaluation); // replaces whatever is in key's slot.
+    void reset(); // empties the cache.
+    long long get_number_of_probes() const; // how many times find() was called (PURELY FOR TESTING!).
+    long long get_number_of_hits() const; // how many times find() returned true (PURELY FOR TESTING!).
+
+    // Public static variables:
+    static const int default_size_log_2;
+
+private:
+    // Private variables:
+    vector<evaluation_cache_entry> slots; // direct-mapped: a board goes in slot find_index(key), replacing whatever was there.
+    int size_log_2;
+    long long number_of_probes;
+    long long number_of_hits;
+
+    // Private methods:
+    size_t find_index(uint64_t key) const;
+};
+
+// Initializing the static variables:
+
+const int evaluation_cache::default_size_log_2 = 18; // 4 MB.
+
+// CONSTRUCTORS:
+
+evaluation_cache::evaluation_cache(int size_log_2P)
+{
+    size_log_2 = size_log_2P;
+
+    // slots is left empty until the first call to store(), so an engine that doesn't use the cache doesn't pay for it.
+
+    number_of_probes = 0;
+    number_of_hits = 0;
+}
+
+// HELPERS:
+
+bool evaluation_cache::find(uint64_t key, int& evaluation)
+{
+    number_of_probes ++;
+
+    if (slots.empty())
+    {
+        return false;
+    }
+
+    const evaluation_cache_entry& entry = slots[find_index(key)];
+
+    if (entry.key != key)
+    {
+        return false;
+    }
+
+    number_of_hits ++;
+
+    evaluation = entry.evaluation;
+
+    return true;
+}
+
+void evaluation_cache::store(uint64_t key, int evaluation)
+{
+    if (slots.empty())
+    {
+        slots.resize(1ULL << size_log_2, {0, 0});
+    }
+
+    slots[find_index(key)] = {key, evaluation};
+}
+
+void evaluation_cache::reset()
+{
+    fill(slots.begin(), slots.end(), evaluation_cache_entry{0, 0});
+}
+
+long long evaluation_cache::get_number_of_probes() const
+{
+    return number_of_probes;
+}
+
+long long evaluation_cache::get_number_of_hits() const
+{
+    return number_of_hits;
+}
+
+// PRIVATE METHODS:
+
+size_t evaluation_cache::find_index(uint64_t key) const
+{
+    // Fibonacci hashing, like the endgame solver's TT (the key's low bits only describe the first few columns).
+
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - size_log_2);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+struct evaluation_parameters // The weights smart_evaluation() uses. The defaults are the hand-picked values it always had.
+{
+    int big_amount = 10; // points for an amplifying square that completes a 4-in-a-row (times the square's height weight).
+    int small_amount = 3; // points for an amplifying square that turns a 2-in-a-row into a 3-in-a-row (times the height weight).
+    int stacked_threat_coefficient = 5; // what a 4-in-a-row square is multiplied by if there's one of the same player's right above/below it.
+    double threat_below_opponent_threat_coefficient = 0.25; // what a square is multiplied by if the square below it wins for the opponent.
+    double threat_above_own_threat_coefficient = 0.75; // what a square is multiplied by if the square 2 below it is one of the player's own.
+
+    // Public static methods:
+
+    static bool load(const string& file_name, evaluation_parameters& parameters);
+    // Reads parameters from file_name (lines of "name value"). Returns false if the file doesn't exist. Names that aren't in
+    // the file keep their value in parameters.
+
+    static void save(const string& file_name, const evaluation_parameters& parameters);
+};
+
+bool operator==(const evaluation_parameters& first, const evaluation_parameters& second)
+{
+    return first.big_amount == second.big_amount && first.small_amount == second.small_amount &&
+           first.stacked_threat_coefficient == second.stacked_threat_coefficient &&
+           first.threat_below_opponent_threat_coefficient == second.threat_below_opponent_threat_coefficient &&
+           first.threat_above_own_threat_coefficient == second.threat_above_own_threat_coefficient;
+}
+
+bool operator!=(const evaluation_parameters& first, const evaluation_parameters& second)
+{
+    return !(first == second);
+}
+
+// PUBLIC STATIC METHODS:
+
+bool evaluation_parameters::load(const string& file_name, evaluation_parameters& parameters)
+{
+    ifstream fin(file_name);
+
+    if (fin.fail())
+    {
+        return false;
+    }
+
+    string name;
+
+    while (fin >> name)
+    {
+        if (name == "big_amount")
+        {
+            fin >> parameters.big_amount;
+        }
+
+        else if (name == "small_amount")
+        {
+            fin >> parameters.small_amount;
+        }
+
+        else if (name == "stacked_threat_coefficient")
+        {
+            fin >> parameters.stacked_threat_coefficient;
+        }
+
+        else if (name == "threat_below_opponent_threat_coefficient")
+        {
+            fin >> parameters.threat_below_opponent_threat_coefficient;
+        }
+
+        else if (name == "threat_above_own_threat_coefficient")
+        {
+            fin >> parameters.threat_above_own_threat_coefficient;
+        }
+
+        else
+        {
+            throw runtime_error("Unknown parameter name in evaluation_parameters::load()\n");
+        }
+
+        if (fin.fail())
+        {
+            throw runtime_error("Bad parameter value in evaluation_parameters::load()\n");
+        }
+    }
+
+    return true;
+}
+
+void evaluation_parameters::save(const string& file_name, const evaluation_parameters& parameters)
+{
+    ofstream fout(file_name);
+
+    if (fout.fail())
+    {
+        throw runtime_error("fout failed to open file in evaluation_parameters::save()\n");
+    }
+
+    fout << "big_amount " << parameters.big_amount << "\n";
+    fout << "small_amount " << parameters.small_amount << "\n";
+    fout << "stacked_threat_coefficient " << parameters.stacked_threat_coefficient << "\n";
+    fout << "threat_below_opponent_threat_coefficient " << parameters.threat_below_opponent_threat_coefficient << "\n";
+    fout << "threat_above_own_threat_coefficient " << parameters.threat_above_own_threat_coefficient << "\n";
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "engine.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// One game between the comp ('C') and a user ('U'): what play_game() in main.cpp used to keep track of itself. main.cpp plays a
+// session on the screen, and session_server.h plays many at once over sockets.
+
+// A session doesn't own an engine. Each call that thinks is sent the engine to use, so a few engines can take turns playing many
+// sessions. As in play_game(), the TT is kept between the comp's moves, unless the engine has thought for another game in between
+// (see think()).
+
+// The comp can have a time budget for all its moves in the game (like a chess clock): each move gets an even share of what's left,
+// for the moves the comp could still have to make. The iterative deepening finishes the iteration it's on when the time runs
+// out, so the comp can go over, and that's taken off the later moves.
+
+class game_session
+{
+public:
+    // Constructors:
+
+    game_session(bool does_comp_go_firstP, const vector<coordinate>& opening_movesP, double time_budgetP);
+    // opening_movesP are played out (by whoever is to move) before the game begins, like in get_to_chosen_starting_position().
+    // After them, the comp is to move if does_comp_go_firstP. time_budgetP of 0 means no budget: the engine's thinking_time per move.
+
+    // Helpers:
+    void start(engine& searching_engine); // plays out the opening moves, and thinks if the comp is to move after them.
+
+    coordinate play_user_move(int col); // throws runtime_error if it isn't the user's turn, or col is full or invalid.
+
+    void think(engine& searching_engine, bool is_TT_from_another_game);
+    // Gets the position after the user's move, and thinks on it for the comp (unless the user's move ended the game).
+    // Must be called after play_user_move() before anything else. If is_TT_from_another_game, the engine's TT is reset first.
+
+    coordinate play_comp_move(engine& searching_engine); // the move found by the last think() (or start()).
+
+    bool is_valid_move(string column) const; // same as position::is_valid_move() for the current board.
+
+    // Getters:
+    vector<vector<char>> get_board() const;
+    bool is_comp_turn() const;
+    bool is_game_over() const;
+    bool did_comp_win() const;
+    bool did_user_win() const;
+    long long get_TT_generation() const; // different for every game_session (see session_server.h).
+    double get_time_left() const; // of the comp's time budget.
+
+private:
+    // Private variables:
+    bool does_comp_go_first;
+    vector<coordinate> opening_moves;
+    double time_budget;
+    double time_left;
+    long long TT_generation;
+    vector<vector<char>> board;
+    unique_ptr<position> current; // the position after the last move (that was thought on). Thought on if it's the comp's turn.
+    coordinate pending_user_move; // the user's move, until think() is called (row is position::UNDEFINED if there isn't one).
+
+    // Private static variables:
+    static atomic<long long> number_of_sessions;
+
+    // Private methods:
+    unique_ptr<position> think_on_move(engine& searching_engine, bool is_comp_turnP, coordinate move, bool starting_new_game);
+    // Thinks with the comp's share of time_left if it's the comp's turn, and for no time otherwise.
+};
+
+// Initializing the static variables:
+
+atomic<long long> game_session::number_of_sessions(0);
+
+// CONSTRUCTORS:
+
+game_session::game_session(bool does_comp_go_firstP, const vector<coordinate>& opening_movesP, double time_budgetP)
+{
+    does_comp_go_first = does_comp_go_firstP;
+
+    opening_moves = opening_movesP;
+
+    time_budget = time_budgetP;
+    time_left = time_budgetP;
+
+    TT_generation = number_of_sessions++;
+
+    board = vector<vector<char>>(position::max_row_index + 1, vector<char>(position::max_col_index + 1, ' '));
+
+    pending_user_move = {position::UNDEFINED, position::UNDEFINED};
+}
+
+// HELPERS:
+
+void game_session::start(engine& searching_engine)
+{
+    // As in get_to_chosen_starting_position(): who places the first piece on the empty board depends on how many opening moves
+    // there are, the comp only thinks on the last one, and the TT is reset on every move so the comp can't use what it worked
+    // out on the way to the starting position.
+
+    const bool is_comp_turn_on_empty_board = (opening_moves.size() % 2 == 0) ? does_comp_go_first : !does_comp_go_first;
+
+    if (opening_moves.empty())
+    {
+        current = think_on_move(searching_engine, is_comp_turn_on_empty_board, {position::UNDEFINED, position::UNDEFINED}, true);
+
+        return;
+    }
+
+    const double old_thinking_time = searching_engine.get_thinking_time();
+
+    searching_engine.set_thinking_time(0);
+
+    current = searching_engine.think_on_game_position(is_comp_turn_on_empty_board, true);
+
+    for (int i = 0; i < static_cast<int>(opening_moves.size()) - 1; i++)
+    {
+        board[opening_moves[i].row][opening_moves[i].col] = current->get_is_comp_turn() ? 'C' : 'U';
+
+        current = searching_engine.think_on_game_position(board, !current->get_is_comp_turn(), opening_moves[i],
+                                                          current->get_squares_amplifying_comp_2(), current->get_squares_amplifying_comp_3(),
+                                                          current->get_squares_amplifying_user_2(), current->get_squares_amplifying_user_3(),
+                                                          true);
+    }
+
+    searching_engine.set_thinking_time(old_thinking_time);
+
+    board[opening_moves.back().row][opening_moves.back().col] = current->get_is_comp_turn() ? 'C' : 'U';
+
+    current = think_on_move(searching_engine, !current->get_is_comp_turn(), opening_moves.back(), true);
+}
+
+coordinate game_session::play_user_move(int col)
+{
+    if (pending_user_move.row != position::UNDEFINED || is_game_over() || current->get_is_comp_turn())
+    {
+        throw runtime_error("It isn't the user's turn in game_session::play_user_move()\n");
+    }
+
+    if (col < 0 || col > position::max_col_index || board[0][col] != ' ')
+    {
+        throw runtime_error("Invalid or full column sent to game_session::play_user_move()\n");
+    }
+
+    int row = position::max_row_index;
+
+    while (board[row][col] != ' ')
+    {
+        row --;
+    }
+
+    board[row][col] = 'U';
+
+    pending_user_move = {row, col};
+
+    return pending_user_move;
+}
+
+void game_session::think(engine& searching_engine, bool is_TT_from_another_game)
+{
+    if (pending_user_move.row == position::UNDEFINED)
+    {
+        throw runtime_error("game_session::think() was called without a move from the user\n");
+    }
+
+    current = think_on_move(searching_engine, true, pending_user_move, is_TT_from_another_game);
+
+    pending_user_move = {position::UNDEFINED, position::UNDEFINED};
+}
+
+coordinate game_session::play_comp_move(engine& searching_engine)
+{
+    if (pending_user_move.row != position::UNDEFINED || is_game_over() || !current->get_is_comp_turn())
+    {
+        throw runtime_error("It isn't the comp's turn in game_session::play_comp_move()\n");
+    }
+
+    coordinate best_move = searching_engine.find_best_move_for_comp(*current);
+
+    board[best_move.row][best_move.col] = 'C';
+
+    current = think_on_move(searching_engine, false, best_move, false);
+
+    return best_move;
+}
+
+bool game_session::is_valid_move(string column) const
+{
+    return current->is_valid_move(column);
+}
+
+// GETTERS:
+
+vector<vector<char>> game_session::get_board() const
+{
+    return board;
+}
+
+bool game_session::is_comp_turn() const
+{
+    return pending_user_move.row != position::UNDEFINED || current->get_is_comp_turn();
+}
+
+bool game_session::is_game_over() const
+{
+    return current->did_computer_win() || current->did_opponent_win() || current->is_game_drawn();
+}
+
+bool game_session::did_comp_win() const
+{
+    return current->did_computer_win();
+}
+
+bool game_session::did_user_win() const
+{
+    return current->did_opponent_win();
+}
+
+long long game_session::get_TT_generation() const
+{
+    return TT_generation;
+}
+
+double game_session::get_time_left() const
+{
+    return time_left;
+}
+
+// PRIVATE METHODS:
+
+unique_ptr<position> game_session::think_on_move(engine& searching_engine, bool is_comp_turnP, coordinate move, bool starting_new_game)
+{
+    const double old_thinking_time = searching_engine.get_thinking_time();
+
+    if (!is_comp_turnP)
+    {
+        searching_engine.set_thinking_time(0);
+    }
+
+    else if (time_budget > 0)
+    {
+        int pieces = 0;
+
+        for (const vector<char>& row: board)
+        {
+            pieces += count_if(row.begin(), row.end(), [](char square) {return square != ' ';});
+        }
+
+        int comp_moves_left = max(1, (43 - pieces) / 2);
+
+        searching_engine.set_thinking_time(max(0.0, time_left / comp_moves_left));
+    }
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    unique_ptr<position> pt;
+
+    if (move.row == position::UNDEFINED) // the empty board.
+    {
+        pt = searching_engine.think_on_game_position(is_comp_turnP, starting_new_game);
+    }
+
+    else
+    {
+        pt = searching_engine.think_on_game_position(board, is_comp_turnP, move, current->get_squares_amplifying_comp_2(),
+                                                     current->get_squares_amplifying_comp_3(), current->get_squares_amplifying_user_2(),
+                                                     current->get_squares_amplifying_user_3(), starting_new_game);
+    }
+
+    if (is_comp_turnP && time_budget > 0)
+    {
+        time_left -= duration_cast<duration<double>>(steady_clock::now() - start_time).count();
+    }
+
+    searching_engine.set_thinking_time(old_thinking_time);
+
+    return pt;
+}
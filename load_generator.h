@@ -0,0 +1,241 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "session_server.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// A client for measuring a session_server under load: number_of_clients connections play games at the same time, each
+// making random (legal) moves as the user and sending the next one as soon as the comp has answered. The time from sending
+// a line until its answer arrives is its latency, which includes waiting for a free worker.
+
+struct load_test_result
+{
+    int games;
+    int comp_moves; // the answers with a comp move in them (the ones the comp had to think for).
+    double seconds;
+    double comp_moves_per_second;
+    double median_latency; // in seconds, over every "new" and "move" line sent.
+    double p99_latency;
+    double max_latency;
+};
+
+class load_generator
+{
+public:
+    // Constructors:
+
+    load_generator(const string& addressP, int number_of_clientsP, int games_per_clientP, double time_budgetP);
+    // time_budgetP is sent with every "new" (0 for the server's default).
+
+    // Helpers:
+    load_test_result run(); // throws runtime_error if a client can't connect, or gets an error from the server.
+
+private:
+    // Private variables:
+    string address;
+    int number_of_clients;
+    int games_per_client;
+    double time_budget;
+
+    mutex results_mutex; // guards the variables below.
+    vector<double> latencies;
+    int games;
+    int comp_moves;
+    string first_error; // empty if no client has had an error.
+
+    // Private methods:
+    void run_client(int client_number);
+};
+
+// CONSTRUCTORS:
+
+load_generator::load_generator(const string& addressP, int number_of_clientsP, int games_per_clientP, double time_budgetP)
+{
+    address = addressP;
+
+    number_of_clients = max(1, number_of_clientsP);
+
+    games_per_client = games_per_clientP;
+
+    time_budget = time_budgetP;
+
+    games = 0;
+    comp_moves = 0;
+}
+
+// HELPERS:
+
+load_test_result load_generator::run()
+{
+    latencies.clear();
+
+    games = 0;
+    comp_moves = 0;
+
+    first_error.clear();
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    vector<thread> clients;
+
+    for (int c = 0; c < number_of_clients; c++)
+    {
+        clients.push_back(thread(&load_generator::run_client, this, c));
+    }
+
+    for (thread& client: clients)
+    {
+        client.join();
+    }
+
+    if (!first_error.empty())
+    {
+        throw runtime_error("A client of load_generator::run() failed: " + first_error + "\n");
+    }
+
+    load_test_result result;
+    result.games = games;
+    result.comp_moves = comp_moves;
+    result.seconds = duration_cast<duration<double>>(steady_clock::now() - start_time).count();
+    result.comp_moves_per_second = comp_moves / max(result.seconds, 1e-9);
+    result.median_latency = 0;
+    result.p99_latency = 0;
+    result.max_latency = 0;
+
+    if (!latencies.empty())
+    {
+        sort(latencies.begin(), latencies.end());
+
+        result.median_latency = latencies[latencies.size() / 2];
+        result.p99_latency = latencies[min(latencies.size() - 1, static_cast<size_t>(latencies.size() * 0.99))];
+        result.max_latency = latencies.back();
+    }
+
+    return result;
+}
+
+// PRIVATE METHODS:
+
+void load_generator::run_client(int client_number)
+{
+    mt19937 generator(client_number); // so a run with the same server settings plays the same games.
+
+    vector<double> client_latencies;
+
+    int client_games = 0;
+    int client_comp_moves = 0;
+
+    string error;
+
+    try
+    {
+        int connection = session_server::open_connection(address);
+
+        string unread_input;
+
+        // Sends line, and returns the answer (timing it):
+
+        auto ask = [&](const string& line)
+        {
+            steady_clock::time_point sent_time = steady_clock::now();
+
+            session_server::send_line(connection, line);
+
+            string answer;
+
+            if (!session_server::receive_line(connection, unread_input, answer))
+            {
+                throw runtime_error("the server closed the connection");
+            }
+
+            client_latencies.push_back(duration_cast<duration<double>>(steady_clock::now() - sent_time).count());
+
+            if (answer.compare(0, 5, "error") == 0)
+            {
+                throw runtime_error(answer);
+            }
+
+            return answer;
+        };
+
+        for (int game = 0; game < games_per_client; game++)
+        {
+            vector<int> pieces_per_column(position::max_col_index + 1, 0);
+
+            string answer = ask((generator() % 2 == 0 ? "new comp " : "new user ") + to_string(time_budget));
+
+            while (true)
+            {
+                istringstream words(answer);
+
+                string word;
+
+                words >> word;
+
+                if (word == "move")
+                {
+                    words >> word;
+
+                    pieces_per_column[word[0] - 'a'] ++;
+
+                    client_comp_moves ++;
+
+                    words >> word; // "result" if the comp's move ended the game.
+                }
+
+                if (word == "result")
+                {
+                    break;
+                }
+
+                vector<int> open_columns;
+
+                for (int col = 0; col <= position::max_col_index; col++)
+                {
+                    if (pieces_per_column[col] <= position::max_row_index)
+                    {
+                        open_columns.push_back(col);
+                    }
+                }
+
+                int col = open_columns[generator() % open_columns.size()];
+
+                pieces_per_column[col] ++;
+
+                answer = ask(string("move ") + static_cast<char>('a' + col));
+            }
+
+            client_games ++;
+        }
+
+        session_server::send_line(connection, "quit");
+
+        session_server::close_connection(connection);
+    }
+
+    catch (const exception& exception_thrown)
+    {
+        error = exception_thrown.what();
+    }
+
+    lock_guard<mutex> lock(results_mutex);
+
+    latencies.insert(latencies.end(), client_latencies.begin(), client_latencies.end());
+
+    games += client_games;
+    comp_moves += client_comp_moves;
+
+    if (first_error.empty())
+    {
+        first_error = error;
+    }
+}
@@ -10,8 +10,17 @@
 #include <ctime>
 #include <ratio>
 #include <chrono>
+#include <random>
 
 #include "position.h"
+#include "moves_reaching_positions.h"
+#include "self_play.h"
+#include "parameter_tuner.h"
+#include "batch_analyzer.h"
+#include "engine_protocol.h"
+#include "game_session.h"
+#include "session_server.h"
+#include "load_generator.h"
 
 using namespace std;
 
@@ -155,19 +164,19 @@ void remove_set_at_index(vector<vector<coordinate>>& vec, int index)
     vec.pop_back();
 }
 
-unique_ptr<position> get_to_chosen_starting_position(bool does_comp_go_first, const vector<coordinate> set_of_moves)
+unique_ptr<position> get_to_chosen_starting_position(engine& replay_engine, bool does_comp_go_first, const vector<coordinate> set_of_moves)
 {
-    // Get the Engine to play out the set_of_moves param, and only think for a reasonable amount of time
-    // on the last move (since that's where the game begins).
+    // Get replay_engine to play out the set_of_moves param, and only think for its thinking_time
+    // on the last move (since that's where the game begins). The position returned must not outlive replay_engine.
 
     if (set_of_moves.empty())
     {
         throw runtime_error("set_of_moves is empty in get_to_chosen_starting_position()\n");
     }
 
-    const double old_thinking_time = position::thinking_time;
+    const double old_thinking_time = replay_engine.get_thinking_time();
 
-    position::thinking_time = 0; // temporarily reducing it, until reaching the actual starting position for the game.
+    replay_engine.set_thinking_time(0); // temporarily reducing it, until reaching the actual starting position for the game.
 
     // Now, I need to figure out if a 'C' or 'U' should be played first on the empty board.
     // The "does_comp_go_first" param stores who goes first in the actual starting position played, 4-9 moves later.
@@ -181,13 +190,13 @@ unique_ptr<position> get_to_chosen_starting_position(bool does_comp_go_first, co
         does_comp_move_first_in_empty_board = false;
     }
 
-    unique_ptr<position> pt = position::think_on_game_position(does_comp_move_first_in_empty_board, true);
+    unique_ptr<position> pt = replay_engine.think_on_game_position(does_comp_move_first_in_empty_board, true);
 
-    for (int i = 0; i < set_of_moves.size(); i++)
+    for (int i = 0; i < static_cast<int>(set_of_moves.size()); i++)
     {
-        if (i == set_of_moves.size()-1) // On the move that yields the starting position, so return thinking_time to its original value:
+        if (i == static_cast<int>(set_of_moves.size()) - 1) // On the move that yields the starting position, so return thinking_time to its original value:
         {
-            position::thinking_time = old_thinking_time;
+            replay_engine.set_thinking_time(old_thinking_time);
         }
 
         vector<vector<char>> temp_board = pt->get_board();
@@ -202,22 +211,22 @@ unique_ptr<position> get_to_chosen_starting_position(bool does_comp_go_first, co
             temp_board[set_of_moves[i].row][set_of_moves[i].col] = 'U';
         }
 
-        pt = position::think_on_game_position(temp_board, !pt->get_is_comp_turn(), set_of_moves[i], pt->get_squares_amplifying_comp_2(),
-                                              pt->get_squares_amplifying_comp_3(), pt->get_squares_amplifying_user_2(),
-                                              pt->get_squares_amplifying_user_3(), true);
+        pt = replay_engine.think_on_game_position(temp_board, !pt->get_is_comp_turn(), set_of_moves[i], pt->get_squares_amplifying_comp_2(),
+                                                  pt->get_squares_amplifying_comp_3(), pt->get_squares_amplifying_user_2(),
+                                                  pt->get_squares_amplifying_user_3(), true);
                                               // Sending "true" for starting new game since I don't want the TT used. In order to be fair, the comp
                                               // shouldn't be able to use calculations it did to get to the starting position.
     }
 
-    if (position::thinking_time != old_thinking_time)
+    if (replay_engine.get_thinking_time() != old_thinking_time)
     {
         throw runtime_error("thinking_time was not reset to its standard value!\n");
     }
 
-    return move(pt);
+    return pt;
 }
 
-int get_column_user_wants_to_move_in(const unique_ptr<position>& pt)
+int get_column_user_wants_to_move_in(const game_session& session)
 {
     // Function returns the column the user wants to move in:
 
@@ -231,7 +240,7 @@ int get_column_user_wants_to_move_in(const unique_ptr<position>& pt)
 
     cin.ignore(INT_MAX, '\n');
 
-    while (!pt->is_valid_move(user_input))
+    while (!session.is_valid_move(user_input))
     {
         cout << "You entered an invalid move. Please try again: ";
 
@@ -267,7 +276,7 @@ void wait(double waiting_time)
     }
 }
 
-void play_game(vector<vector<coordinate>>& moves_reaching_starting_positions)
+void play_game(vector<vector<coordinate>>& moves_reaching_starting_positions, engine& game_engine)
 {
     bool user_goes_first = false;
     bool x_represents_user = false;
@@ -283,13 +292,13 @@ void play_game(vector<vector<coordinate>>& moves_reaching_starting_positions)
     remove_set_at_index(moves_reaching_starting_positions, random_index); // function will replace the bad set with the last set in the vector
                                                                           // and then pop_back.
 
-    unique_ptr<position> pos = get_to_chosen_starting_position(!user_goes_first, chosen_set_of_moves);
+    game_session session(!user_goes_first, chosen_set_of_moves, 0); // 0 for no time budget, so the comp thinks for thinking_time per move.
 
-    vector<vector<char>> assisting_board = pos->get_board();
+    session.start(game_engine);
 
     cout << "\nSTARTING POSITION:\n";
 
-    display_board(assisting_board, x_represents_user, true, {position::UNDEFINED, position::UNDEFINED});
+    display_board(session.get_board(), x_represents_user, true, {position::UNDEFINED, position::UNDEFINED});
     // UNDEFINED for last_move since this is the starting position.
 
     if (!user_goes_first) // comp moving first, so want to wait a bit to get the starting position displayed.
@@ -297,191 +306,981 @@ void play_game(vector<vector<coordinate>>& moves_reaching_starting_positions)
        wait(0.8);
     }
 
-    while (!pos->did_computer_win() && !pos->did_opponent_win() && !pos->is_game_drawn()) // while the game is still going on...
+    while (!session.is_game_over()) // while the game is still going on...
     {
-        if (pos->get_is_comp_turn()) // computer's turn:
+        if (session.is_comp_turn()) // computer's turn:
         {
-            coordinate best_move = pos->find_best_move_for_comp();
+            coordinate best_move = session.play_comp_move(game_engine);
             // This is the move the computer should play in this position.
 
-            assisting_board[best_move.row][best_move.col] = 'C';
+            cout << "\n\n";
 
-            double old_thinking_time = position::thinking_time;
+            display_board(session.get_board(), x_represents_user, false, best_move);
+        }
 
-            position::thinking_time = 0;
+        else // user's turn:
+        {
+            cout << "\n\n\n";
 
-            pos = position::think_on_game_position(assisting_board, false, best_move, pos->get_squares_amplifying_comp_2(),
-                                                   pos->get_squares_amplifying_comp_3(), pos->get_squares_amplifying_user_2(),
-                                                   pos->get_squares_amplifying_user_3(), false);
+            int col = get_column_user_wants_to_move_in(session);
 
-            position::thinking_time = old_thinking_time;
+            coordinate move_chosen_by_user = session.play_user_move(col);
 
-            cout << "\n\n";
+            display_board(session.get_board(), x_represents_user, false, move_chosen_by_user);
+
+            cout << "\n";
 
-            display_board(assisting_board, x_represents_user, false, best_move);
+            session.think(game_engine, false); // the comp thinks on its next move here.
         }
+    }
 
-        else // user's turn:
-        {
-            cout << "\n\n\n";
+    cout << "\n\n\n";
 
-            int col = get_column_user_wants_to_move_in(pos);
+    // At this point, the game has ended. I should display the winner:
 
-            // Now to make the user's move on the assisting_board:
+    if (session.did_comp_win())
+    {
+        cout << "The computer won!\n\n";
+    }
 
-            int row = position::max_row_index;
+    else if (session.did_user_win())
+    {
+        cout << "You won!\n\n";
+    }
 
-            coordinate move_chosen_by_user{position::UNDEFINED, position::UNDEFINED};
+    else
+    {
+        cout << "The game is a draw!\n\n";
+    }
+}
 
-            while (row >= 0)
-            {
-                if (assisting_board[row][col] == ' ') // empty square... move a piece here:
-                {
-                    assisting_board[row][col] = 'U';
+void generate_endgame_database(int argc, char* argv[])
+{
+    // Usage: generate_endgame_database <max empty squares> [number of threads] [file of moves reaching the root positions]
+    // With no file of moves, the only root is the empty board. Part files are kept in the current directory, so running the same
+    // command again after an interruption continues where it left off.
 
-                    move_chosen_by_user.row = row;
+    int max_empty_squares = atoi(argv[2]);
 
-                    move_chosen_by_user.col = col;
+    int number_of_threads = thread::hardware_concurrency();
 
-                    break;
-                }
+    if (argc > 3)
+    {
+        number_of_threads = atoi(argv[3]);
+    }
 
-                row --;
-            }
+    vector<bitboard> roots;
+
+    if (argc > 4)
+    {
+        vector<vector<coordinate>> sets_of_moves;
 
-            if (row < 0 || move_chosen_by_user.row == position::UNDEFINED)
+        read_file_into_vector(sets_of_moves, argv[4]);
+
+        for (const vector<coordinate>& current_set: sets_of_moves)
+        {
+            bitboard root;
+
+            for (const coordinate& current_move: current_set)
             {
-                throw runtime_error("row variable in play_game() is smaller than 0, or there is no move chosen by the user recorded.\n");
+                root.play(current_move.col);
             }
 
-            display_board(assisting_board, x_represents_user, false, move_chosen_by_user);
+            roots.push_back(root);
+        }
+    }
 
-            cout << "\n";
+    else
+    {
+        roots.push_back(bitboard());
+    }
 
-            pos = position::think_on_game_position(assisting_board, true, move_chosen_by_user, pos->get_squares_amplifying_comp_2(),
-                                                   pos->get_squares_amplifying_comp_3(), pos->get_squares_amplifying_user_2(),
-                                                   pos->get_squares_amplifying_user_3(), false);
-        }
+    endgame_database_generator generator(max_empty_squares, number_of_threads, ".");
+
+    generator.generate(roots, "EndgameDatabase.bin");
+}
+
+void get_starting_positions(engine& replay_engine, int number_of_positions, vector<unique_ptr<position>>& starts)
+{
+    // Fills starts with the first number_of_positions starting positions in MovesReachingPositions.txt (all with the comp to move),
+    // played out by replay_engine (which they must not outlive).
+
+    vector<vector<coordinate>> sets_of_moves;
+
+    read_file_into_vector(sets_of_moves);
+
+    number_of_positions = min(number_of_positions, static_cast<int>(sets_of_moves.size()));
+
+    const double old_thinking_time = replay_engine.get_thinking_time();
+
+    replay_engine.set_thinking_time(0);
+
+    for (int i = 0; i < number_of_positions; i++)
+    {
+        starts.push_back(get_to_chosen_starting_position(replay_engine, true, sets_of_moves[i]));
     }
 
-    cout << "\n\n\n";
+    replay_engine.set_thinking_time(old_thinking_time);
+}
 
-    // At this point, the game has ended. I should display the winner:
+void benchmark_engine_settings(const vector<engine_settings>& settings, const vector<string>& names, int depth, int number_of_positions)
+{
+    // Each of the settings thinks on each starting position until depth_limit reaches depth (with an empty TT each time).
+    // Their times and node counts (number of position objects created) are compared, along with how often their evaluation
+    // differs from the first settings' evaluation.
+
+    engine benchmark_engine;
+
+    vector<unique_ptr<position>> starts;
 
-    if (pos->did_computer_win())
+    get_starting_positions(benchmark_engine, number_of_positions, starts);
+
+    benchmark_engine.set_max_depth_limit(depth);
+
+    benchmark_engine.set_thinking_time(1000000); // so only max_depth_limit (or a proven result) stops the iterative deepening.
+
+    vector<double> total_time(settings.size(), 0.0);
+    vector<long long> total_nodes(settings.size(), 0);
+    vector<long long> total_quiescence_nodes(settings.size(), 0);
+    vector<long long> total_researches(settings.size(), 0);
+    vector<long long> total_null_window_researches(settings.size(), 0);
+    vector<long long> total_futile_moves(settings.size(), 0);
+    vector<int> number_of_different_evaluations(settings.size(), 0);
+    vector<long long> total_cache_probes(settings.size(), 0);
+    vector<long long> total_cache_hits(settings.size(), 0);
+
+    for (const unique_ptr<position>& start: starts)
     {
-        cout << "The computer won!\n\n";
+        int first_evaluation = 0;
+
+        for (int s = 0; s < static_cast<int>(settings.size()); s++)
+        {
+            benchmark_engine.set_settings(settings[s]);
+
+            benchmark_engine.reset_evaluation_cache(); // like the TT, the cache starts off empty for each search.
+
+            const engine_state& state = benchmark_engine.get_state();
+
+            long long old_nodes = state.counter;
+            long long old_quiescence_nodes = state.quiescence_counter;
+            long long old_researches = state.late_move_research_counter;
+            long long old_null_window_researches = state.null_window_research_counter;
+            long long old_futile_moves = state.futility_pruning_counter;
+            long long old_cache_probes = state.smart_evaluation_cache.get_number_of_probes();
+            long long old_cache_hits = state.smart_evaluation_cache.get_number_of_hits();
+
+            steady_clock::time_point start_time = steady_clock::now();
+
+            unique_ptr<position> pt = benchmark_engine.think_on_game_position(start->get_board(), start->get_is_comp_turn(), start->get_last_move(),
+                                                                              start->get_squares_amplifying_comp_2(), start->get_squares_amplifying_comp_3(),
+                                                                              start->get_squares_amplifying_user_2(), start->get_squares_amplifying_user_3(),
+                                                                              true);
+
+            duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+            total_time[s] += time_span.count();
+            total_nodes[s] += state.counter - old_nodes;
+            total_quiescence_nodes[s] += state.quiescence_counter - old_quiescence_nodes;
+            total_researches[s] += state.late_move_research_counter - old_researches;
+            total_null_window_researches[s] += state.null_window_research_counter - old_null_window_researches;
+            total_futile_moves[s] += state.futility_pruning_counter - old_futile_moves;
+            total_cache_probes[s] += state.smart_evaluation_cache.get_number_of_probes() - old_cache_probes;
+            total_cache_hits[s] += state.smart_evaluation_cache.get_number_of_hits() - old_cache_hits;
+
+            if (s == 0)
+            {
+                first_evaluation = pt->get_evaluation();
+            }
+
+            else if (pt->get_evaluation() != first_evaluation)
+            {
+                number_of_different_evaluations[s] ++;
+            }
+        }
     }
 
-    else if (pos->did_opponent_win())
+    for (int s = 0; s < static_cast<int>(settings.size()); s++)
     {
-        cout << "You won!\n\n";
+        cout << names[s] << ": " << total_time[s] << " seconds, " << total_nodes[s] << " nodes ("
+             << total_quiescence_nodes[s] << " in quiescence_search()), " << total_researches[s] << " late move re-searches, "
+             << total_futile_moves[s] << " futile moves skipped";
+
+        if (total_null_window_researches[s] > 0)
+        {
+            cout << ", " << total_null_window_researches[s] << " null window re-searches";
+        }
+
+        if (total_cache_probes[s] > 0)
+        {
+            cout << ", " << total_cache_hits[s] << " of " << total_cache_probes[s] << " evaluations found in the evaluation cache";
+        }
+
+        if (s > 0)
+        {
+            cout << ", evaluation differs from " << names[0] << " in " << number_of_different_evaluations[s] << " of " << starts.size();
+        }
+
+        cout << "\n";
     }
+}
 
-    else
+void benchmark_search_drivers(int argc, char* argv[])
+{
+    // Usage: benchmark_search_drivers <depth> [number of starting positions]
+    // (Each driver fills the TT differently, which can change the evaluation a little at the same depth.)
+
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    benchmark_engine_settings({{ALPHA_BETA, false, false, SMART_EVALUATION, false, false}, {MTD_F, false, false, SMART_EVALUATION, false, false},
+                               {PVS, false, false, SMART_EVALUATION, false, false}}, {"alpha-beta", "MTD(f)", "PVS"}, atoi(argv[2]), number_of_positions);
+}
+
+void benchmark_evaluation_cache(int argc, char* argv[])
+{
+    // Usage: benchmark_evaluation_cache <depth> [number of starting positions]
+
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    benchmark_engine_settings({{ALPHA_BETA, false, false, SMART_EVALUATION, true, false}, {ALPHA_BETA, false, false, SMART_EVALUATION, true, true}},
+                              {"no evaluation cache", "evaluation cache"}, atoi(argv[2]), number_of_positions);
+}
+
+void benchmark_pruning(int argc, char* argv[])
+{
+    // Usage: benchmark_pruning <depth> [number of starting positions] [match]
+    // Compares the nodes and time needed to reach depth with late move reductions and/or futility pruning. With "match", each of them
+    // also plays every starting position twice (once with each colour) at that depth against the search without them.
+
+    int depth = atoi(argv[2]);
+
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    const engine_settings plain = {ALPHA_BETA, false, false, SMART_EVALUATION, false, false};
+
+    const vector<engine_settings> settings = {plain, {ALPHA_BETA, true, false, SMART_EVALUATION, false, false}, {ALPHA_BETA, false, true, SMART_EVALUATION, false, false}, {ALPHA_BETA, true, true, SMART_EVALUATION, false, false}};
+    const vector<string> names = {"no reductions or futility pruning", "late move reductions", "futility pruning", "both"};
+
+    benchmark_engine_settings(settings, names, depth, number_of_positions);
+
+    if (argc > 4 && string(argv[4]) == "match")
     {
-        cout << "The game is a draw!\n\n";
+        engine match_engine;
+
+        vector<unique_ptr<position>> starts;
+
+        get_starting_positions(match_engine, number_of_positions, starts);
+
+        match_engine.set_max_depth_limit(depth);
+
+        match_engine.set_thinking_time(1000000);
+
+        for (int s = 1; s < static_cast<int>(settings.size()); s++)
+        {
+            match_result result = self_play::play_match(match_engine, starts, settings[s], plain);
+
+            cout << names[s] << " vs " << names[0] << ": +" << result.wins << " =" << result.draws << " -" << result.losses << "\n";
+        }
     }
 }
 
-void read_file_into_vector(vector<vector<coordinate>>& vec)
+void benchmark_evaluators(int argc, char* argv[])
 {
-    ifstream fin("MovesReachingPositions.txt");
+    // Usage: benchmark_evaluators <depth> [number of starting positions] [match]
+    // Compares the nodes and time needed to reach depth with each static evaluation. With "match", each of the other evaluations
+    // also plays every starting position twice (once with each colour) at that depth against smart_evaluation().
+
+    int depth = atoi(argv[2]);
 
-    if (fin.fail())
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    const vector<engine_settings> settings = {{ALPHA_BETA, false, false, SMART_EVALUATION, false, false}, {ALPHA_BETA, false, false, PATTERN_TABLE_EVALUATION, false, false},
+                                              {ALPHA_BETA, false, false, SMART_EVALUATION, true, false}};
+    const vector<string> names = {"smart_evaluation()", "pattern table evaluation", "smart_evaluation() with frontier move ordering"};
+
+    benchmark_engine_settings(settings, names, depth, number_of_positions);
+
+    if (argc > 4 && string(argv[4]) == "match")
     {
-        throw runtime_error("fin failed to read file in read_file_into_vector() function.\n");
+        engine match_engine;
+
+        vector<unique_ptr<position>> starts;
+
+        get_starting_positions(match_engine, number_of_positions, starts);
+
+        match_engine.set_max_depth_limit(depth);
+
+        match_engine.set_thinking_time(1000000);
+
+        for (int s = 1; s < static_cast<int>(settings.size()); s++)
+        {
+            match_result result = self_play::play_match(match_engine, starts, settings[s], settings[0]);
+
+            cout << names[s] << " vs " << names[0] << ": +" << result.wins << " =" << result.draws << " -" << result.losses << "\n";
+        }
     }
+}
+
+void check_move_ordering_kernels(int argc, char* argv[])
+{
+    // Usage: check_move_ordering_kernels [number of games]
+    // Plays random games, and checks that batch_evaluator's AVX2 kernel gives the same score as the scalar one for every move
+    // of every position. Throws an exception at the first difference.
+
+    int number_of_games = (argc > 2) ? atoi(argv[2]) : 10000;
 
-    coordinate current_move_found;
-    current_move_found.row = position::UNDEFINED;
-    current_move_found.col = position::UNDEFINED;
+    if (!batch_evaluator::is_avx2_supported)
+    {
+        cout << "This CPU (or compiler) can't run the AVX2 kernel, so only the scalar kernel is used.\n";
 
-    vector<coordinate> empty_vec;
+        return;
+    }
 
-    vec.push_back(empty_vec);
+    mt19937 generator(0); // so a failure can be reproduced.
 
-    char c = fin.get();
+    long long number_of_positions = 0;
 
-    while (!fin.eof())
+    for (int game = 0; game < number_of_games; game++)
     {
-        if (c - '0' >= 0 && c - '0' <= 9) // is a digit, so work with it...
+        bitboard current;
+
+        while (current.possible() != 0)
         {
-            if (current_move_found.row == position::UNDEFINED)
+            vector<uint64_t> move_bits;
+            vector<int> columns;
+
+            for (int col = 0; col < bitboard::width; col++)
             {
-                current_move_found.row = c - '0';
+                if (current.can_play(col))
+                {
+                    move_bits.push_back(current.possible() & bitboard::column_mask(col));
+
+                    columns.push_back(col);
+                }
             }
 
-            else
+            vector<int> scalar_scores, avx2_scores;
+
+            batch_evaluator::evaluate_moves_scalar(current, move_bits, scalar_scores);
+            batch_evaluator::evaluate_moves_avx2(current, move_bits, avx2_scores);
+
+            if (scalar_scores != avx2_scores)
             {
-                current_move_found.col = c - '0';
+                throw runtime_error("The AVX2 and scalar move ordering kernels differ in game " + to_string(game) + ", after " +
+                                    to_string(current.number_of_moves) + " moves.\n");
+            }
 
-                vec[vec.size()-1].push_back(current_move_found);
+            number_of_positions ++;
 
-                // Now reset current_move_found:
+            int col = columns[generator() % columns.size()];
 
-                current_move_found.row = position::UNDEFINED;
-                current_move_found.col = position::UNDEFINED;
+            if (current.is_winning_move(col))
+            {
+                break;
             }
+
+            current.play(col);
         }
+    }
+
+    cout << "The kernels agree on all " << number_of_positions << " positions.\n";
+}
+
+void check_smart_evaluation(int argc, char* argv[])
+{
+    // Usage: check_smart_evaluation <depth> [number of starting positions]
+    // Thinks on each starting position until depth_limit reaches depth, with each search driver and with both kinds of pruning
+    // (so the leaves are reached by different moves), and checks that smart_evaluation() gives the same evaluation as
+    // smart_evaluation_with_board_copies() for every leaf. Throws an exception at the first difference.
+
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    engine checking_engine;
+
+    vector<unique_ptr<position>> starts;
+
+    get_starting_positions(checking_engine, number_of_positions, starts);
+
+    checking_engine.set_max_depth_limit(atoi(argv[2]));
+
+    checking_engine.set_thinking_time(1000000); // so only max_depth_limit (or a proven result) stops the iterative deepening.
+
+    checking_engine.set_check_smart_evaluation(true);
+
+    const vector<engine_settings> settings = {{ALPHA_BETA, false, false, SMART_EVALUATION, true, false}, {MTD_F, false, false, SMART_EVALUATION, true, false},
+                                              {PVS, true, true, SMART_EVALUATION, true, false}};
 
-        else if (c == '\n')
+    for (const engine_settings& current_settings: settings)
+    {
+        checking_engine.set_settings(current_settings);
+
+        for (const unique_ptr<position>& start: starts)
         {
-            // About to be a new line in the file (representing a set of moves), so create a new spot in the param vector:
+            checking_engine.think_on_game_position(start->get_board(), start->get_is_comp_turn(), start->get_last_move(),
+                                                   start->get_squares_amplifying_comp_2(), start->get_squares_amplifying_comp_3(),
+                                                   start->get_squares_amplifying_user_2(), start->get_squares_amplifying_user_3(), true);
+        }
+    }
+
+    cout << "smart_evaluation() and smart_evaluation_with_board_copies() agree on all " << checking_engine.get_state().smart_evaluation_check_counter
+         << " evaluations.\n";
+}
+
+void tune_evaluation_parameters(int argc, char* argv[])
+{
+    // Usage: tune <number of game pairs> [threads] [nodes per move] [output file]
+    // Tunes smart_evaluation()'s weights with self-play games from all the starting positions in MovesReachingPositions.txt,
+    // starting from the weights in the output file if it exists (so tuning can be continued), and writes the result there.
+
+    int number_of_game_pairs = atoi(argv[2]);
+
+    int number_of_threads = (argc > 3) ? atoi(argv[3]) : max(1, static_cast<int>(thread::hardware_concurrency()));
+
+    int nodes_per_move = (argc > 4) ? atoi(argv[4]) : 2000;
+
+    const string file_name = (argc > 5) ? argv[5] : "EvaluationParameters.txt";
+
+    evaluation_parameters start_parameters;
+
+    evaluation_parameters::load(file_name, start_parameters);
+
+    engine replay_engine;
+
+    vector<unique_ptr<position>> starts;
+
+    get_starting_positions(replay_engine, INT_MAX, starts);
+
+    parameter_tuner tuner(starts, engine_settings(), number_of_threads, nodes_per_move);
+
+    evaluation_parameters tuned_parameters = tuner.tune(start_parameters, number_of_game_pairs);
+
+    evaluation_parameters::save(file_name, tuned_parameters);
+
+    cout << 2 * number_of_game_pairs << " games on " << number_of_threads << " threads, "
+         << tuner.get_games_per_second_per_thread() << " games per second per thread. Written to " << file_name << ":\n";
+
+    vector<double> values = parameter_tuner::to_vector(tuned_parameters);
+
+    for (double value: values)
+    {
+        cout << value << " ";
+    }
+
+    cout << "\n";
+}
 
-            vec.push_back(empty_vec);
+void analyze_positions(int argc, char* argv[])
+{
+    // Usage: analyze [threads] [depth=<n>] [nodes=<n>] [time=<seconds>] [openings]
+    // Analyzes the positions read from standard input (see batch_analyzer.h for the format), or with "openings", every starting
+    // position in MovesReachingPositions.txt. The limits given here are the defaults for every position. If there's a depth or
+    // node limit but no time limit, there's no time limit at all.
+
+    int number_of_threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+
+    analysis_limits default_limits = {42, 0, 0.0};
+
+    bool use_openings = false;
+
+    string limits = "-"; // parsed just like a position's own limits (for the empty board).
+
+    for (int i = 2; i < argc; i++)
+    {
+        const string argument = argv[i];
 
-            // Note that if that '\n' was the last newline character in the file, then vec's last element will be an empty vector.
+        if (argument == "openings")
+        {
+            use_openings = true;
+        }
 
-            // So, I take care of this near the end of the function.
+        else if (argument.find('=') != string::npos)
+        {
+            limits += " " + argument;
         }
 
-        else if (c != '(' && c != ')' && c != ',' && c != ' ')
+        else
         {
-            // c doesn't equal any of the other allowable characters in the file. Something's wrong:
+            number_of_threads = atoi(argv[i]);
+        }
+    }
+
+    default_limits = batch_analyzer::parse_request(limits, default_limits).limits;
+
+    if (default_limits.thinking_time == 0.0)
+    {
+        bool has_other_limit = default_limits.max_depth_limit < 42 || default_limits.max_nodes_per_move > 0;
+
+        default_limits.thinking_time = has_other_limit ? 1000000 : engine_state::default_thinking_time;
+    }
+
+    batch_analyzer analyzer(number_of_threads, default_limits);
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    if (use_openings)
+    {
+        vector<vector<coordinate>> sets_of_moves;
+
+        read_file_into_vector(sets_of_moves);
+
+        stringstream openings;
+
+        for (const vector<coordinate>& current_set: sets_of_moves)
+        {
+            for (const coordinate& current_move: current_set)
+            {
+                openings << char('a' + current_move.col);
+            }
+
+            openings << "\n";
+        }
+
+        analyzer.analyze(openings, cout);
+    }
+
+    else
+    {
+        analyzer.analyze(cin, cout);
+    }
+
+    duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+    cerr << "Analyzed in " << time_span.count() << " seconds on " << number_of_threads << " threads.\n";
+}
+
+void print_search_statistics(int argc, char* argv[])
+{
+    // Usage: search_statistics <depth> [number of starting positions]
+    // Thinks on each starting position until depth_limit reaches depth (with an empty TT each time), and prints what the iterations
+    // at each depth_limit did, summed over the positions (see search_statistics in position.h). With 1 position, that's just its
+    // iterations. The time of an iteration includes everything think_on_game_position() did since the one before it.
+    // If compiled with SEARCH_PROFILER, it also prints how the time was split between the phases of the searches.
+
+    int depth = atoi(argv[2]);
+
+    int number_of_positions = (argc > 3) ? atoi(argv[3]) : INT_MAX;
+
+    engine statistics_engine;
+
+    vector<unique_ptr<position>> starts;
+
+    get_starting_positions(statistics_engine, number_of_positions, starts);
+
+    statistics_engine.set_max_depth_limit(depth);
+
+    statistics_engine.set_thinking_time(1000000); // so only max_depth_limit (or a proven result) stops the iterative deepening.
+
+    vector<search_statistics> totals(depth + 1, search_statistics{}); // index i for the iterations at depth_limit i.
+
+    vector<int> number_of_iterations(depth + 1, 0);
+
+    search_statistics previous = {};
+
+    search_profile total_profile = {}; // only filled in if compiled with SEARCH_PROFILER (see search_profiler.h).
+
+    statistics_engine.set_iteration_callback([&](const position& root)
+    {
+        // The engine's statistics are for the whole search so far, so the iteration's share is the change since the last one:
 
-            throw runtime_error("Found an unexpected character in the file in read_file_into_vector()\n");
+        const search_statistics current = statistics_engine.get_search_statistics();
+
+        search_statistics& total = totals[current.depth_limit];
+
+        total.nodes += current.nodes - previous.nodes;
+        total.leaf_nodes += current.leaf_nodes - previous.leaf_nodes;
+        total.quiescence_nodes += current.quiescence_nodes - previous.quiescence_nodes;
+        total.TT_cutoffs += current.TT_cutoffs - previous.TT_cutoffs;
+        total.beta_cutoffs += current.beta_cutoffs - previous.beta_cutoffs;
+
+        for (int i = 0; i <= position::max_col_index; i++)
+        {
+            total.beta_cutoffs_by_move_index[i] += current.beta_cutoffs_by_move_index[i] - previous.beta_cutoffs_by_move_index[i];
         }
 
-        c = fin.get();
+        total.max_depth = max(total.max_depth, current.max_depth);
+        total.seconds += current.seconds - previous.seconds;
+
+        number_of_iterations[current.depth_limit] ++;
+
+        previous = current;
+
+        return true;
+    });
+
+    for (const unique_ptr<position>& start: starts)
+    {
+        previous = {};
+
+        statistics_engine.think_on_game_position(start->get_board(), start->get_is_comp_turn(), start->get_last_move(),
+                                                 start->get_squares_amplifying_comp_2(), start->get_squares_amplifying_comp_3(),
+                                                 start->get_squares_amplifying_user_2(), start->get_squares_amplifying_user_3(), true);
+
+        for (int p = 0; p < NUMBER_OF_SEARCH_PHASES; p++)
+        {
+            total_profile.calls[p] += search_phase_timer::profile.calls[p];
+            total_profile.nanoseconds[p] += search_phase_timer::profile.nanoseconds[p];
+        }
     }
 
-    if (vec[vec.size()-1].size() == 0)
+    cout << "depth iterations nodes leaves quiescence TT_cutoffs beta_cutoffs (by move index) max_depth seconds NPS\n";
+
+    for (int d = 1; d <= depth; d++)
     {
-        // The last set of moves in vec is empty, which makes sense.
+        const search_statistics& total = totals[d];
 
-        vec.pop_back();
+        if (number_of_iterations[d] == 0) // every search was over before this depth (e.g., a forced win was found).
+        {
+            continue;
+        }
+
+        cout << d << " " << number_of_iterations[d] << " " << total.nodes << " " << total.leaf_nodes << " " << total.quiescence_nodes
+             << " " << total.TT_cutoffs << " " << total.beta_cutoffs << " (";
+
+        for (int i = 0; i <= position::max_col_index; i++)
+        {
+            cout << (i > 0 ? " " : "") << total.beta_cutoffs_by_move_index[i];
+        }
+
+        cout << ") " << total.max_depth << " " << total.seconds << " " << static_cast<long long>(total.nodes / max(total.seconds, 1e-9))
+             << "\n";
     }
+
+#ifdef SEARCH_PROFILER
+    cout << "\nTime in each phase of the searches:\n";
+
+    search_phase_timer::print_profile(cout, total_profile, "");
+#endif
 }
 
-bool are_all_moves_valid(const vector<vector<coordinate>>& vec)
+void get_moves_from_columns(const string& columns, vector<coordinate>& set_of_moves)
 {
-    for (const vector<coordinate>& current_set: vec)
+    // Turns the columns of a game's moves (e.g., "ddce") into the squares they land on, for get_to_chosen_starting_position().
+
+    set_of_moves.clear();
+
+    vector<int> pieces_per_column(position::max_col_index + 1, 0);
+
+    for (char c: columns)
     {
-        if (current_set.empty() || current_set.size() < 4 || current_set.size() > 9)
+        int col = tolower(c) - 'a';
+
+        if (col < 0 || col > position::max_col_index || pieces_per_column[col] > position::max_row_index)
         {
-            return false;
+            throw runtime_error("Invalid column in the moves sent to get_moves_from_columns()\n");
         }
 
-        for (const coordinate& current_move: current_set)
+        set_of_moves.push_back({position::max_row_index - pieces_per_column[col], col});
+
+        pieces_per_column[col] ++;
+    }
+}
+
+void print_multi_pv(int argc, char* argv[])
+{
+    // Usage: multi_pv <number of lines> <depth> <columns of the moves reaching the position, e.g. ddce>
+    // Prints the best moves in the position (for the player to move) with their evaluations and lines, in one search.
+
+    engine multi_pv_engine;
+
+    multi_pv_engine.set_multi_pv_count(atoi(argv[2]));
+
+    multi_pv_engine.set_max_depth_limit(atoi(argv[3]));
+
+    vector<coordinate> set_of_moves;
+
+    get_moves_from_columns(argv[4], set_of_moves);
+
+    multi_pv_engine.set_thinking_time(1000000); // get_to_chosen_starting_position() only uses this on the last move.
+
+    unique_ptr<position> pt = get_to_chosen_starting_position(multi_pv_engine, true, set_of_moves);
+
+    multi_pv_result result = pt->find_multi_pv();
+
+    cout << "Depth " << result.depth << ":\n";
+
+    for (const principal_variation& line: result.lines)
+    {
+        cout << line.evaluation << ":";
+
+        for (const coordinate& current: line.moves)
         {
-            if (current_move.row < 0 || current_move.row > 5 || current_move.col < 0 || current_move.col > 6)
-            {
-                return false;
-            }
+            cout << " " << char('a' + current.col);
         }
+
+        cout << "\n";
+    }
+}
+
+void trace_search(int argc, char* argv[])
+{
+    // Usage: trace <depth> <columns of the moves reaching the position, e.g. ddce> <trace file> [sample rate] [sample ply]
+    // Thinks on the position (for the comp) until depth_limit reaches depth, recording the nodes of the search in the trace file
+    // (see search_tracer.h). Only 1 in every sample rate subtrees at sample ply is recorded (by default, everything is).
+
+    int depth = atoi(argv[2]);
+
+    int sample_rate = (argc > 5) ? atoi(argv[5]) : 1;
+
+    int sample_ply = (argc > 6) ? atoi(argv[6]) : 1;
+
+    vector<coordinate> set_of_moves;
+
+    get_moves_from_columns(argv[3], set_of_moves);
+
+    engine traced_engine;
+
+    traced_engine.set_thinking_time(0); // get_to_chosen_starting_position() only plays out the moves, so the traced search is the only one.
+
+    unique_ptr<position> start = get_to_chosen_starting_position(traced_engine, true, set_of_moves);
+
+    traced_engine.set_max_depth_limit(depth);
+
+    traced_engine.set_thinking_time(1000000); // so only max_depth_limit (or a proven result) stops the iterative deepening.
+
+    long long number_of_records;
+
+    {
+        search_tracer tracer(argv[4], sample_rate, sample_ply);
+
+        traced_engine.set_tracer(&tracer);
+
+        traced_engine.think_on_game_position(start->get_board(), start->get_is_comp_turn(), start->get_last_move(),
+                                             start->get_squares_amplifying_comp_2(), start->get_squares_amplifying_comp_3(),
+                                             start->get_squares_amplifying_user_2(), start->get_squares_amplifying_user_3(), true);
+
+        traced_engine.set_tracer(nullptr);
+
+        number_of_records = tracer.get_number_of_records();
+    } // the tracer finishes writing the file here.
+
+    cout << "Recorded " << number_of_records << " of the search's " << traced_engine.get_search_statistics().nodes << " nodes in " << argv[4] << ".\n";
+}
+
+void convert_trace(int argc, char* argv[])
+{
+    // Usage: convert_trace <trace file> <chrome or tree>
+    // Prints the trace written by "trace" in Chrome's trace format (JSON, for chrome://tracing or Perfetto), or as an indented tree.
+
+    vector<trace_record> records;
+
+    search_tracer::read_records(argv[2], records);
+
+    const string format = argv[3];
+
+    if (format == "chrome")
+    {
+        search_tracer::write_chrome_trace(records, cout);
+    }
+
+    else if (format == "tree")
+    {
+        search_tracer::write_tree(records, cout);
+    }
+
+    else
+    {
+        throw runtime_error("Unknown format sent to convert_trace(): " + format + "\n");
     }
+}
+
+void run_engine_protocol()
+{
+    // Usage: protocol
+    // Reads commands from standard input and answers on standard output (see engine_protocol.h), until "quit".
+
+    position::precomputed_endgame_database.load("EndgameDatabase.bin");
+
+    engine_settings search_settings;
+
+    evaluation_parameters::load("EvaluationParameters.txt", search_settings.parameters);
+
+    engine_protocol protocol(search_settings);
+
+    protocol.run(cin, cout);
+}
+
+void serve_sessions(int argc, char* argv[])
+{
+    // Usage: serve <socket path, or tcp:<port>> [workers] [time budget per game in seconds]
+    // Plays games against clients until one sends "shutdown" (see session_server.h). With no time budget (or 0), the comp thinks
+    // for thinking_time on every move.
+
+    int number_of_workers = (argc > 3) ? atoi(argv[3]) : max(1, static_cast<int>(thread::hardware_concurrency()));
+
+    double time_budget = (argc > 4) ? atof(argv[4]) : 0;
+
+    position::precomputed_endgame_database.load("EndgameDatabase.bin");
+
+    engine_settings search_settings;
+
+    evaluation_parameters::load("EvaluationParameters.txt", search_settings.parameters);
+
+    session_server server(argv[2], number_of_workers, time_budget, search_settings);
+
+    cerr << "Serving on " << argv[2] << " with " << number_of_workers << " workers.\n";
+
+    server.run();
+}
+
+void run_load_test(int argc, char* argv[])
+{
+    // Usage: load_test <socket path, or tcp:<port>> [clients] [games per client] [time budget per game in seconds]
+    // Plays random games against a server started with "serve", and prints the comp's moves per second and the latencies.
+
+    int number_of_clients = (argc > 3) ? atoi(argv[3]) : 8;
+
+    int games_per_client = (argc > 4) ? atoi(argv[4]) : 10;
 
-    return true;
+    double time_budget = (argc > 5) ? atof(argv[5]) : 0;
+
+    load_generator generator(argv[2], number_of_clients, games_per_client, time_budget);
+
+    load_test_result result = generator.run();
+
+    cout << result.games << " games, " << result.comp_moves << " comp moves in " << result.seconds << " seconds ("
+         << result.comp_moves_per_second << " moves per second).\n";
+
+    cout << "Latency: median " << result.median_latency * 1000 << " ms, p99 " << result.p99_latency * 1000 << " ms, max "
+         << result.max_latency * 1000 << " ms.\n";
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (argc > 2 && string(argv[1]) == "generate_endgame_database")
+    {
+        generate_endgame_database(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "benchmark_search_drivers")
+    {
+        benchmark_search_drivers(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "search_statistics")
+    {
+        print_search_statistics(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 4 && string(argv[1]) == "multi_pv")
+    {
+        print_multi_pv(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 4 && string(argv[1]) == "trace")
+    {
+        trace_search(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 3 && string(argv[1]) == "convert_trace")
+    {
+        convert_trace(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "benchmark_pruning")
+    {
+        benchmark_pruning(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "analyze")
+    {
+        analyze_positions(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "protocol")
+    {
+        run_engine_protocol();
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "serve")
+    {
+        serve_sessions(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "load_test")
+    {
+        run_load_test(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "tune")
+    {
+        tune_evaluation_parameters(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "benchmark_evaluation_cache")
+    {
+        benchmark_evaluation_cache(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "benchmark_evaluators")
+    {
+        benchmark_evaluators(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "check_move_ordering_kernels")
+    {
+        check_move_ordering_kernels(argc, argv);
+
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "check_smart_evaluation")
+    {
+        check_smart_evaluation(argc, argv);
+
+        return 0;
+    }
+
+    engine_settings search_settings;
+
+    if (argc > 1 && string(argv[1]) == "mtdf")
+    {
+        search_settings.search_driver = MTD_F;
+    }
+
+    else if (argc > 1 && string(argv[1]) == "pvs")
+    {
+        search_settings.search_driver = PVS;
+    }
+
     srand(time(NULL));
 
+    position::precomputed_endgame_database.load("EndgameDatabase.bin"); // It's fine if there is no database file (load() returns false).
+
+    evaluation_parameters::load("EvaluationParameters.txt", search_settings.parameters); // Also fine if there's no file (the
+                                                                                         // weights keep their defaults).
+
     cout << "Enter approximately how long you want the Engine to think on each move: ";
 
-    cin >> position::thinking_time;
+    double thinking_time = engine_state::default_thinking_time;
+
+    cin >> thinking_time;
 
     vector<vector<coordinate>> moves_reaching_starting_positions; // Will store all the sets of moves reaching starting positions (all fair!).
 
@@ -492,6 +1291,12 @@ int main()
         throw runtime_error("Found invalid move(s) in the moves_reaching_starting_positions vector in main()\n");
     }
 
+    engine game_engine;
+
+    game_engine.set_settings(search_settings);
+
+    game_engine.set_thinking_time(thinking_time);
+
     char user_input = ' ';
 
     cout << "To play, press 1 and enter: ";
@@ -505,7 +1310,7 @@ int main()
             read_file_into_vector(moves_reaching_starting_positions);
         }
 
-        play_game(moves_reaching_starting_positions);
+        play_game(moves_reaching_starting_positions, game_engine);
 
         cout << "To play again, press 1 and enter: ";
 
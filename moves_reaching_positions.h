@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include "position.h"
+
+using namespace std;
+
+// Reading the sets of moves in MovesReachingPositions.txt (one set per line, each move as "(row,col)"), which reach the
+// starting positions games are played from. Shared by main.cpp and versus_sim.cpp.
+
+void read_file_into_vector(vector<vector<coordinate>>& vec, const string& file_name = "MovesReachingPositions.txt")
+{
+    ifstream fin(file_name);
+
+    if (fin.fail())
+    {
+        throw runtime_error("fin failed to read file in read_file_into_vector() function.\n");
+    }
+
+    coordinate current_move_found;
+    current_move_found.row = position::UNDEFINED;
+    current_move_found.col = position::UNDEFINED;
+
+    vector<coordinate> empty_vec;
+
+    vec.push_back(empty_vec);
+
+    char c = fin.get();
+
+    while (!fin.eof())
+    {
+        if (c - '0' >= 0 && c - '0' <= 9) // is a digit, so work with it...
+        {
+            if (current_move_found.row == position::UNDEFINED)
+            {
+                current_move_found.row = c - '0';
+            }
+
+            else
+            {
+                current_move_found.col = c - '0';
+
+                vec[vec.size()-1].push_back(current_move_found);
+
+                // Now reset current_move_found:
+
+                current_move_found.row = position::UNDEFINED;
+                current_move_found.col = position::UNDEFINED;
+            }
+        }
+
+        else if (c == '\n')
+        {
+            // About to be a new line in the file (representing a set of moves), so create a new spot in the param vector:
+
+            vec.push_back(empty_vec);
+
+            // Note that if that '\n' was the last newline character in the file, then vec's last element will be an empty vector.
+
+            // So, I take care of this near the end of the function.
+        }
+
+        else if (c != '(' && c != ')' && c != ',' && c != ' ')
+        {
+            // c doesn't equal any of the other allowable characters in the file. Something's wrong:
+
+            throw runtime_error("Found an unexpected character in the file in read_file_into_vector()\n");
+        }
+
+        c = fin.get();
+    }
+
+    if (vec[vec.size()-1].size() == 0)
+    {
+        // The last set of moves in vec is empty, which makes sense.
+
+        vec.pop_back();
+    }
+}
+
+bool are_all_moves_valid(const vector<vector<coordinate>>& vec)
+{
+    for (const vector<coordinate>& current_set: vec)
+    {
+        if (current_set.empty() || current_set.size() < 4 || current_set.size() > 9)
+        {
+            return false;
+        }
+
+        for (const coordinate& current_move: current_set)
+        {
+            if (current_move.row < 0 || current_move.row > 5 || current_move.col < 0 || current_move.col > 6)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
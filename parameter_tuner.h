@@ -0,0 +1,224 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "position.h"
+#include "engine.h"
+#include "self_play.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Tunes the weights in evaluation_parameters with SPSA (simultaneous perturbation stochastic approximation), using self-play.
+
+// Each iteration picks a random direction delta (every parameter moved up or down by its perturbation), and plays a pair of
+// games from one of the starting positions (once with each colour) between the weights + delta and the weights - delta.
+// The weights then move towards whichever side scored better, by learning_rate * the score difference (-2 to 2) * delta.
+// All the weights are tuned at once from the same 2 games, however many there are.
+
+// The game pairs are shared among number_of_threads threads. Each thread plays its games with its own engine (so its own TT,
+// solvers, etc., up to about 76 MB per thread; see engine.h), and they all update the same weights (under a mutex) as soon as their
+// pair is done.
+// Games stop iterative deepening after nodes_per_move positions, so a game plays the same whatever else the machine is doing.
+
+class parameter_tuner
+{
+public:
+    // Constructors:
+
+    parameter_tuner(const vector<unique_ptr<position>>& startsP, const engine_settings& search_settingsP,
+                    int number_of_threadsP, int nodes_per_moveP);
+    // Every position in startsP must have 'C' to move. search_settingsP is what both sides of each game search with (apart from
+    // the weights). startsP must stay alive while tune() runs.
+
+    // Helpers:
+    evaluation_parameters tune(const evaluation_parameters& start_parameters, int number_of_game_pairs);
+    // Returns the tuned weights, starting from start_parameters.
+
+    double get_games_per_second_per_thread() const; // throughput of the last call to tune().
+
+    // Public static variables:
+    static const int number_of_parameters = 5;
+    static const double perturbations[number_of_parameters]; // how far each parameter is moved either way in an iteration.
+    static const double min_values[number_of_parameters];
+    static const double max_values[number_of_parameters];
+    static const double learning_rate;
+
+    // Public static methods:
+    static vector<double> to_vector(const evaluation_parameters& parameters);
+    static evaluation_parameters from_vector(const vector<double>& values); // rounds the integer weights.
+
+private:
+    // Private variables:
+    const vector<unique_ptr<position>>& starts;
+    engine_settings search_settings;
+    int number_of_threads;
+    int nodes_per_move;
+    double games_per_second_per_thread;
+
+    // Private methods:
+    void run_worker(vector<double>& values, mutex& values_mutex, atomic<int>& next_game_pair, int number_of_game_pairs);
+};
+
+// Initializing the static variables:
+
+// In the order of evaluation_parameters: big_amount, small_amount, stacked_threat_coefficient,
+// threat_below_opponent_threat_coefficient, threat_above_own_threat_coefficient.
+
+const double parameter_tuner::perturbations[parameter_tuner::number_of_parameters] = {2.0, 1.0, 1.0, 0.1, 0.1};
+const double parameter_tuner::min_values[parameter_tuner::number_of_parameters] = {1.0, 0.0, 1.0, 0.0, 0.0};
+const double parameter_tuner::max_values[parameter_tuner::number_of_parameters] = {100.0, 50.0, 20.0, 1.0, 1.0};
+const double parameter_tuner::learning_rate = 0.1;
+
+// CONSTRUCTORS:
+
+parameter_tuner::parameter_tuner(const vector<unique_ptr<position>>& startsP, const engine_settings& search_settingsP,
+                                 int number_of_threadsP, int nodes_per_moveP) : starts(startsP)
+{
+    if (starts.empty())
+    {
+        throw runtime_error("No starting positions were sent to the parameter_tuner constructor\n");
+    }
+
+    search_settings = search_settingsP;
+
+    number_of_threads = max(1, number_of_threadsP);
+
+    nodes_per_move = nodes_per_moveP;
+
+    games_per_second_per_thread = 0.0;
+}
+
+// HELPERS:
+
+evaluation_parameters parameter_tuner::tune(const evaluation_parameters& start_parameters, int number_of_game_pairs)
+{
+    vector<double> values = to_vector(start_parameters);
+
+    mutex values_mutex;
+
+    atomic<int> next_game_pair(0);
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    vector<thread> workers;
+
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        workers.push_back(thread(&parameter_tuner::run_worker, this, ref(values), ref(values_mutex), ref(next_game_pair), number_of_game_pairs));
+    }
+
+    for (thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+    games_per_second_per_thread = 2.0 * number_of_game_pairs / max(time_span.count(), 1e-9) / number_of_threads;
+
+    return from_vector(values);
+}
+
+double parameter_tuner::get_games_per_second_per_thread() const
+{
+    return games_per_second_per_thread;
+}
+
+// PUBLIC STATIC METHODS:
+
+vector<double> parameter_tuner::to_vector(const evaluation_parameters& parameters)
+{
+    return {static_cast<double>(parameters.big_amount), static_cast<double>(parameters.small_amount),
+            static_cast<double>(parameters.stacked_threat_coefficient),
+            parameters.threat_below_opponent_threat_coefficient, parameters.threat_above_own_threat_coefficient};
+}
+
+evaluation_parameters parameter_tuner::from_vector(const vector<double>& values)
+{
+    evaluation_parameters parameters;
+
+    parameters.big_amount = static_cast<int>(round(values[0]));
+    parameters.small_amount = static_cast<int>(round(values[1]));
+    parameters.stacked_threat_coefficient = static_cast<int>(round(values[2]));
+    parameters.threat_below_opponent_threat_coefficient = values[3];
+    parameters.threat_above_own_threat_coefficient = values[4];
+
+    return parameters;
+}
+
+// PRIVATE METHODS:
+
+void parameter_tuner::run_worker(vector<double>& values, mutex& values_mutex, atomic<int>& next_game_pair, int number_of_game_pairs)
+{
+    engine worker_engine;
+
+    worker_engine.set_settings(search_settings);
+
+    worker_engine.set_thinking_time(1000000); // only max_nodes_per_move (or a proven result) stops the iterative deepening.
+    worker_engine.set_max_nodes_per_move(nodes_per_move);
+    worker_engine.set_number_of_defence_threads(1); // the other cores are busy with their own games.
+
+    while (true)
+    {
+        int game_pair = next_game_pair++;
+
+        if (game_pair >= number_of_game_pairs)
+        {
+            return;
+        }
+
+        mt19937 generator(game_pair); // so the directions tried don't depend on how the threads happen to be scheduled.
+
+        vector<double> deltas(number_of_parameters);
+
+        for (double& delta: deltas)
+        {
+            delta = (generator() % 2 == 0) ? 1.0 : -1.0;
+        }
+
+        vector<double> current_values;
+
+        {
+            lock_guard<mutex> lock(values_mutex);
+
+            current_values = values;
+        }
+
+        vector<double> plus_values = current_values;
+        vector<double> minus_values = current_values;
+
+        for (int i = 0; i < number_of_parameters; i++)
+        {
+            plus_values[i] = min(max_values[i], current_values[i] + perturbations[i] * deltas[i]);
+            minus_values[i] = max(min_values[i], current_values[i] - perturbations[i] * deltas[i]);
+        }
+
+        engine_settings plus_engine = search_settings;
+        engine_settings minus_engine = search_settings;
+
+        plus_engine.parameters = from_vector(plus_values);
+        minus_engine.parameters = from_vector(minus_values);
+
+        const unique_ptr<position>& start = starts[game_pair % starts.size()];
+
+        int score = self_play::play_game(worker_engine, start, plus_engine, minus_engine) -
+                    self_play::play_game(worker_engine, start, minus_engine, plus_engine);
+
+        lock_guard<mutex> lock(values_mutex);
+
+        for (int i = 0; i < number_of_parameters; i++)
+        {
+            values[i] += learning_rate * score * perturbations[i] * deltas[i];
+
+            values[i] = min(max_values[i], max(min_values[i], values[i]));
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+// Static evaluation that is just lookups in a precomputed table, instead of smart_evaluation()'s treasure_spot heuristics.
+
+// Each of the 69 windows (groups of 4 squares in a line) is encoded as a base-3 index: every square is a digit, 0 for empty,
+// 1 for 'C' and 2 for 'U', with the window's first square as the lowest digit. So there are 81 possible windows, and
+// window_values holds what each is worth to the comp (negative if it's worth something to the user). A window is worth
+// something only if it has pieces of just one player: big_amount if it has 3 of them, small_amount if it has 2 (the same
+// amounts smart_evaluation() uses).
+// Like in smart_evaluation(), a window's value is given to each of its empty squares, weighted by the square's height
+// (row + 1 + the number of pieces in its column). The weights of filled squares are 0, so a window's value is simply
+// multiplied by the sum of its 4 weights, with no branching on what's in the window.
+
+class pattern_table_evaluator
+{
+public:
+    // Public static methods:
+
+    static int evaluate(const vector<vector<char>>& board, const vector<int>& num_pieces_per_column);
+    // Returns the evaluation of board from the comp's perspective. Nobody may have won in board.
+
+    static vector<int> find_window_values(); // works out window_values.
+    static vector<vector<int>> find_window_squares(); // works out window_squares.
+
+    // Public static variables:
+    static const int number_of_squares = 42;
+    static const vector<vector<int>> window_squares; // the 4 squares (row * 7 + col) of each of the 69 windows.
+    static const int big_amount;
+    static const int small_amount;
+    static const vector<int> window_values; // indexed by a window's base-3 index (see above).
+};
+
+// Initializing the static variables:
+
+const int pattern_table_evaluator::big_amount = 10;
+const int pattern_table_evaluator::small_amount = 3;
+const vector<int> pattern_table_evaluator::window_values = pattern_table_evaluator::find_window_values();
+const vector<vector<int>> pattern_table_evaluator::window_squares = pattern_table_evaluator::find_window_squares();
+
+// PUBLIC STATIC METHODS:
+
+int pattern_table_evaluator::evaluate(const vector<vector<char>>& board, const vector<int>& num_pieces_per_column)
+{
+    int digits[number_of_squares]; // the base-3 digit of each square (row * 7 + col).
+    int weights[number_of_squares]; // the height weight of each square (0 if it's filled).
+
+    for (int row = 0; row < 6; row++)
+    {
+        for (int col = 0; col < 7; col++)
+        {
+            char square = board[row][col];
+
+            digits[row * 7 + col] = (square == 'C') ? 1 : ((square == 'U') ? 2 : 0);
+
+            weights[row * 7 + col] = (square == ' ') ? row + 1 + num_pieces_per_column[col] : 0;
+        }
+    }
+
+    int evaluation = 0;
+
+    for (const vector<int>& window: window_squares)
+    {
+        int index = digits[window[0]] + 3 * digits[window[1]] + 9 * digits[window[2]] + 27 * digits[window[3]];
+
+        evaluation += window_values[index] * (weights[window[0]] + weights[window[1]] + weights[window[2]] + weights[window[3]]);
+    }
+
+    return evaluation;
+}
+
+vector<int> pattern_table_evaluator::find_window_values()
+{
+    vector<int> values(81, 0);
+
+    for (int index = 0; index < 81; index++)
+    {
+        int comp_pieces = 0;
+        int user_pieces = 0;
+
+        for (int i = 0, remaining = index; i < 4; i++, remaining /= 3)
+        {
+            if (remaining % 3 == 1)
+            {
+                comp_pieces ++;
+            }
+
+            else if (remaining % 3 == 2)
+            {
+                user_pieces ++;
+            }
+        }
+
+        if (comp_pieces > 0 && user_pieces > 0) // blocked, so it's worth nothing to either player.
+        {
+            continue;
+        }
+
+        int pieces = comp_pieces + user_pieces;
+
+        int value = (pieces == 3) ? big_amount : ((pieces == 2) ? small_amount : 0); // 4 pieces can't happen (nobody has won).
+
+        values[index] = (comp_pieces > 0) ? value : -value;
+    }
+
+    return values;
+}
+
+vector<vector<int>> pattern_table_evaluator::find_window_squares()
+{
+    vector<vector<int>> all_windows;
+
+    const int directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {-1, 1}}; // (row step, col step).
+
+    for (const auto& direction: directions)
+    {
+        for (int row = 0; row < 6; row++)
+        {
+            for (int col = 0; col < 7; col++)
+            {
+                int end_row = row + 3 * direction[0];
+                int end_col = col + 3 * direction[1];
+
+                if (end_row < 0 || end_row >= 6 || end_col >= 7)
+                {
+                    continue;
+                }
+
+                vector<int> window;
+
+                for (int i = 0; i < 4; i++)
+                {
+                    window.push_back((row + i * direction[0]) * 7 + col + i * direction[1]);
+                }
+
+                all_windows.push_back(window);
+            }
+        }
+    }
+
+    return all_windows;
+}
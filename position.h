@@ -11,7 +11,21 @@
 #include <random>
 #include <climits>
 #include <cmath>
+#include <functional>
+#include <thread>
+#include <atomic>
 #include "tool.h"
+#include "endgame_solver.h"
+#include "endgame_database.h"
+#include "threat_parity_analyzer.h"
+#include "proof_number_solver.h"
+#include "defence_thread_pool.h"
+#include "pattern_table_evaluator.h"
+#include "batch_evaluator.h"
+#include "evaluation_cache.h"
+#include "evaluation_parameters.h"
+#include "search_profiler.h"
+#include "search_tracer.h"
 
 using namespace std;
 
@@ -38,6 +52,8 @@ struct position_info_for_TT // The key info of a position that will be stored in
 {
     vector<vector<char>> board; // The position's 2-D vector of char board. Acts as the KEY!
     int evaluation;
+    int lower_bound; // the position's true evaluation (at calculation_depth_from_this_position) is >= lower_bound...
+    int upper_bound; // ...and <= upper_bound. Both equal evaluation if the evaluation is exact (i.e., not affected by alpha-beta pruning).
     int calculation_depth_from_this_position; // stores how far ahead the computer calculated for getting the position's evaluation.
     vector<coordinate> possible_moves_sorted; // stores the position's possible moves, sorted from probable best to probable worst.
     bool is_evaluation_indisputable; // stores true if there this position's evaluation will not change by calculating deeper...
@@ -51,6 +67,147 @@ struct coordinate_and_value // Object for storing amplifying squares along with
     int value; // stores the value of the amplifying square, determined by the heuristics in smart_evaluation() and the function it calls.
 };
 
+struct principal_variation // One line of multi-PV analysis (see position::find_multi_pv()).
+{
+    int evaluation; // of the line's first move, from the comp's perspective (same scale as position's evaluation).
+    vector<coordinate> moves; // the line, starting with the root move. It ends where the search stopped keeping future positions.
+};
+
+struct multi_pv_result // What position::find_multi_pv() returns.
+{
+    int depth; // the depth_limit the root was searched to.
+    vector<principal_variation> lines; // best line first.
+};
+
+struct search_statistics // What the last call of think_on_game_position() did, up to the end of its last iteration so far.
+{
+    int depth_limit; // of the last iteration finished (0 if none has finished yet).
+    long long nodes; // positions created (the counter variable's increase).
+    long long leaf_nodes; // calls of evaluate_at_depth_limit() (i.e., smart_evaluation() or whichever evaluator is used).
+    long long quiescence_nodes; // positions quiescence_search() handled (past depth_limit, with a critical move left).
+    long long TT_cutoffs; // positions analyze_last_move() settled with the TT (an exact evaluation, or bounds that prune).
+    long long beta_cutoffs; // positions minimax() pruned (in a MAX node with beta, or a MIN node with alpha).
+    long long beta_cutoffs_by_move_index[7]; // how many of those were caused by the move at each index of possible_moves.
+    int max_depth; // the deepest position looked at (past depth_limit if quiescence_search() followed forced moves).
+    double seconds; // since the search started.
+};
+
+struct search_stopped // Thrown by minimax() once *engine_state::stop_flag is set, and caught by think_on_game_position().
+{
+};
+
+enum search_driver_type // How think_on_game_position() searches the root in each iteration of iterative deepening.
+{
+    ALPHA_BETA, // one search with no window (alpha and beta start off UNDEFINED).
+    MTD_F, // a series of null window searches that close in on the evaluation, using the bounds kept in the TT.
+    PVS // principal variation search: like ALPHA_BETA, but minimax() only gives the first move of a position the full window. The others
+        // get a null window, which just shows they're no better, and are searched again with the full window if one turns out better.
+};
+
+enum evaluator_type // How a position with no forced moves left is evaluated at depth_limit.
+{
+    SMART_EVALUATION, // smart_evaluation(), which works everything out from the board and the amplifying vectors.
+    PATTERN_TABLE_EVALUATION // a table lookup for each of the 69 windows of 4 squares (see pattern_table_evaluator.h).
+};
+
+class position;
+
+struct engine_settings // The search settings that can differ between engines (e.g., the two engines in a self-play game).
+{
+    search_driver_type search_driver = ALPHA_BETA; // which search think_on_game_position() runs at each depth_limit.
+    bool use_late_move_reductions = false; // if true, minimax() searches late, quiet moves less deeply (see minimax()).
+    bool use_futility_pruning = false; // if true, minimax() skips quiet moves one ply before depth_limit that can't catch up.
+    evaluator_type evaluator = SMART_EVALUATION; // which static evaluation is used at depth_limit.
+    bool order_frontier_moves = true; // if true, minimax() sorts the moves one ply before depth_limit with batch_evaluator
+                                      // (SIMD move ordering only; the leaves are still evaluated one at a time).
+    bool use_evaluation_cache = false; // if true, evaluate_at_depth_limit() looks in smart_evaluation_cache before calling smart_evaluation().
+    evaluation_parameters parameters; // the weights smart_evaluation() uses. Left out of an initializer list, it gets the default weights.
+    // NOTE: smart_evaluation_cache must be reset whenever the weights change.
+};
+
+struct engine_state // Everything a search keeps between moves or is configured by. Each engine owns one (see engine.h), and every
+                    // position points to the one of the engine that created it, so several engines can search at once.
+{
+    // MEMORY: about 24 MB before a single position is stored: transposition_table's 1,000,005 empty buckets (plus 72 bytes per stored
+    // position). Everything else only takes memory once it's used: quick_win_solver's table (32 MB) once find_best_move_for_comp()
+    // first needs the length of a forced win, exact_endgame_solver's (16 MB) once it first solves an endgame (never with no
+    // thinking time), smart_evaluation_cache (4 MB) once use_evaluation_cache is first on, and defence_pool 8 MB per defence thread.
+    // The tables that are only read (the hash values, the endgame database, the evaluators' windows) are static, so all the
+    // engines share them.
+
+    static constexpr double default_thinking_time = 0.30;
+
+    engine_settings settings;
+
+    int depth_limit = 1; // the depth of the computer's calculation abilities. Starts off at 1 every time the Engine thinks (iterative deepening).
+    int max_depth_limit = 42; // iterative deepening stops once depth_limit reaches this (even if there's thinking time left).
+
+    vector<vector<position_info_for_TT>> transposition_table = vector<vector<position_info_for_TT>>(1000005);
+    // A position's key & evaluation get stored here, at the appropriate index (i.e., it's hash value). The inner vector is to deal with
+    // possible collisions. Multiple positions can be stored at the same index in the outer vector via the inner vector.
+
+    vector<int> indices_of_elements_in_TT; // Stores the indices of which inner vectors in the TT actually store data.
+
+    long long counter = 0; // counts how many times the position class is instantiated. PURELY FOR TESTING!
+    int counter_of_TT_usefulness = 0; // counts how many times the TT is actually useful. PURELY FOR TESTING!
+    int quiescence_counter = 0; // counts how many positions quiescence_search() handles. PURELY FOR TESTING!
+    int quiescence_ply_limit_counter = 0; // counts how many times quiescence_search() stops at quiescence_ply_limit. PURELY FOR TESTING!
+    search_statistics statistics = {}; // reset by think_on_game_position(), and updated after every iteration.
+
+    int quiescence_ply_limit = 12; // how many plies past depth_limit quiescence_search() follows a chain of forced blocks
+                                   // before it settles for the static evaluation.
+
+    int multi_pv_count = 1; // how many root moves get an exact evaluation. With 1 (the default), only the best move does.
+
+    int late_move_index = 3; // moves at this index of possible_moves (or later) can be reduced.
+    int late_move_reduction = 1; // how many plies shallower a reduced move is searched.
+    int late_move_research_counter = 0; // counts how many reduced moves had to be searched again. PURELY FOR TESTING!
+
+    int null_window_research_counter = 0; // counts how many moves the PVS driver had to search again with the full window. PURELY FOR TESTING!
+
+    int futility_margin = 80; // the most a quiet move is assumed to change the static evaluation by.
+    int futility_pruning_counter = 0; // counts how many moves futility pruning skipped. PURELY FOR TESTING!
+
+    bool check_smart_evaluation = false; // if true, smart_evaluation() also works out every evaluation with smart_evaluation_with_board_copies(),
+                                         // and throws a runtime_error if they differ. PURELY FOR TESTING!
+    long long smart_evaluation_check_counter = 0; // counts how many evaluations that check compared. PURELY FOR TESTING!
+
+    int max_nodes_per_move = 0; // if not 0, iterative deepening doesn't start another iteration once this many
+                                // positions have been created (so it doesn't depend on the speed of the machine).
+
+    double thinking_time = default_thinking_time; // Comp spends this long thinking, plus the time it spends on the last iteration of the
+                                                  // iterative deepening while loop.
+
+    function<bool(const position&)> iteration_callback; // if set, think_on_game_position() calls it with the root after every iteration.
+                                                         // Returning false stops the iterative deepening (see engine_protocol.h).
+                                                         // An iteration itself is never cut short.
+
+    const atomic<bool>* stop_flag = nullptr; // if not nullptr, think_on_game_position() abandons the iteration it's on as soon
+                                             // as *stop_flag is true, and returns the root from the last one it finished.
+
+    int endgame_solver_threshold = 16; // Once the comp is to move with FEWER than this many empty squares left,
+                                       // think_on_game_position() hands the position to the exact endgame solver instead of searching.
+
+    endgame_solver exact_endgame_solver; // Has its own TT, which is kept between moves (solved positions stay solved).
+
+    evaluation_cache smart_evaluation_cache; // smart_evaluation() of boards seen before. Kept between moves, like quick_win_solver.
+
+    proof_number_solver quick_win_solver; // Used by find_quick_winning_move() and find_best_move_for_comp(). Its table is
+                                          // kept between calls, since the proofs in it stay valid.
+
+    int threat_analysis_min_pieces = 16; // analyze_last_move() only runs the odd/even threat analysis once there are at least
+                                         // this many pieces on the board (it hardly ever proves anything earlier in the game).
+
+    search_tracer* tracer = nullptr; // if not nullptr, analyze_last_move() records the nodes it visits in it (see search_tracer.h).
+                                     // The caller owns it.
+
+    int number_of_defence_threads = max(1, min(7, static_cast<int>(thread::hardware_concurrency())));
+    // how many threads find_best_move_for_comp() uses to look for the most stubborn defense.
+
+    unique_ptr<defence_thread_pool> defence_pool; // those threads (and their solvers), created the first time they're
+                                                  // needed and kept between calls like quick_win_solver.
+};
+
 bool operator==(const coordinate& first, const coordinate& second) // function tests for equality between two coordiate objects
 {
     return (first.row == second.row && first.col == second.col);
@@ -61,22 +218,28 @@ class position : public tool
 public:
     // Constructors:
 
+    // Every constructor takes the state of the engine the position belongs to, which must outlive the position.
+
     // PROGRAMMER CALLS TO START THE GAME.
-    position(bool is_comp_turnP);
+    position(engine_state& stateP, bool is_comp_turnP, int alphaP = UNDEFINED, int betaP = UNDEFINED);
 
     // PROGRAMMER CALLS WHEN COMP/USER MAKES A MOVE IN GAME.
-    position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+    position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
              const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
-             const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P);
+             const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
+             int alphaP = UNDEFINED, int betaP = UNDEFINED);
+    // alphaP and betaP give the root a search window (MTD(f) searches the root with a null window). Otherwise there's none.
 
     // COMPUTER CALLS RECURSIVELY IN ITS MINIMAX CALCULATIONS.
-    position(const vector <vector<char>>& boardP, bool is_comp_turnP,
-             int depthP, int number_of_piecesP, coordinate last_moveP,
+    position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP,
+             int depthP, int calculation_depth_from_this_positionP, int number_of_piecesP, coordinate last_moveP,
              const vector<coordinate>& possible_movesP, int possible_moves_index,
              int alphaP, int betaP,
              const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
              const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
              double pre_hash_value_of_positionP, const vector<int>& num_pieces_per_columnP);
+    // depthP is the position's real ply. calculation_depth_from_this_positionP is usually 1 less than the parent's, but late move
+    // reductions make it smaller (so a reduced subtree reaches its horizon early, while its plies are still counted right).
     // No param for evaluation is sent to constructor, as this is figured out by the computer via minimax.
     // No param for future_positions is sent to constructor, as this is figured out by the computer via minimax.
 
@@ -92,6 +255,9 @@ public:
     coordinate get_last_move() const;
     coordinate find_best_move_for_comp(); // finds the best move to play in this current position, for the comp, and returns.
                                           // This function finds the move the comp should play against user in the game.
+    multi_pv_result find_multi_pv() const;
+    // Returns the best multi_pv_count moves found in this (root) position with their evaluations and lines, best first.
+    // If this root was searched with multi_pv_count > 1, all of their evaluations are exact (see minimax()).
     vector<treasure_spot> get_squares_amplifying_comp_2() const; // returns the squares_amplifying_comp_2 vector.
     vector<treasure_spot> get_squares_amplifying_comp_3() const; // returns the squares_amplifying_comp_3 vector.
     vector<treasure_spot> get_squares_amplifying_user_2() const; // returns the squares_amplifying_user_2 vector.
@@ -112,9 +278,11 @@ public:
     void initialize_hash_value_of_position(); // multiplies the pre_hash_value_of_position to >= 1,000,000, rounds to an int, and
                                               // sets hash_value_of_position to the result.
 
+    void find_principal_variation(vector<coordinate>& moves) const; // appends the line the search expects from this position to moves.
+
     void add_position_to_transposition_table(bool is_evaluation_indisputable);
     // Adds this position's board (the key) and evaluation to the appropriate index in
-    // the static transposition table (i.e., the hash_value of the position).
+    // the transposition table in state (i.e., the hash_value of the position).
 
     // Helpers:
     bool did_computer_win() const; // returns true if the computer has won the game with a 4-in-a-row in the current position.
@@ -148,13 +316,9 @@ public:
 
     void remove_duplicates(vector<coordinate>& vec); // Removes duplicate elements from the vector.
 
-    void initialize_row_barriers(); // Initializes row_barriers (private member vector) with 7 elements.
+    void initialize_row_barriers(); // Initializes the 7 elements of row_barriers (private member array).
                                     // 1st element is row index of highest row (visually) allowed in column 0.
 
-    void find_winning_squares(vector<coordinate>& vec, const vector<treasure_spot>& squares_amplifying_3,
-                              const vector<treasure_spot>& squares_amplifying_2, char piece);
-    // Function finds squares making a 4-in-a-row of piece and stores them in vec.
-
     // Functions specifically designed for, and only used in, the Versus Sim:
 
     double get_static_thinking_time() const;
@@ -175,30 +339,26 @@ public:
 
 
     // Public static variables:
+    // What the search changes or is configured by is in the engine_state the position points to (see above). Only constants, and
+    // precomputed_endgame_database (read-only once loaded), are shared by every engine.
     static const int UNDEFINED; // used when evaluation, alpha, or beta is unknown.
+    static const int win_distance_limit; // evaluations within this distance of INT_MAX/INT_MIN are forced wins (see below).
+    static const int unknown_win_distance; // win distance used for a forced win/loss whose length isn't known.
     static const int max_row_index; // the max row index of board (i.e., 5, since there are 6 rows).
     static const int max_col_index; // the max col index of board (i.e., 6, since there are 7 columns).
-    static int depth_limit; // the depth of the computer's calculation abilities.
+    static const int max_MTD_f_passes; // cap on the null window searches per iteration, in case the search is unstable.
     static const double PI; // PI to 11 decimal places.
 
     static const vector<vector<double>> hash_values_of_squares_with_C; // stores the double hash value of each square in the board, if it stores 'C'.
     static const vector<vector<double>> hash_values_of_squares_with_U; // stores the double hash value of each square in the board, if it stores 'U'.
     static const vector<vector<double>> hash_values_of_squares_empty; // stores the double hash value of each square in the board, if it stores ' '.
 
-    static vector<vector<position_info_for_TT>> transposition_table; // A position's key & evaluation get stored here, at the appropriate
-                                                                     // index (i.e., it's hash value). The inner vector is to deal with possible
-                                                                     // collisions. Multiple positions can be stored at the same
-                                                                     // index in the outer vector via the inner vector.
-
-    static vector<int> indices_of_elements_in_TT; // Stores the indices of which inner vectors in the TT actually store data.
-
-    static int counter; // counts how many times the position class is instantiated. PURELY FOR TESTING!
-    static int counter_of_TT_usefulness; // counts how many times the TT is actually useful. PURELY FOR TESTING!
+    static vector<treasure_spot> empty_amplifying_vector;
 
-    static double thinking_time; // Comp spends this long thinking, plus the time it spends on the last iteration of the
-                                 // iterative deepening while loop.
+    static endgame_database precomputed_endgame_database; // Solved positions near the end of the game, loaded from a file (if there is one).
+                                                          // analyze_last_move() looks positions up here before searching them.
 
-    static vector<treasure_spot> empty_amplifying_vector;
+    static const int defence_solver_TT_size_log_2; // the table size of each of engine_state::defence_pool's proof-number solvers.
 
     // Public static methods:
 
@@ -207,7 +367,7 @@ public:
 
     static double cotangent_with_degrees(double angle_in_degrees); // Returns the cotangent of the angle in degrees.
 
-    static void reset_transposition_table(); // Resets the transposition table to only store empty inner vectors.
+    static void reset_transposition_table(engine_state& stateP); // Resets stateP's transposition table to only store empty inner vectors.
                                              // Uses the indices_of_elements_in_TT vector to do this resetting task efficiently.
                                              // Also, this function will make the indices_of_elements_in_TT vector then be empty.
 
@@ -219,17 +379,34 @@ public:
     static position_info_for_TT find_duplicate_in_TT(const unique_ptr<position>& pt);
     // Searches through the TT for a duplicate of pt, and returns it.
 
-    static unique_ptr<position> think_on_game_position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+    static bool is_forced_win_for_comp(int eval); // returns true if eval means the comp has a forced win.
+    static bool is_fastest_win_found(int eval, int depth_limitP);
+    // Returns true if eval is a forced win that takes at most depth_limitP moves. Searching deeper can't find a faster one then.
+    static bool is_forced_win_for_user(int eval); // returns true if eval means the user has a forced win.
+    static int find_win_distance(int eval); // returns n for a forced win evaluation (see the evaluation member).
+
+    static int evaluation_seen_from_parent(int eval);
+    // Converts a child's evaluation into the parent's terms: a forced win is 1 move further away from the parent.
+
+    static int bound_seen_from_child(int bound);
+    // The opposite of evaluation_seen_from_parent(), for passing alpha and beta down to a child. UNDEFINED stays UNDEFINED.
+
+    static unique_ptr<position> think_on_game_position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
                                     const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
                                     const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
                                     bool starting_new_game);
-    // Function thinks and returns a unique_ptr that points to a position object of all its calculations.
-    // THIS FUNCTION SHOULD BE THE ONE CALLED FROM MAIN WHENEVER THE ENGINE NEEDS TO THINK! Or the function below for starting a new game...
+    // Function thinks with stateP (its TT, limits, etc.) and returns a unique_ptr that points to a position object of all its calculations.
+    // Called through engine::think_on_game_position() whenever the Engine needs to think. Or the function below for starting a new game...
+
+    static unique_ptr<position> think_on_game_position(engine_state& stateP, bool is_comp_turnP, bool starting_new_game);
 
-    static unique_ptr<position> think_on_game_position(bool is_comp_turnP, bool starting_new_game);
+    static unique_ptr<position> search_at_depth_limit(const engine_state& stateP, const function<unique_ptr<position>(int, int)>& create_root, int& guess);
+    // Runs one iteration of think_on_game_position() with stateP's search_driver. create_root(alpha, beta) constructs (and so searches)
+    // the root with that window. guess is MTD(f)'s first guess, and gets set to the evaluation found.
 
 private:
     // Private variables:
+    engine_state* state; // the state of the engine this position belongs to (its TT, settings, statistics, etc.).
     vector <vector<char>> board; // stores C's and U's and ' ', representing the computer and user's pieces and empty squares.
     bool is_comp_turn; // stores true if it's the computer's turn, and false if it's the user's turn.
     int depth; // stores how deep this position is in the computer's calculations.
@@ -239,7 +416,14 @@ private:
     vector <coordinate> possible_moves; // stores all the possible moves in this current position. Usually there are 7.
     int alpha; // stores the best alternative found so far FOR THE COMPUTER at this time in the entire search. (i.e., highest val).
     int beta; // stores the best alternative found so far FOR THE USER at this time in the entire search (i.e., lowest val).
-    int evaluation; // stores -1 if the computer is losing, 0 if the game is drawn, and +1 if the computer is winning.
+    int lower_bound; // the true evaluation of the position (searching to depth_limit) is >= lower_bound...
+    int upper_bound; // ...and <= upper_bound. They differ when alpha-beta pruning cut off part of the search below this position.
+                     // Unlike evaluation, these are never nudged by 1 when a branch is pruned.
+    int evaluation; // stores the evaluation of the position, from the computer's perspective (higher is better for the comp).
+                    // A forced win for the comp that takes n more moves (counting both players) is INT_MAX - n, and a forced win
+                    // for the user is INT_MIN + n. So n = 0 means someone just won in this position. A forced win whose length
+                    // isn't known (e.g., from the endgame database) uses n = unknown_win_distance.
+                    // Since n is counted from this position, a parent sees its child's forced win as 1 move longer.
     int future_positions_size; // stores how many positions are in the future_positions vector.
 
     vector <unique_ptr<position>> future_positions; // stores pointers to all future positions one move ahead.
@@ -250,7 +434,7 @@ private:
     vector<treasure_spot> squares_amplifying_user_2; // squares that, if filled, turn the user's 2-in-a-row into a 3-in-a-row.
     vector<treasure_spot> squares_amplifying_user_3; // squares that, if filled, turn the user's 3-in-a-row into a 4-in-a-row.
 
-    vector<int> row_barriers; // stores the highest (visually) rows allowed for play in each column of the board,
+    int row_barriers[7]; // stores the highest (visually) rows allowed for play in each column of the board,
                               // due to a square allowing both comp AND user to win (this is "finished column" algorithm).
                               // row_barriers[0] stores highest row (visually) allowed for play in column 0.
                               // row_barriers[6] stores highest row (visually) allowed for play in column 6.
@@ -274,6 +458,31 @@ private:
 
     int calculation_depth_from_this_position; // stores how many moves ahead the comp will calculate from this current position.
 
+    coordinate endgame_solver_move; // stores the move proven best by the exact endgame solver, if it was used on this position
+                                    // (only the root position of think_on_game_position() can have one). Else {UNDEFINED, UNDEFINED}.
+
+    // Private classes:
+    class trace_scope // Records a node in tracer (if there is one), from analyze_last_move()'s start until it returns.
+    {
+    public:
+        // Constructors:
+
+        trace_scope(const position& nodeP);
+
+        ~trace_scope(); // fills in the rest of the record from the node, and adds it.
+
+        // Public variables (set by analyze_last_move() as it goes):
+        trace_stop_reason stop_reason; // TRACE_SEARCHED until something else ends the search.
+        trace_TT_hit TT_hit;
+
+    private:
+        // Private variables:
+        const position& node;
+        trace_record record;
+        bool is_recorded;
+        bool was_sampling_subtree;
+    };
+
     // Private methods:
     void analyze_last_move(); // analyzes the last move to see if anyone won and to add anything to the above 4 vectors
                               // storing squares that allow 3-in-a-rows or 2-in-a-rows to be amplifyed.
@@ -285,10 +494,32 @@ private:
                                                                      // "analyze_last_move()".
     void add_to_appropriate_amplifying_vector(int num_pieces_in_a_row, treasure_spot empty_square);
     // function adds empty_square to one of the four amplifying vectors, depending on num_pieces_in_a_row and whose turn it is.
-    void minimax(); // Employs the minimax algorithm...
+    void minimax(bool search_only_first_move = false); // Employs the minimax algorithm...
                     // fills the future_positions vector with all positions one move ahead.
                     // eventually gives the evaluation attribute a value.
+                    // If search_only_first_move is true, only possible_moves[0] gets a future position (see quiescence_search()).
+    void sort_frontier_moves(const bitboard& current_bitboard);
+    // Stable sorts possible_moves from best to worst for whoever's turn it is, by batch_evaluator's scores.
+    void quiescence_search(); // evaluates a position at depth_limit (or beyond) where someone can make a 4-in-a-row right now.
+                              // Only looks at immediate wins and forced blocks. Gives the evaluation attribute a value.
+    void set_evaluation_from_outcome(int outcome);
+    // Sets evaluation to a forced win of unknown length for the comp, 0, or a forced win of unknown length for the user,
+    // given a proven outcome (+1, 0 or -1) from the perspective of whoever's turn it is.
+
+    void evaluate_at_depth_limit(); // evaluates the position with evaluator. Gives the evaluation attribute a value.
     void smart_evaluation(); // evaluates the position at depth_limit, if no one has won. Gives the evaluation attribute a value.
+    void smart_evaluation_with_board_copies(); // the first version of smart_evaluation(), which marks squares with 'A' in 2 copies of
+                                               // the board. Kept as the reference smart_evaluation() is checked against
+                                               // (see engine_state::check_smart_evaluation).
+    uint64_t mark_amplifying_squares(const vector<treasure_spot>& squares_amplifying_3, const vector<treasure_spot>& squares_amplifying_2,
+                                     uint64_t own_pieces, uint64_t empty_squares, uint64_t allowed_squares,
+                                     double* evaluation_as_double, bool is_comp, uint64_t own_final_marks, uint64_t opponent_final_marks) const;
+    // Goes through the amplifying vectors like find_individual_player_evaluation(), and returns the squares it would mark with 'A'
+    // (as bits). If evaluation_as_double isn't nullptr, the value of each square is also added to it (or subtracted, for the user),
+    // weighted using the marks both players end up with.
+    static uint64_t find_squares_allowed_for_play(const bitboard& current_bitboard);
+    // Returns the squares at or below (visually) the row barrier of their column (see initialize_row_barriers()), as bits.
+    uint64_t find_evaluation_cache_key() const; // the key of everything smart_evaluation() reads, for smart_evaluation_cache (never 0).
     void find_individual_player_evaluation(const vector<treasure_spot>& squares_amplifying_3,
                                           const vector<treasure_spot>& squares_amplifying_2, char piece,
                                           vector<vector<char>>& copy_board, vector<coordinate_and_value>& recorder) const;
@@ -313,34 +544,43 @@ private:
     coordinate find_ending_positive_slope_diagonal_point() const; // finds the top_right-most connected sqaure from last_move.
     coordinate find_starting_negative_slope_diagonal_point() const; // finds the top-left-most connected square from last_move.
     coordinate find_ending_negative_slope_diagonal_point() const; // finds the bottom-right-most connected square from last_move.
+
+    // Private static methods:
+    static void find_users_quickest_wins(engine_state& stateP, const bitboard& board_before_comp_move, const vector<coordinate>& comp_moves,
+                                         int max_number_of_moves, vector<int>& number_of_moves_user_wins_in);
+    // For each of comp_moves, finds how many moves the user needs to win after it (UNDEFINED if more than max_number_of_moves).
+    // The moves are shared among stateP's number_of_defence_threads threads. Once a move gets UNDEFINED, the moves after it that haven't
+    // been started are skipped, and are left as 0 in number_of_moves_user_wins_in.
 };
 
 // Initializing the static variables:
 
-const int position::UNDEFINED = INT_MAX - 1; // just a random value.
+const int position::UNDEFINED = INT_MAX - 5000; // just a random value (outside the range of forced win evaluations).
+const int position::win_distance_limit = 1000;
+const int position::unknown_win_distance = 43; // more than any real win distance, since there are at most 42 moves left in a game.
 const int position::max_row_index = 5;
 const int position::max_col_index = 6;
-int position::depth_limit = 1; // starts off at 1 every time the Engine thinks (iterative deepening).
+const int position::max_MTD_f_passes = 30;
 const double position::PI = 3.14159265359;
 
 const vector<vector<double>> position::hash_values_of_squares_with_C = find_hash_values_for_all_squares_in_board('C');
 const vector<vector<double>> position::hash_values_of_squares_with_U = find_hash_values_for_all_squares_in_board('U');
 const vector<vector<double>> position::hash_values_of_squares_empty = find_hash_values_for_all_squares_in_board(' ');
 
-vector<vector<position_info_for_TT>> position::transposition_table(1000005);
-vector<int> position::indices_of_elements_in_TT;
-
-int position::counter = 0;
-int position::counter_of_TT_usefulness = 0;
+vector<treasure_spot> position::empty_amplifying_vector;
 
-double position::thinking_time = 0.30;
+endgame_database position::precomputed_endgame_database;
 
-vector<treasure_spot> position::empty_amplifying_vector;
+const int position::defence_solver_TT_size_log_2 = 18;
 
 // CONSTRUCTORS:
 
-position::position(bool is_comp_turnP)
+position::position(engine_state& stateP, bool is_comp_turnP, int alphaP, int betaP)
 {
+    state = &stateP;
+
+    state->counter ++;
+
     // INITIALIZE BOARD:
 
     vector <char> row;
@@ -366,7 +606,7 @@ position::position(bool is_comp_turnP)
 
     depth = 0;
 
-    calculation_depth_from_this_position = depth_limit - depth;
+    calculation_depth_from_this_position = state->depth_limit - depth;
 
     number_of_pieces = 0;
 
@@ -390,12 +630,16 @@ position::position(bool is_comp_turnP)
  //   randomize_order_of_possible_moves();   FINALLY TAKING OUT RANDOMNESS
  // Besides, in most cases possible_moves will just be set to a possible moves vector from an earlier duplicate in the hash table.
 
-    alpha = UNDEFINED;
+    alpha = alphaP;
 
-    beta = UNDEFINED;
+    beta = betaP;
 
     evaluation = UNDEFINED;
 
+    lower_bound = UNDEFINED;
+
+    upper_bound = UNDEFINED;
+
     future_positions_size = 0;
 
     // Now figure out the pre-hash value of the position. All the squares store ' ', so it's easy: just sum all the entries in
@@ -419,6 +663,8 @@ position::position(bool is_comp_turnP)
     is_a_pruned_branch = false;
     got_value_from_pruned_child = false;
 
+    endgame_solver_move = {UNDEFINED, UNDEFINED};
+
     // So, call minimax() now:
 
     minimax();
@@ -426,17 +672,22 @@ position::position(bool is_comp_turnP)
     unique_ptr<position> temp;
 }
 
-position::position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+position::position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
                    const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
-                   const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P)
+                   const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
+                   int alphaP, int betaP)
 {
+    state = &stateP;
+
+    state->counter ++;
+
     board = boardP;
 
     is_comp_turn = is_comp_turnP;
 
     depth = 0;
 
-    calculation_depth_from_this_position = depth_limit - depth;
+    calculation_depth_from_this_position = state->depth_limit - depth;
 
     // FIGURE OUT NUMBER_OF_PIECES, USING AN EMBEDDED FOR LOOP TO RUN THROUGH THE ENTIRE BOARD.
 
@@ -495,12 +746,16 @@ position::position(const vector <vector<char>>& boardP, bool is_comp_turnP, coor
     }
  //   randomize_order_of_possible_moves();
 
-    alpha = UNDEFINED; // just some random value to signify that there is no alpha value yet.
+    alpha = alphaP; // UNDEFINED (just some random value) unless the caller gave the root a search window.
 
-    beta = UNDEFINED; // just some random value to signify that there is no beta value yet.
+    beta = betaP; // UNDEFINED (just some random value) unless the caller gave the root a search window.
 
     evaluation = UNDEFINED; // just some random value to signify that there is no evaluation value yet.
 
+    lower_bound = UNDEFINED;
+
+    upper_bound = UNDEFINED;
+
     future_positions_size = 0;
 
     squares_amplifying_comp_2 = squares_amplifying_comp_2P;
@@ -548,21 +803,27 @@ position::position(const vector <vector<char>>& boardP, bool is_comp_turnP, coor
     is_a_pruned_branch = false;
     got_value_from_pruned_child = false;
 
+    endgame_solver_move = {UNDEFINED, UNDEFINED};
+
     analyze_last_move(); // will analyze the last_move, and then call minimax() if the game isn't over.
 }
 
-position::position(const vector <vector<char>>& boardP, bool is_comp_turnP,
-                   int depthP, int number_of_piecesP, coordinate last_moveP,
+position::position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP,
+                   int depthP, int calculation_depth_from_this_positionP, int number_of_piecesP, coordinate last_moveP,
                    const vector<coordinate>& possible_movesP, int possible_moves_index,
                    int alphaP, int betaP,
                    const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
                    const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
                    double pre_hash_value_of_positionP, const vector<int>& num_pieces_per_columnP)
 {
+    state = &stateP;
+
+    state->counter ++;
+
     board = boardP;
     is_comp_turn = is_comp_turnP;
     depth = depthP;
-    calculation_depth_from_this_position = depth_limit - depth;
+    calculation_depth_from_this_position = calculation_depth_from_this_positionP;
     number_of_pieces = number_of_piecesP;
     last_move = last_moveP;
 
@@ -580,6 +841,8 @@ position::position(const vector <vector<char>>& boardP, bool is_comp_turnP,
     alpha = alphaP;
     beta = betaP;
     evaluation = UNDEFINED; // just some random value to signify there is no evaluation value yet.
+    lower_bound = UNDEFINED;
+    upper_bound = UNDEFINED;
     future_positions_size = 0;
 
     squares_amplifying_comp_2 = squares_amplifying_comp_2P;
@@ -611,6 +874,8 @@ position::position(const vector <vector<char>>& boardP, bool is_comp_turnP,
     is_a_pruned_branch = false;
     got_value_from_pruned_child = false;
 
+    endgame_solver_move = {UNDEFINED, UNDEFINED};
+
     analyze_last_move(); // will analyze the last_move, and then call minimax() if the game isn't over.
 }
 
@@ -658,21 +923,26 @@ coordinate position::get_last_move() const
 
 coordinate position::find_best_move_for_comp()
 {
-    if (depth_limit != 1)
+    if (state->depth_limit != 1)
     {
         throw runtime_error("depth limit does not equal 1 in find_best_move_for_comp()");
     }
 
+    if (endgame_solver_move.row != UNDEFINED) // The exact endgame solver already proved which move is best.
+    {
+        return endgame_solver_move;
+    }
+
     // This function should return the last_move attribute of the best future_position.
     // The problem is choosing which is the best future_position.
 
     // First, it's possible that the calling object could have an empty future_positions vector since the calling object
-    // automatically accepted an indisputable evaluation from a duplicate in the TT.
-        // If this is the case, just access this duplicate position from the TT and pick the best of its possible moves.
+    // automatically accepted an indisputable evaluation from the endgame database or the threat analysis.
+        // If this is the case, just look at each of its possible moves and pick the best.
 
     if (future_positions.empty())
     {
-        // This position must have a forced win, but it got its evaluation immediately from the TT and doesn't have a future positions vector.
+        // This position has a proven evaluation, but it got it without searching and doesn't have a future positions vector.
 
         // So, create a new search right here with depth_limit = 1 or 2. The TT will be used in the search process implicitly, as it
         // would normally.
@@ -685,7 +955,7 @@ coordinate position::find_best_move_for_comp()
 
             copy_board[current.row][current.col] = 'C';
 
-            unique_ptr<position> pt = make_unique<position>(copy_board, !is_comp_turn, current,
+            unique_ptr<position> pt = make_unique<position>(*state, copy_board, !is_comp_turn, current,
                                                             squares_amplifying_comp_2, squares_amplifying_comp_3,
                                                             squares_amplifying_user_2, squares_amplifying_user_3);
                 // NOTE: The static method for returning a unique_ptr isn't being called here, as I don't care
@@ -695,8 +965,14 @@ coordinate position::find_best_move_for_comp()
         }
     }
 
-    if (evaluation == INT_MAX) // Comp is winning, so see if there's a solution to win in <= 9 moves:
+    // Usually the search already found how fast any forced win is, and picking the child with the best evaluation below picks the
+    // fastest win (or the longest defense). Only forced wins of unknown length (from the endgame database, the threat analysis,
+    // or the endgame solver) need the proof-number solver's help here.
+
+    if (is_forced_win_for_comp(evaluation) && find_win_distance(evaluation) >= unknown_win_distance)
     {
+        // Comp is winning, so see if there's a solution to win in <= 9 moves:
+
         coordinate_and_value quick_winning_move = find_quick_winning_move(9); // UNDEFINED returned for value field if no solution in <= 9 moves.
 
         if (quick_winning_move.value != UNDEFINED)
@@ -705,8 +981,10 @@ coordinate position::find_best_move_for_comp()
         }
     }
 
-    if (evaluation == INT_MIN) // Comp is losing, so find the move that makes the comp work the longest, or at least work for 7 moves.
+    if (is_forced_win_for_user(evaluation) && find_win_distance(evaluation) >= unknown_win_distance)
     {
+        // Comp is losing, so find the move that makes the comp work the longest, or at least work for 7 moves.
+
         // Translation: Is there a comp move such that find_quick_winning_move(7) FOR USER returns UNDEFINED for the value field?
         // If not, pick the move that survives the longest.
 
@@ -714,26 +992,24 @@ coordinate position::find_best_move_for_comp()
         most_stubborn_defense.value = 1; // Starting off with the worst possible value to have - it says the user wins right on the spot.
         most_stubborn_defense.square = {UNDEFINED, UNDEFINED};
 
-        for (const coordinate& current_move: possible_moves)
-        {
-            vector<vector<char>> assisting_board = board;
-
-            assisting_board[current_move.row][current_move.col] = 'C';
+        // The moves are independent of each other, so they're checked in parallel. Going through the results in the order of
+        // possible_moves then picks the same move as checking them one at a time would.
 
-            unique_ptr<position> pt = make_unique<position>(assisting_board, !is_comp_turn, current_move, empty_amplifying_vector,
-                                                            empty_amplifying_vector, empty_amplifying_vector, empty_amplifying_vector);
+        vector<int> number_of_moves_user_wins_in;
 
-            int number_of_moves_user_wins_in = pt->find_quick_winning_move(7).value;
+        find_users_quickest_wins(*state, bitboard(board, 'C'), possible_moves, 7, number_of_moves_user_wins_in);
 
-            if (number_of_moves_user_wins_in == UNDEFINED) // user will have to work for > 7 moves, so pick this option immediately!
+        for (int i = 0; i < static_cast<int>(possible_moves.size()); i++)
+        {
+            if (number_of_moves_user_wins_in[i] == UNDEFINED) // user will have to work for > 7 moves, so pick this option immediately!
             {
-                return current_move;
+                return possible_moves[i];
             }
 
-            else if (most_stubborn_defense.square.row == UNDEFINED || most_stubborn_defense.value < number_of_moves_user_wins_in)
+            else if (most_stubborn_defense.square.row == UNDEFINED || most_stubborn_defense.value < number_of_moves_user_wins_in[i])
             {
-                most_stubborn_defense.value = number_of_moves_user_wins_in;
-                most_stubborn_defense.square = current_move;
+                most_stubborn_defense.value = number_of_moves_user_wins_in[i];
+                most_stubborn_defense.square = possible_moves[i];
             }
         }
 
@@ -745,7 +1021,15 @@ coordinate position::find_best_move_for_comp()
         return most_stubborn_defense.square;
     }
 
-    // Randomly pick a move with the same evaluation as the calling position object.
+    // Randomly pick a move with the best evaluation out of the future positions (which should be the calling object's evaluation,
+    // unless the calling object got its evaluation straight from the TT).
+
+    int best_evaluation = INT_MIN;
+
+    for (const unique_ptr<position>& pos: future_positions)
+    {
+        best_evaluation = max(best_evaluation, evaluation_seen_from_parent(pos->evaluation));
+    }
 
     vector <int> indices; // will store all the possible indices of future_positions vector.
 
@@ -761,7 +1045,7 @@ coordinate position::find_best_move_for_comp()
 
     for (int index: indices) // index is the current ELEMENT in indices, and acts as an INDEX for the future_positions vector.
     {
-        if (future_positions[index]->evaluation >= evaluation)
+        if (evaluation_seen_from_parent(future_positions[index]->evaluation) == best_evaluation)
         {
             return (future_positions[index]->last_move);
         }
@@ -772,6 +1056,47 @@ coordinate position::find_best_move_for_comp()
     throw runtime_error("Error - Control reached the end of the function in position::find_best_move_for_comp()\n");
 }
 
+multi_pv_result position::find_multi_pv() const
+{
+    multi_pv_result result;
+    result.depth = calculation_depth_from_this_position;
+
+    vector<int> indices; // of future_positions, sorted from best to worst for whoever's turn it is.
+
+    for (int i = 0; i < static_cast<int>(future_positions.size()); i++)
+    {
+        indices.push_back(i);
+    }
+
+    stable_sort(indices.begin(), indices.end(), [this](int first, int second)
+    {
+        int first_evaluation = evaluation_seen_from_parent(future_positions[first]->evaluation);
+        int second_evaluation = evaluation_seen_from_parent(future_positions[second]->evaluation);
+
+        return is_comp_turn ? first_evaluation > second_evaluation : first_evaluation < second_evaluation;
+    });
+
+    for (int i = 0; i < static_cast<int>(indices.size()) && i < state->multi_pv_count; i++)
+    {
+        const unique_ptr<position>& pos = future_positions[indices[i]];
+
+        principal_variation line;
+        line.evaluation = evaluation_seen_from_parent(pos->evaluation);
+        line.moves.push_back(pos->last_move);
+
+        pos->find_principal_variation(line.moves);
+
+        result.lines.push_back(line);
+    }
+
+    if (result.lines.empty() && endgame_solver_move.row != UNDEFINED) // the endgame solver handled this position without a search.
+    {
+        result.lines.push_back({evaluation, {endgame_solver_move}});
+    }
+
+    return result;
+}
+
 vector<treasure_spot> position::get_squares_amplifying_comp_2() const
 {
     return squares_amplifying_comp_2;
@@ -845,6 +1170,8 @@ void position::clean_up_amplifying_vectors()
 
 void position::rearrange_possible_moves(const vector<coordinate>& front_moves)
 {
+    PROFILE_SEARCH_PHASE(PHASE_REARRANGE_POSSIBLE_MOVES);
+
     int start_size = possible_moves.size();
 
     vector<coordinate> replacement = front_moves; // possible_moves will be set to this vector at the end of the function.
@@ -881,9 +1208,19 @@ void position::initialize_hash_value_of_position()
 
 void position::add_position_to_transposition_table(bool is_evaluation_indisputable)
 {
+    PROFILE_SEARCH_PHASE(PHASE_ADD_TO_TT);
+
+    if (lower_bound == UNDEFINED) // evaluation wasn't found by minimax(), so it's exact.
+    {
+        lower_bound = evaluation;
+        upper_bound = evaluation;
+    }
+
     position_info_for_TT temp;
     temp.board = board;
     temp.evaluation = evaluation;
+    temp.lower_bound = lower_bound;
+    temp.upper_bound = upper_bound;
     temp.calculation_depth_from_this_position = calculation_depth_from_this_position;
     temp.is_evaluation_indisputable = is_evaluation_indisputable;
     temp.is_comp_turn = is_comp_turn;
@@ -902,6 +1239,17 @@ void position::add_position_to_transposition_table(bool is_evaluation_indisputab
         {
             temp.possible_moves_sorted.push_back(pos->get_last_move());
         }
+
+        // If pruning stopped the search early, the moves that weren't looked at go last (a position reusing this vector
+        // still needs every possible move):
+
+        for (const coordinate& current: possible_moves)
+        {
+            if (find(temp.possible_moves_sorted.begin(), temp.possible_moves_sorted.end(), current) == temp.possible_moves_sorted.end())
+            {
+                temp.possible_moves_sorted.push_back(current);
+            }
+        }
     }
 
     // else, temp's possible_moves_sorted vector is simply left empty.
@@ -910,18 +1258,48 @@ void position::add_position_to_transposition_table(bool is_evaluation_indisputab
 
     bool does_a_duplicate_exist = false;
 
-    for (position_info_for_TT& current: transposition_table[hash_value_of_position]) // by reference is deliberate.
+    for (position_info_for_TT& current: state->transposition_table[hash_value_of_position]) // by reference is deliberate.
     {
         if (current.board == temp.board && current.is_comp_turn == temp.is_comp_turn)
         {
             does_a_duplicate_exist = true;
 
-            if (temp.calculation_depth_from_this_position > current.calculation_depth_from_this_position)
+            if (temp.calculation_depth_from_this_position > current.calculation_depth_from_this_position ||
+                (temp.is_evaluation_indisputable && !current.is_evaluation_indisputable))
             {
                 current = temp;
 
                 break;
             }
+
+            if (temp.calculation_depth_from_this_position == current.calculation_depth_from_this_position && !current.is_evaluation_indisputable)
+            {
+                // Same depth, so both sets of bounds hold. Keep the tighter of each (this is what lets repeated searches with different
+                // windows, like MTD(f)'s, build on each other). If they contradict each other, the newer search wins.
+
+                int tighter_lower_bound = max(current.lower_bound, temp.lower_bound);
+                int tighter_upper_bound = min(current.upper_bound, temp.upper_bound);
+
+                if (temp.is_evaluation_indisputable || tighter_lower_bound > tighter_upper_bound)
+                {
+                    current = temp;
+                }
+
+                else
+                {
+                    current.lower_bound = tighter_lower_bound;
+                    current.upper_bound = tighter_upper_bound;
+
+                    current.evaluation = (tighter_lower_bound == tighter_upper_bound) ? tighter_lower_bound : temp.evaluation;
+
+                    if (!temp.possible_moves_sorted.empty())
+                    {
+                        current.possible_moves_sorted = temp.possible_moves_sorted;
+                    }
+                }
+
+                break;
+            }
         }
     }
 
@@ -932,13 +1310,13 @@ void position::add_position_to_transposition_table(bool is_evaluation_indisputab
 
         // On the other hand, if a duplicate doesn't exist, obviously temp should obviously be added to the TT.
 
-        transposition_table[hash_value_of_position].push_back(temp);
+        state->transposition_table[hash_value_of_position].push_back(temp);
 
-        if (transposition_table[hash_value_of_position].size() == 1)
+        if (state->transposition_table[hash_value_of_position].size() == 1)
         {
             // So temp is the only element in the vector. Therefore, it was the first element to have been put there:
 
-            indices_of_elements_in_TT.push_back(hash_value_of_position);
+            state->indices_of_elements_in_TT.push_back(hash_value_of_position);
         }
     }
 }
@@ -1062,6 +1440,8 @@ void position::print_amplifying_vectors()
 
 void position::find_critical_moves(vector<coordinate>& critical_moves)
 {
+    PROFILE_SEARCH_PHASE(PHASE_FIND_CRITICAL_MOVES);
+
     // If it is the comp's turn in this position, I'll want to first add any moves that win for the comp to the
     // critical_moves vector first. This is because the critical_moves will be put at the front of possible_moves vector,
     // and if the comp can win then I want it to examine it right away (to allow minimax to prune other moves immediately).
@@ -1151,84 +1531,50 @@ void position::find_critical_moves_in_amplifying_vector(vector<coordinate>& crit
 
  void position::initialize_row_barriers()
  {
-    // Find all squares that give both comp AND user a 4-in-a-row. Could be in 2-in-a-row vectors too.
-
-    vector<coordinate> squares_winning_for_comp;
-    find_winning_squares(squares_winning_for_comp, squares_amplifying_comp_3, squares_amplifying_comp_2, 'C');
+    PROFILE_SEARCH_PHASE(PHASE_INITIALIZE_ROW_BARRIERS);
 
-    vector<coordinate> squares_winning_for_user;
-    find_winning_squares(squares_winning_for_user, squares_amplifying_user_3, squares_amplifying_user_2, 'U');
+    // Find all squares that give both comp AND user a 4-in-a-row ("barricade" squares), as bitboards.
 
-    // Now parse through squares_winning_for_comp vector, and for each square check if it's also
-    // in the squares_winning_for_user vector. If so, it's a "barricade" square.
+    bitboard current_bitboard(board, 'C'); // current_pieces are the comp's pieces.
 
-    vector<coordinate> barricade_squares;
-
-    for (const coordinate& temp: squares_winning_for_comp)
-    {
-        if (in_coordinate_vector(squares_winning_for_user, temp))
-        {
-            barricade_squares.push_back(temp);
-        }
-    }
+    uint64_t comp_pieces = current_bitboard.current_pieces;
+    uint64_t user_pieces = current_bitboard.all_pieces ^ comp_pieces;
 
-    // Now, get the lowest barricade_squares (visually) for each column in barricade_squares vector,
-    // extract their row index, and store these indices in the row_barriers private member (the whole point of this function).
+    uint64_t barricade_squares = bitboard::compute_winning_squares(comp_pieces, current_bitboard.all_pieces) &
+                                 bitboard::compute_winning_squares(user_pieces, current_bitboard.all_pieces);
 
-    for (int i = 0; i <= max_col_index; i++) // since row_barries isn't even initialized yet. Give it 7 UNDEFINED ints.
-    {
-        row_barriers.push_back(UNDEFINED);
-    }
+    // Now, get the lowest barricade square (visually) in each column, and store its row index in row_barriers
+    // (the whole point of this function).
 
-    for (const coordinate& temp: barricade_squares)
+    for (int col = 0; col <= max_col_index; col++)
     {
-        // square temp's col value corresponds to an index in row_barriers:
+        uint64_t barricades_in_column = barricade_squares & bitboard::column_mask(col);
 
-        if (row_barriers[temp.col] == UNDEFINED || row_barriers[temp.col] < temp.row)
+        if (barricades_in_column == 0)
         {
-            // Either that index in row_barriers has no value (undefined), or it stores a row
-            // value that is higher up (visually) on the board than square temp's row value.
-                // Since lower row values barricade more of a column, I should switch to that:
+            row_barriers[col] = UNDEFINED;
 
-            row_barriers[temp.col] = temp.row;
+            continue;
         }
-    }
- }
 
- void position::find_winning_squares(vector<coordinate>& vec, const vector<treasure_spot>& squares_amplifying_3,
-                                     const vector<treasure_spot>& squares_amplifying_2, char piece)
-{
-    for (const treasure_spot& temp: squares_amplifying_3)
-    {
-        if (board[temp.current_square.row][temp.current_square.col] == ' ')
-        {
-            vec.push_back(temp.current_square);
-        }
-    }
+        // The lowest bit of the column is the lowest square (visually). Count the bits below the lowest barricade square:
 
-    for (const treasure_spot& temp: squares_amplifying_2)
-    {
-        if (board[temp.current_square.row][temp.current_square.col] == ' ' &&
-            ((is_in_bounds(temp.next_square) && board[temp.next_square.row][temp.next_square.col] == piece) ||
-             (is_in_bounds(temp.other_next_square) && board[temp.other_next_square.row][temp.other_next_square.col] == piece)))
-        {
-            vec.push_back(temp.current_square);
-        }
-    }
+        int height = bitboard::population_count((barricades_in_column & -barricades_in_column) - 1) - col * (bitboard::height + 1);
 
-    remove_duplicates(vec);
-}
+        row_barriers[col] = max_row_index - height;
+    }
+ }
 
 // FUNCTIONS SPECIFICALLY FOR THE VERSUS SIM:
 
 double position::get_static_thinking_time() const
 {
-    return position::thinking_time;
+    return state->thinking_time;
 }
 
 void position::set_static_thinking_time(double val)
 {
-    position::thinking_time = val;
+    state->thinking_time = val;
 }
 
 unique_ptr<tool> position::call_static_think_on_game_position(const vector <vector<char>>& boardP, bool is_comp_turnP,
@@ -1237,159 +1583,46 @@ unique_ptr<tool> position::call_static_think_on_game_position(const vector <vect
                                                               const vector<treasure_spot>& squares_amplifying_user_2P,
                                                               const vector<treasure_spot>& squares_amplifying_user_3P, bool starting_new_game)
 {
-    return move(think_on_game_position(boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
+    return move(think_on_game_position(*state, boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
                                        squares_amplifying_user_2P, squares_amplifying_user_3P, starting_new_game));
 }
 
 unique_ptr<tool> position::call_static_think_on_game_position(bool is_comp_turnP, bool starting_new_game)
 {
-    return move(think_on_game_position(is_comp_turnP, starting_new_game));
+    return move(think_on_game_position(*state, is_comp_turnP, starting_new_game));
 }
 
 coordinate_and_value position::find_quick_winning_move(int max_number_moves_acceptable) const
 {
     // Returns the coordinate for a move winning in <= max_number_moves_acceptable, and returns the number of moves it wins in
     // (this is why I'm returning a coordinate_and_value object).
+    // The work is done by the proof-number solver, whose table is kept between calls (so proofs found for one root move
+    // are reused for the others).
 
     coordinate_and_value solution; // WILL BE RETURNED.
     solution.square = {UNDEFINED, UNDEFINED};
     solution.value = UNDEFINED;
 
-    if (max_number_moves_acceptable < 1) // Cannot do anything in less than 1 move...
-    {
-        return solution; // deliberately still UNDEFINED
-    }
-
-    // Now do a preliminary pass over all possible_moves, just checking at depth 1. Purpose is to see if any win immediately,
-    // which saves having to recursively delve into each of them in the rest of this function.
-
-    coordinate immediate_win = return_a_move_that_wins_immediately(); // Function returns {UNDEFINED, UNDEFINED} if no immediate win.
-
-    if (immediate_win.row != UNDEFINED) // An immediate win was found!
-    {
-        solution.square = immediate_win;
-        solution.value = 1;
-
-        return solution;
-    }
+    proof_number_solver_result result = state->quick_win_solver.find_quickest_win(bitboard(board, is_comp_turn ? 'C' : 'U'),
+                                                                           max_number_moves_acceptable);
 
-    else if (max_number_moves_acceptable < 3)
+    if (result.best_column == -1) // no win in <= max_number_moves_acceptable.
     {
-        // Due to the else if, immediate_win = {UNDEFINED, UNDEFINED}.
-        // So there's no immediate win, yet max_number_of_moves_acceptable is less than 3. This only gives player 1 move to win.
-        // Since I've verified this isn't the case, return solution, which is still UNDEFINED.
-
-        return solution;
+        return solution; // deliberately still UNDEFINED
     }
 
-    vector<vector<char>> assisting_board = board;
-
     for (const coordinate& current_move: possible_moves)
     {
-        char piece_to_be_played = 'C';
-
-        if (!is_comp_turn)
-        {
-            piece_to_be_played = 'U';
-        }
-
-        assisting_board[current_move.row][current_move.col] = piece_to_be_played;
-
-        if (piece_to_be_played == 'C')
-        {
-            piece_to_be_played = 'U';
-        }
-
-        else
-        {
-            piece_to_be_played = 'C';
-        }
-
-        unique_ptr<position> p1 = make_unique<position>(assisting_board, !is_comp_turn, current_move, empty_amplifying_vector,
-                                                        empty_amplifying_vector, empty_amplifying_vector, empty_amplifying_vector);
-
-        // NOTE: I know that player couldn't have won with this move, since I already checked if the player could win immediately
-        // with any of the moves in possible_moves.
-
-        // Check if p1 is in the TT. IF it is, make sure the TT says the position's evaluation is winning for the player.
-
-        bool is_player_winning = true;
-
-        for (const position_info_for_TT& current: transposition_table[p1->hash_value_of_position])
-        {
-            if (current.board == p1->board && current.is_comp_turn == p1->is_comp_turn &&
-                ((is_comp_turn && current.evaluation != INT_MAX) || (!is_comp_turn && current.evaluation != INT_MIN)))
-            {
-                is_player_winning = false;
-
-                break;
-            }
-        }
-
-        if (!is_player_winning)
-        {
-            // current_move is a failure, so continue to the next move in for loop:
-
-            assisting_board[current_move.row][current_move.col] = ' ';
-
-            continue;
-        }
-
-        // Now run through each of the opponent's responses, and see if player can win against all of them within the bound of moves.
-        // This will involve recursion.
-
-        int players_worst_performance_against_all_opponent_responses = 1;
-
-        bool can_opponent_win = false; // set to true if the opponent has a move that wins.
-
-        for (const coordinate& opponent_response: p1->possible_moves)
+        if (current_move.col == result.best_column)
         {
-            assisting_board[opponent_response.row][opponent_response.col] = piece_to_be_played;
-
-            unique_ptr<position> p2 = make_unique<position>(assisting_board, !p1->is_comp_turn, opponent_response, empty_amplifying_vector,
-                                                            empty_amplifying_vector, empty_amplifying_vector, empty_amplifying_vector);
-
-            // Now, check if the opponent is winning:
-
-            if ((is_comp_turn && p2->evaluation == INT_MIN) || (!is_comp_turn && p2->evaluation == INT_MAX))
-            {
-                can_opponent_win = true;
-
-                assisting_board[opponent_response.row][opponent_response.col] = ' ';
+            solution.square = current_move;
+            solution.value = result.number_of_moves;
 
-                break; // No need to consider other moves for the opponent, as there is one move that wins for the opponent.
-                       // current_move is a failure.
-            }
-
-            int number_of_moves_player_can_win_from_here = p2->find_quick_winning_move(max_number_moves_acceptable - 2).value;
-
-            if (number_of_moves_player_can_win_from_here == UNDEFINED ||
-                number_of_moves_player_can_win_from_here > players_worst_performance_against_all_opponent_responses)
-            {
-                players_worst_performance_against_all_opponent_responses = number_of_moves_player_can_win_from_here;
-            }
-
-            assisting_board[opponent_response.row][opponent_response.col] = ' ';
-
-            if (players_worst_performance_against_all_opponent_responses == UNDEFINED)
-            {
-                break; // current_move is a failure.
-            }
-        }
-
-        if (!can_opponent_win && players_worst_performance_against_all_opponent_responses != UNDEFINED)
-        {
-            if (solution.value == UNDEFINED || players_worst_performance_against_all_opponent_responses + 2 < solution.value)
-            {
-                solution.value = players_worst_performance_against_all_opponent_responses + 2;
-                solution.square = current_move;
-            }
+            return solution;
         }
-
-        assisting_board[current_move.row][current_move.col] = ' ';
     }
 
-    return solution;
+    throw runtime_error("Proof-number solver returned a column that isn't in possible_moves.\n");
 }
 
 coordinate position::return_a_move_that_wins_immediately() const
@@ -1409,7 +1642,7 @@ coordinate position::return_a_move_that_wins_immediately() const
     {
         assisting_board[current_move.row][current_move.col] = piece;
 
-        unique_ptr<position> pt = make_unique<position>(assisting_board, !is_comp_turn, current_move, empty_amplifying_vector,
+        unique_ptr<position> pt = make_unique<position>(*state, assisting_board, !is_comp_turn, current_move, empty_amplifying_vector,
                                                         empty_amplifying_vector, empty_amplifying_vector, empty_amplifying_vector);
 
         if ((is_comp_turn && pt->did_computer_win()) || (!is_comp_turn && pt->did_opponent_win()))
@@ -1487,16 +1720,16 @@ double position::cotangent_with_degrees(double angle_in_degrees)
     return 1.0 / (tan(angle_in_rad));
 }
 
-void position::reset_transposition_table()
+void position::reset_transposition_table(engine_state& stateP)
 {
-    for (int index: indices_of_elements_in_TT)
+    for (int index: stateP.indices_of_elements_in_TT)
     {
         // Delete all the elements in the inner vector of the TT at index.
 
-        transposition_table[index].clear();
+        stateP.transposition_table[index].clear();
     }
 
-    indices_of_elements_in_TT.clear();
+    stateP.indices_of_elements_in_TT.clear();
 }
 
 bool position::compare_future_positions_by_evaluation(const unique_ptr<position>& first_pos, const unique_ptr<position>& second_pos)
@@ -1522,7 +1755,7 @@ bool position::compare_future_positions_by_evaluation(const unique_ptr<position>
 
 position_info_for_TT position::find_duplicate_in_TT(const unique_ptr<position>& pt)
 {
-    for (const position_info_for_TT& current: transposition_table[pt->hash_value_of_position])
+    for (const position_info_for_TT& current: pt->state->transposition_table[pt->hash_value_of_position])
     {
         if (current.board == pt->board && current.is_comp_turn == pt->is_comp_turn)
         {
@@ -1533,88 +1766,565 @@ position_info_for_TT position::find_duplicate_in_TT(const unique_ptr<position>&
     throw runtime_error("Did not find a duplicate in find_duplicate_in_TT()\n");
 }
 
-unique_ptr<position> position::think_on_game_position(const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
-                                    const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
-                                    const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
-                                    bool starting_new_game)
+bool position::is_forced_win_for_comp(int eval)
 {
-    if (starting_new_game)
-    {
-        reset_transposition_table();
-    }
-
-    steady_clock::time_point start_time = steady_clock::now();
+    return eval >= INT_MAX - win_distance_limit && eval != UNDEFINED;
+}
 
-    unique_ptr<position> pt = make_unique<position>(boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
-                                                    squares_amplifying_user_2P, squares_amplifying_user_3P); // pt will be returned.
+bool position::is_forced_win_for_user(int eval)
+{
+    return eval <= INT_MIN + win_distance_limit;
+}
 
-    duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+bool position::is_fastest_win_found(int eval, int depth_limitP)
+{
+    return (is_forced_win_for_comp(eval) || is_forced_win_for_user(eval)) && find_win_distance(eval) <= depth_limitP;
+}
 
-    while (time_span.count() < thinking_time && !find_duplicate_in_TT(pt).is_evaluation_indisputable && pt->number_of_pieces + depth_limit <= 43)
+int position::find_win_distance(int eval)
+{
+    if (is_forced_win_for_comp(eval))
     {
-        depth_limit ++; // Iterative deepening.
+        return INT_MAX - eval;
+    }
+
+    if (is_forced_win_for_user(eval))
+    {
+        return eval - INT_MIN;
+    }
+
+    throw runtime_error("find_win_distance() called with an evaluation that isn't a forced win.\n");
+}
+
+int position::evaluation_seen_from_parent(int eval)
+{
+    if (is_forced_win_for_comp(eval))
+    {
+        return eval - 1;
+    }
+
+    if (is_forced_win_for_user(eval))
+    {
+        return eval + 1;
+    }
+
+    return eval;
+}
+
+int position::bound_seen_from_child(int bound)
+{
+    if (bound == UNDEFINED)
+    {
+        return bound;
+    }
+
+    if (is_forced_win_for_comp(bound))
+    {
+        return (bound == INT_MAX) ? bound : bound + 1;
+    }
+
+    if (is_forced_win_for_user(bound))
+    {
+        return (bound == INT_MIN) ? bound : bound - 1;
+    }
+
+    return bound;
+}
+
+unique_ptr<position> position::think_on_game_position(engine_state& stateP, const vector <vector<char>>& boardP, bool is_comp_turnP, coordinate last_moveP,
+                                    const vector<treasure_spot>& squares_amplifying_comp_2P, const vector<treasure_spot>& squares_amplifying_comp_3P,
+                                    const vector<treasure_spot>& squares_amplifying_user_2P, const vector<treasure_spot>& squares_amplifying_user_3P,
+                                    bool starting_new_game)
+{
+    if (starting_new_game)
+    {
+        reset_transposition_table(stateP);
+    }
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    const long long counter_at_start = stateP.counter;
+
+    stateP.statistics = {};
+
+    search_phase_timer::profile = {};
+
+    unique_ptr<position> pt = make_unique<position>(stateP, boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
+                                                    squares_amplifying_user_2P, squares_amplifying_user_3P); // pt will be returned.
+
+    // If the comp is to move and few enough squares are left, skip the heuristic search entirely: the exact endgame solver
+    // returns a proven result and best move, usually faster than even one iteration of the search below. With no thinking time,
+    // the position is only being played out (e.g., to get its amplifying vectors after a move), so it isn't solved.
 
-        pt = make_unique<position>(boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
-                                   squares_amplifying_user_2P, squares_amplifying_user_3P); // calls constructor 2.
+    if (stateP.thinking_time > 0 && is_comp_turnP && 42 - pt->number_of_pieces < stateP.endgame_solver_threshold && pt->number_of_pieces < 42 && !pt->did_someone_win())
+    {
+        endgame_solver_result result = stateP.exact_endgame_solver.solve(boardP, 'C');
+
+        pt->set_evaluation_from_outcome(result.outcome);
+
+        if (result.outcome != -1)
+        {
+            // If the comp is lost, endgame_solver_move is left UNDEFINED so that find_best_move_for_comp() still looks for
+            // the most stubborn defense.
+
+            pt->endgame_solver_move = {UNDEFINED, result.best_column};
+
+            for (const coordinate& current: pt->possible_moves)
+            {
+                if (current.col == result.best_column)
+                {
+                    pt->endgame_solver_move.row = current.row;
+                }
+            }
+        }
+
+        return pt;
+    }
+
+    auto create_root = [&](int alphaP, int betaP)
+    {
+        return make_unique<position>(stateP, boardP, is_comp_turnP, last_moveP, squares_amplifying_comp_2P, squares_amplifying_comp_3P,
+                                     squares_amplifying_user_2P, squares_amplifying_user_3P, alphaP, betaP); // calls constructor 2.
+    };
+
+    // MTD(f)'s first guesses. The evaluation swings back and forth between odd and even depths (whoever moves last at depth_limit
+    // looks better), so each iteration's guess is the evaluation from 2 iterations ago.
+
+    vector<int> guesses(2, pt->evaluation);
+
+    duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+    while (time_span.count() < stateP.thinking_time && !find_duplicate_in_TT(pt).is_evaluation_indisputable && pt->number_of_pieces + stateP.depth_limit <= 43
+           && !is_fastest_win_found(pt->evaluation, stateP.depth_limit) && stateP.depth_limit < stateP.max_depth_limit
+           && (stateP.max_nodes_per_move == 0 || stateP.counter - counter_at_start < stateP.max_nodes_per_move))
+    {
+        stateP.depth_limit ++; // Iterative deepening.
+
+        try
+        {
+            pt = search_at_depth_limit(stateP, create_root, guesses[stateP.depth_limit % 2]);
+        }
+
+        catch (const search_stopped&) // pt is still the root of the last iteration that finished.
+        {
+            break;
+        }
 
         time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+        stateP.statistics.depth_limit = stateP.depth_limit;
+        stateP.statistics.nodes = stateP.counter - counter_at_start;
+        stateP.statistics.seconds = time_span.count();
+
+        if (stateP.iteration_callback && !stateP.iteration_callback(*pt))
+        {
+            break;
+        }
     }
 
-    depth_limit = 1; // in preparation for the next time the Engine thinks.
+    stateP.depth_limit = 1; // in preparation for the next time the Engine thinks.
 
-    return move(pt);
+    return pt;
 }
 
-unique_ptr<position> position::think_on_game_position(bool is_comp_turnP, bool starting_new_game)
+unique_ptr<position> position::think_on_game_position(engine_state& stateP, bool is_comp_turnP, bool starting_new_game)
 {
     if (starting_new_game)
     {
-        reset_transposition_table();
+        reset_transposition_table(stateP);
     }
 
     steady_clock::time_point start_time = steady_clock::now();
 
+    const long long counter_at_start = stateP.counter;
+
+    stateP.statistics = {};
+
+    search_phase_timer::profile = {};
+
     // This function is similar to the one above, except it's for getting the computer to think at the starting position.
     // Still do iterative deepening, since I want the computer to play as good as possible even on the first move of the game.
 
-    unique_ptr<position> pt = make_unique<position>(is_comp_turnP); // pt will be returned.
+    unique_ptr<position> pt = make_unique<position>(stateP, is_comp_turnP); // pt will be returned.
+
+    auto create_root = [&stateP, is_comp_turnP](int alphaP, int betaP)
+    {
+        return make_unique<position>(stateP, is_comp_turnP, alphaP, betaP); // calls constructor 1.
+    };
+
+    // MTD(f)'s first guesses. The evaluation swings back and forth between odd and even depths (whoever moves last at depth_limit
+    // looks better), so each iteration's guess is the evaluation from 2 iterations ago.
+
+    vector<int> guesses(2, pt->evaluation);
 
     duration<double> time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
 
-    while (time_span.count() < thinking_time && !find_duplicate_in_TT(pt).is_evaluation_indisputable && pt->number_of_pieces + depth_limit <= 43)
+    while (time_span.count() < stateP.thinking_time && !find_duplicate_in_TT(pt).is_evaluation_indisputable && pt->number_of_pieces + stateP.depth_limit <= 43
+           && !is_fastest_win_found(pt->evaluation, stateP.depth_limit) && stateP.depth_limit < stateP.max_depth_limit
+           && (stateP.max_nodes_per_move == 0 || stateP.counter - counter_at_start < stateP.max_nodes_per_move))
     {
-        depth_limit ++; // Iterative deepening.
+        stateP.depth_limit ++; // Iterative deepening.
+
+        try
+        {
+            pt = search_at_depth_limit(stateP, create_root, guesses[stateP.depth_limit % 2]);
+        }
 
-        pt = make_unique<position>(is_comp_turnP); // calls constructor 2.
+        catch (const search_stopped&) // pt is still the root of the last iteration that finished.
+        {
+            break;
+        }
 
         time_span = duration_cast<duration<double>>(steady_clock::now() - start_time);
+
+        stateP.statistics.depth_limit = stateP.depth_limit;
+        stateP.statistics.nodes = stateP.counter - counter_at_start;
+        stateP.statistics.seconds = time_span.count();
+
+        if (stateP.iteration_callback && !stateP.iteration_callback(*pt))
+        {
+            break;
+        }
+    }
+
+    stateP.depth_limit = 1; // in preparation for the next time the Engine thinks.
+
+    return pt;
+}
+
+unique_ptr<position> position::search_at_depth_limit(const engine_state& stateP, const function<unique_ptr<position>(int, int)>& create_root, int& guess)
+{
+    if (stateP.settings.search_driver != MTD_F || stateP.multi_pv_count > 1) // multi-PV needs the root's alpha to itself (see minimax()).
+    {
+        unique_ptr<position> pt = create_root(UNDEFINED, UNDEFINED);
+
+        guess = pt->evaluation;
+
+        return pt;
+    }
+
+    // MTD(f): each null window search (beta - 1, beta) only answers whether the evaluation is >= beta, which prunes far more than
+    // an open window does. The answers shrink [lower, upper] until it closes in on the evaluation. The searches are cheap to repeat,
+    // since the TT keeps the bounds found by the earlier ones.
+
+    // The evaluations here move in steps of 1, while the first guess is often a few dozen off. So whenever a search fails the same
+    // way as the one before it, the next guess jumps twice as far past the new bound.
+
+    guess = max(INT_MIN + 1, min(INT_MAX - 1, guess));
+
+    int lower = INT_MIN;
+    int upper = INT_MAX;
+
+    long long step = 1;
+    int last_direction = 0; // +1 if the last search failed high, -1 if it failed low.
+
+    bool has_converged = false;
+
+    for (int pass = 0; pass < max_MTD_f_passes; pass++)
+    {
+        int beta = (guess == lower) ? guess + 1 : guess;
+
+        unique_ptr<position> pt = create_root(beta - 1, beta);
+
+        int direction = 0;
+
+        if (pt->upper_bound < beta) // failed low.
+        {
+            upper = pt->upper_bound;
+
+            direction = -1;
+        }
+
+        else if (pt->lower_bound >= beta) // failed high.
+        {
+            lower = pt->lower_bound;
+
+            direction = 1;
+        }
+
+        else // the bounds say nothing about beta (the search was unstable), so give up on the null windows.
+        {
+            break;
+        }
+
+        if (lower >= upper)
+        {
+            guess = lower;
+
+            has_converged = true;
+
+            break;
+        }
+
+        step = (direction == last_direction) ? step * 2 : 1;
+
+        last_direction = direction;
+
+        if (direction == -1)
+        {
+            guess = static_cast<int>(max(static_cast<long long>(lower), upper - step + 1));
+        }
+
+        else
+        {
+            guess = static_cast<int>(min(static_cast<long long>(upper), lower + step - 1));
+        }
+    }
+
+    // The null window searches leave the root with only some of its future positions (or with bounds for them), so finish with a search
+    // around the evaluation. It's nearly all TT lookups by now, and gives find_best_move_for_comp() the best move's exact evaluation.
+    // If MTD(f) didn't settle on an evaluation, search with no window instead, just like the ALPHA_BETA driver.
+
+    unique_ptr<position> pt;
+
+    if (has_converged)
+    {
+        guess = max(INT_MIN + 1, min(INT_MAX - 1, guess));
+
+        pt = create_root(guess - 1, guess + 1);
+    }
+
+    else
+    {
+        pt = create_root(UNDEFINED, UNDEFINED);
+    }
+
+    guess = pt->evaluation;
+
+    return pt;
+}
+
+// PRIVATE STATIC METHODS:
+
+void position::find_users_quickest_wins(engine_state& stateP, const bitboard& board_before_comp_move, const vector<coordinate>& comp_moves,
+                                        int max_number_of_moves, vector<int>& number_of_moves_user_wins_in)
+{
+    number_of_moves_user_wins_in.assign(comp_moves.size(), 0);
+
+    int number_of_threads = max(1, min(stateP.number_of_defence_threads, static_cast<int>(comp_moves.size())));
+
+    if (!stateP.defence_pool)
+    {
+        stateP.defence_pool = make_unique<defence_thread_pool>(defence_solver_TT_size_log_2);
+    }
+
+    atomic<int> next_move(0); // index of the next move in comp_moves a thread should take.
+    atomic<bool> found_move_without_quick_win(false);
+
+    // Each thread only touches its own solver, and its own elements of number_of_moves_user_wins_in:
+
+    stateP.defence_pool->run(number_of_threads, [&](proof_number_solver& solver)
+    {
+        while (!found_move_without_quick_win)
+        {
+            int i = next_move++;
+
+            if (i >= static_cast<int>(comp_moves.size()))
+            {
+                return;
+            }
+
+            bitboard board_after_comp_move = board_before_comp_move;
+
+            board_after_comp_move.play(comp_moves[i].col);
+
+            proof_number_solver_result users_quickest_win = solver.find_quickest_win(board_after_comp_move, max_number_of_moves);
+
+            if (users_quickest_win.best_column == -1)
+            {
+                number_of_moves_user_wins_in[i] = UNDEFINED;
+
+                found_move_without_quick_win = true;
+            }
+
+            else
+            {
+                number_of_moves_user_wins_in[i] = users_quickest_win.number_of_moves;
+            }
+        }
+    });
+}
+
+// PRIVATE CLASSES:
+
+position::trace_scope::trace_scope(const position& nodeP) : node(nodeP)
+{
+    stop_reason = TRACE_SEARCHED;
+
+    TT_hit = TRACE_TT_MISS;
+
+    is_recorded = node.state->tracer && node.state->tracer->enter_node(node.depth, record, was_sampling_subtree);
+
+    if (!is_recorded)
+    {
+        return;
     }
 
-    depth_limit = 1; // in preparation for the next time the Engine thinks.
+    record.alpha_in = (node.alpha == UNDEFINED) ? trace_record::no_bound : node.alpha;
+    record.beta_in = (node.beta == UNDEFINED) ? trace_record::no_bound : node.beta;
 
-    return move(pt);
+    record.ply = node.depth;
+    record.depth_limit = node.state->depth_limit;
+    record.move_col = (node.last_move.col == UNDEFINED) ? -1 : node.last_move.col;
+}
+
+position::trace_scope::~trace_scope()
+{
+    if (!is_recorded)
+    {
+        return;
+    }
+
+    // The reasons analyze_last_move() doesn't set itself are worked out from how the node ended up:
+
+    if ((stop_reason == TRACE_SEARCHED || stop_reason == TRACE_QUIESCENCE) && node.is_a_pruned_branch)
+    {
+        stop_reason = TRACE_ALPHA_BETA_CUTOFF;
+    }
+
+    else if (stop_reason == TRACE_SEARCHED && (node.evaluation == INT_MAX || node.evaluation == INT_MIN))
+    {
+        stop_reason = TRACE_WIN;
+    }
+
+    else if (stop_reason == TRACE_SEARCHED && node.number_of_pieces == 42 && node.future_positions_size == 0)
+    {
+        stop_reason = TRACE_DRAW;
+    }
+
+    record.alpha_out = (node.alpha == UNDEFINED) ? trace_record::no_bound : node.alpha;
+    record.beta_out = (node.beta == UNDEFINED) ? trace_record::no_bound : node.beta;
+
+    record.score = node.evaluation;
+
+    record.stop_reason = stop_reason;
+    record.TT_hit = TT_hit;
+
+    record.flags = (node.is_comp_turn ? trace_record::is_comp_turn_flag : 0) |
+                   (node.got_value_from_pruned_child ? trace_record::got_value_from_pruned_child_flag : 0);
+
+    record.moves_searched = node.future_positions_size;
+    record.number_of_moves = node.possible_moves.size();
+
+    node.state->tracer->exit_node(record, was_sampling_subtree);
 }
 
 // PRIVATE METHODS:
 
 void position::analyze_last_move()
 {
+    PROFILE_SEARCH_PHASE(PHASE_OTHER_SEARCH);
+
+    trace_scope node_trace(*this);
+
     // First, check if this position has already been analyzed, and has an evaluation in the transposition table.
 
     // If so, accept this evaluation if one of two conditions are met:
         // 1) The evaluation is indisputable (i.e., forced).
         // 2) The duplicate position in the hash table has a >= "calculation_depth_from_this_position" than the calling object.
+    // For 2), if the duplicate only has bounds on its evaluation (its search was cut short by alpha-beta pruning), they're
+    // enough when they show this position would get pruned anyways.
+
+    // The root (depth 0) is always searched though, so that it has future positions to pick its move from.
+
+    state->statistics.max_depth = max(state->statistics.max_depth, depth);
 
-    for (const position_info_for_TT& current: transposition_table[hash_value_of_position])
     {
-        if (current.board == board && current.is_comp_turn == is_comp_turn &&
-            (current.is_evaluation_indisputable || current.calculation_depth_from_this_position >= calculation_depth_from_this_position))
+        PROFILE_SEARCH_PHASE(PHASE_TT_PROBE);
+
+        for (const position_info_for_TT& current: state->transposition_table[hash_value_of_position])
         {
-            evaluation = current.evaluation;
+            if (depth == 0 || current.board != board || current.is_comp_turn != is_comp_turn)
+            {
+                continue;
+            }
+
+            if (current.is_evaluation_indisputable ||
+                (current.calculation_depth_from_this_position >= calculation_depth_from_this_position && current.lower_bound == current.upper_bound))
+            {
+                evaluation = current.evaluation;
+
+                lower_bound = evaluation;
+                upper_bound = evaluation;
+
+              //  counter_of_TT_usefulness ++;
+
+                state->statistics.TT_cutoffs ++;
+
+                node_trace.stop_reason = TRACE_TT_CUTOFF;
+                node_trace.TT_hit = TRACE_TT_EXACT;
 
-          //  counter_of_TT_usefulness ++;
+                return; // All done for this position entirely!
+            }
+
+            if (current.calculation_depth_from_this_position >= calculation_depth_from_this_position)
+            {
+                if (beta != UNDEFINED && current.lower_bound >= beta) // would fail high.
+                {
+                    evaluation = current.lower_bound;
+
+                    lower_bound = current.lower_bound;
+                    upper_bound = current.upper_bound;
+
+                    if (is_comp_turn) // MAX node, so treat it just like the pruning in minimax() would.
+                    {
+                        evaluation++;
+
+                        is_a_pruned_branch = true;
+                    }
+
+                    state->statistics.TT_cutoffs ++;
+
+                    node_trace.stop_reason = TRACE_TT_CUTOFF;
+                    node_trace.TT_hit = TRACE_TT_LOWER_BOUND;
+
+                    return;
+                }
+
+                if (alpha != UNDEFINED && current.upper_bound <= alpha) // would fail low.
+                {
+                    evaluation = current.upper_bound;
+
+                    lower_bound = current.lower_bound;
+                    upper_bound = current.upper_bound;
+
+                    if (!is_comp_turn) // MIN node, so treat it just like the pruning in minimax() would.
+                    {
+                        evaluation--;
+
+                        is_a_pruned_branch = true;
+                    }
+
+                    state->statistics.TT_cutoffs ++;
+
+                    node_trace.stop_reason = TRACE_TT_CUTOFF;
+                    node_trace.TT_hit = TRACE_TT_UPPER_BOUND;
+
+                    return;
+                }
+            }
+
+            break; // the duplicate doesn't settle anything, so search the position.
+        }
+    }
+
+    // Next, see if the position is close enough to the end of the game to be in the precomputed endgame database.
+    // If it is, its evaluation is indisputable and no search is needed at all.
+    // (Positions where someone has won are never stored in the database, so the last move didn't win if it's found.)
+
+    if (precomputed_endgame_database.is_loaded() && 42 - number_of_pieces <= precomputed_endgame_database.get_max_empty_squares())
+    {
+        int outcome = 0; // from the perspective of whoever's turn it is in this position.
+
+        if (precomputed_endgame_database.probe(bitboard(board, is_comp_turn ? 'C' : 'U'), outcome))
+        {
+            set_evaluation_from_outcome(outcome);
+
+            node_trace.stop_reason = TRACE_ENDGAME_DATABASE;
+
+            add_position_to_transposition_table(true);
 
-            return; // All done for this position entirely!
+            return;
         }
     }
 
@@ -1676,14 +2386,44 @@ void position::analyze_last_move()
 
     find_critical_moves(critical_moves); // passed by reference.
 
-    if (depth >= depth_limit && critical_moves.size() == 0) // Quiescent state reached at depth_limit (or beyond).
+    if (critical_moves.empty() && number_of_pieces >= state->threat_analysis_min_pieces)
+    {
+        // Quiet position (nobody can win right away), so see if the odd/even threat analysis already proves how the game ends.
+        // If it does, the evaluation is indisputable and the whole subtree below this position is skipped.
+
+        int outcome = 0; // from the perspective of whoever's turn it is in this position.
+
+        if (threat_parity_analyzer::find_proven_outcome(bitboard(board, is_comp_turn ? 'C' : 'U'), outcome))
+        {
+            set_evaluation_from_outcome(outcome);
+
+            node_trace.stop_reason = TRACE_THREAT_PARITY;
+
+            add_position_to_transposition_table(true);
+
+            return;
+        }
+    }
+
+    if (calculation_depth_from_this_position <= 0 && critical_moves.size() == 0) // Quiescent state reached at depth_limit (or beyond).
     {
-        // So, smart_evaluation() is ready to evaluate the position:
+        // So, the position is ready to be evaluated:
 
-        smart_evaluation(); // gives the evaluation attribute a value.
+        evaluate_at_depth_limit(); // gives the evaluation attribute a value.
 
         add_position_to_transposition_table(false);
 
+        node_trace.stop_reason = TRACE_LEAF;
+
+        return;
+    }
+
+    if (calculation_depth_from_this_position <= 0) // At depth_limit (or beyond), but someone can make a 4-in-a-row. Only follow the forced moves from here.
+    {
+        node_trace.stop_reason = TRACE_QUIESCENCE;
+
+        quiescence_search();
+
         return;
     }
 
@@ -1693,7 +2433,7 @@ void position::analyze_last_move()
 
     bool found_earlier_duplicate_in_TT = false;
 
-    for (const position_info_for_TT& current: transposition_table[hash_value_of_position])
+    for (const position_info_for_TT& current: state->transposition_table[hash_value_of_position])
     {
         if (current.board == board && current.is_comp_turn == is_comp_turn && !current.possible_moves_sorted.empty())
         {
@@ -1701,6 +2441,8 @@ void position::analyze_last_move()
 
             found_earlier_duplicate_in_TT = true;
 
+            node_trace.TT_hit = TRACE_TT_MOVE_ORDER;
+
             break;
         }
     }
@@ -1716,6 +2458,8 @@ void position::analyze_last_move()
 
 void position::analyze_horizontal_perspective_of_last_move()
 {
+    PROFILE_SEARCH_PHASE(PHASE_ANALYZE_HORIZONTAL);
+
     coordinate start_point = find_starting_horizontal_point();
     coordinate end_point = find_ending_horizontal_point();
     int num_pieces_in_a_row = end_point.col - start_point.col + 1;
@@ -1816,6 +2560,8 @@ void position::analyze_horizontal_perspective_of_last_move()
 
 void position::analyze_vertical_perspective_of_last_move()
 {
+    PROFILE_SEARCH_PHASE(PHASE_ANALYZE_VERTICAL);
+
     coordinate start_point = find_starting_vertical_point();
     coordinate end_point = find_ending_vertical_point();
     int num_pieces_in_a_row = end_point.row - start_point.row + 1;
@@ -1865,6 +2611,8 @@ void position::analyze_vertical_perspective_of_last_move()
 
 void position::analyze_positive_slope_diagonal_perspective_of_last_move()
 {
+    PROFILE_SEARCH_PHASE(PHASE_ANALYZE_POSITIVE_SLOPE_DIAGONAL);
+
     coordinate start_point = find_starting_positive_slope_diagonal_point();
     coordinate end_point = find_ending_positive_slope_diagonal_point();
     int num_pieces_in_a_row = end_point.col - start_point.col + 1; // could also have used start_point.row - end_point.row + 1.
@@ -1979,6 +2727,8 @@ void position::analyze_positive_slope_diagonal_perspective_of_last_move()
 
 void position::analyze_negative_slope_diagonal_perspective_of_last_move()
 {
+    PROFILE_SEARCH_PHASE(PHASE_ANALYZE_NEGATIVE_SLOPE_DIAGONAL);
+
     coordinate start_point = find_starting_negative_slope_diagonal_point();
     coordinate end_point = find_ending_negative_slope_diagonal_point();
     int num_pieces_in_a_row = end_point.col - start_point.col + 1; // could also have used end_point.row - start_point.row + 1.
@@ -2114,14 +2864,54 @@ void position::add_to_appropriate_amplifying_vector(int num_pieces_in_a_row, tre
     }
 }
 
-void position::minimax()
+void position::minimax(bool search_only_first_move)
 {
     // Here's where all the magic happens.
 
     // The game is not over, so look at all positions one move ahead.
     // Then, set evaluation accordingly, using the minimax algorithm...
 
-    for (int i = 0; i < possible_moves.size(); i++) // running through the possible_moves vector to play out each move.
+    // Also keep track of the bounds on this position's true evaluation, using the future positions' bounds.
+    // (If the loop gets cut short by pruning, the moves not looked at could be anything, so one of the bounds is lost.)
+
+    int bound_from_worst_case = is_comp_turn ? INT_MIN : INT_MAX; // becomes lower_bound for a MAX node, upper_bound for a MIN node.
+    int bound_from_best_case = is_comp_turn ? INT_MIN : INT_MAX; // becomes upper_bound for a MAX node, lower_bound for a MIN node.
+
+    // Late move reductions and futility pruning only happen in quiet positions (nobody can make a 4-in-a-row right now),
+    // and never at the root, since the root's future positions are what the comp picks its move from.
+
+    bitboard current_bitboard(board, is_comp_turn ? 'C' : 'U');
+
+    bool is_quiet = depth > 0 && (state->settings.use_late_move_reductions || state->settings.use_futility_pruning) &&
+                    ((current_bitboard.winning_squares_of_player_to_move() | current_bitboard.winning_squares_of_opponent())
+                     & current_bitboard.possible()) == 0;
+
+    int number_of_winning_squares = is_quiet ? bitboard::population_count(current_bitboard.winning_squares_of_player_to_move()) : 0;
+
+    int static_evaluation = UNDEFINED; // evaluate_at_depth_limit() of this position, only worked out if futility pruning needs it.
+
+    // depth_limit is only above 1 in think_on_game_position()'s iterations (its first root, searched to depth_limit 1, is what's
+    // left if the first iteration gets stopped). Nothing has been stored in the TT for this position yet, so it's safe to leave.
+
+    if (state->stop_flag != nullptr && state->depth_limit > 1 && state->stop_flag->load(memory_order_relaxed))
+    {
+        throw search_stopped();
+    }
+
+    // FRONTIER MOVE ORDERING: one ply before depth_limit, every future position is a leaf. So in a quiet position, sort the moves
+    // by the threats they leave (all of them scored in one pass by batch_evaluator), to get the best leaf first and prune more.
+    // Only the order changes: each leaf is still evaluated on its own with evaluate_at_depth_limit().
+
+    if (state->settings.order_frontier_moves && depth > 0 && calculation_depth_from_this_position == 1 && !search_only_first_move && possible_moves.size() > 1 &&
+        ((current_bitboard.winning_squares_of_player_to_move() | current_bitboard.winning_squares_of_opponent())
+         & current_bitboard.possible()) == 0)
+    {
+        sort_frontier_moves(current_bitboard);
+    }
+
+    int number_of_moves_to_search = search_only_first_move ? 1 : possible_moves.size();
+
+    for (int i = 0; i < number_of_moves_to_search; i++) // running through the possible_moves vector to play out each move.
     {
         coordinate current_move = possible_moves[i];
 
@@ -2129,57 +2919,172 @@ void position::minimax()
 
         vector <vector<char>> copy_board = board;
 
-        if (is_comp_turn)
+        if (is_comp_turn)
+        {
+            copy_board[current_move.row][current_move.col] = 'C';
+        }
+
+        else // opponent's turn:
+        {
+            copy_board[current_move.row][current_move.col] = 'U';
+        }
+
+        // A move is quiet if it doesn't give the player making it a new square to win on. Quiet moves are the only ones
+        // reduced or pruned below.
+
+        bool is_quiet_move = is_quiet &&
+            current_bitboard.move_score(1ULL << bitboard::bit_index(current_move.row, current_move.col)) <= number_of_winning_squares;
+
+        // FUTILITY PRUNING: one ply before depth_limit, a quiet move won't change the static evaluation by more than futility_margin.
+        // If even that isn't enough to beat the best alternative so far, skip the move.
+
+        if (state->settings.use_futility_pruning && is_quiet_move && i > 0 && calculation_depth_from_this_position == 1)
+        {
+            if (static_evaluation == UNDEFINED)
+            {
+                int evaluation_so_far = evaluation;
+
+                evaluate_at_depth_limit();
+
+                static_evaluation = evaluation;
+
+                evaluation = evaluation_so_far;
+            }
+
+            if (is_comp_turn && alpha != UNDEFINED && static_evaluation + state->futility_margin <= alpha)
+            {
+                bound_from_best_case = max(bound_from_best_case, static_evaluation + state->futility_margin);
+
+                state->futility_pruning_counter ++;
+
+                continue;
+            }
+
+            if (!is_comp_turn && beta != UNDEFINED && static_evaluation - state->futility_margin >= beta)
+            {
+                bound_from_best_case = min(bound_from_best_case, static_evaluation - state->futility_margin);
+
+                state->futility_pruning_counter ++;
+
+                continue;
+            }
+        }
+
+        // LATE MOVE REDUCTIONS: thanks to the move ordering (critical moves first, or the order from an earlier search in the TT),
+        // the best move is nearly always one of the first few. So quiet moves after those are searched late_move_reduction plies
+        // shallower. If one of them still gets inside the window (above alpha for the comp, below beta for the user), it's searched
+        // again to the full depth.
+
+        bool is_move_reduced = state->settings.use_late_move_reductions && is_quiet_move && i >= state->late_move_index && calculation_depth_from_this_position >= 3;
+
+        // PRINCIPAL VARIATION SEARCH: with the PVS driver, the first move is expected to be the best, so the others only have to show
+        // they're no better than it: the comp's moves get the null window (alpha, alpha + 1), and the user's (beta - 1, beta). That's
+        // pointless if the window is already that narrow, and at a multi-PV root (alpha isn't the best evaluation there).
+
+        bool is_null_window_searched = state->settings.search_driver == PVS && i > 0 && !(depth == 0 && state->multi_pv_count > 1) &&
+                                       ((is_comp_turn && alpha != UNDEFINED && alpha != INT_MAX && (beta == UNDEFINED || beta > alpha + 1)) ||
+                                        (!is_comp_turn && beta != UNDEFINED && beta != INT_MIN && (alpha == UNDEFINED || alpha < beta - 1)));
+
+        int window_alpha = alpha;
+        int window_beta = beta;
+
+        if (is_null_window_searched)
+        {
+            window_alpha = is_comp_turn ? alpha : beta - 1;
+            window_beta = is_comp_turn ? alpha + 1 : beta;
+        }
+
+        // Now to make a new position object, with this updated board that's one move ahead.
+
+        auto create_future_position = [&](int future_calculation_depth, int future_alpha, int future_beta)
+        {
+            PROFILE_SEARCH_PHASE(PHASE_CHILD_ALLOCATION);
+
+            return make_unique<position>(*state, copy_board, !is_comp_turn, depth + 1, future_calculation_depth,
+                                         number_of_pieces + 1, current_move,
+                                         possible_moves, i, bound_seen_from_child(future_alpha), bound_seen_from_child(future_beta),
+                                         squares_amplifying_comp_2, squares_amplifying_comp_3,
+                                         squares_amplifying_user_2, squares_amplifying_user_3,
+                                         pre_hash_value_of_position, num_pieces_per_column);
+                                         // Note that this position's 4 amplifying vectors are being sent.
+                                         // Any necessary additions to be made to the amplifying vectors
+                                         // due to last_move (represented by current_move here) will be
+                                         // handled in the constructor.
+                                         // Also, this position's pre_hash_value_of_position variable is being sent.
+                                         // It will be updated appropriately in the constructor of the child position node.
+                                         // Finally, num_pieces_per_column for this position is being sent,
+                                         // and then necessary change due to last_move will be taken care of in constructor.
+        };
+
+        unique_ptr<position> pt = create_future_position(calculation_depth_from_this_position - 1 -
+                                                         (is_move_reduced ? state->late_move_reduction : 0), window_alpha, window_beta);
+
+        if (is_move_reduced && ((is_comp_turn && (alpha == UNDEFINED || evaluation_seen_from_parent(pt->evaluation) > alpha)) ||
+                                (!is_comp_turn && (beta == UNDEFINED || evaluation_seen_from_parent(pt->evaluation) < beta))))
         {
-            copy_board[current_move.row][current_move.col] = 'C';
+            state->late_move_research_counter ++;
+
+            pt = create_future_position(calculation_depth_from_this_position - 1, window_alpha, window_beta);
         }
 
-        else // opponent's turn:
+        // If the null window search shows the move is better than the first one, its evaluation is only a bound. So unless it's good enough
+        // to prune this position anyways, search it again with the full window to get its evaluation.
+
+        if (is_null_window_searched &&
+            ((is_comp_turn && evaluation_seen_from_parent(pt->evaluation) > alpha && (beta == UNDEFINED || evaluation_seen_from_parent(pt->evaluation) < beta)) ||
+             (!is_comp_turn && evaluation_seen_from_parent(pt->evaluation) < beta && (alpha == UNDEFINED || evaluation_seen_from_parent(pt->evaluation) > alpha))))
         {
-            copy_board[current_move.row][current_move.col] = 'U';
-        }
+            state->null_window_research_counter ++;
 
-        // Now to make a new position object, with this updated board that's one move ahead.
+            pt = create_future_position(calculation_depth_from_this_position - 1, alpha, beta);
+        }
 
-        unique_ptr<position> pt = make_unique<position>(copy_board, !is_comp_turn, depth + 1,
-                                                        number_of_pieces + 1, current_move,
-                                                        possible_moves, i, alpha, beta,
-                                                        squares_amplifying_comp_2, squares_amplifying_comp_3,
-                                                        squares_amplifying_user_2, squares_amplifying_user_3,
-                                                        pre_hash_value_of_position, num_pieces_per_column);
-                                                        // Note that this position's 4 amplifying vectors are being sent.
-                                                        // Any necessary additions to be made to the amplifying vectors
-                                                        // due to last_move (represented by current_move here) will be
-                                                        // handled in the constructor.
-                                                        // Also, this position's pre_hash_value_of_position variable is being sent.
-                                                        // It will be updated appropriately in the constructor of the child position node.
-                                                        // Finally, num_pieces_per_column for this position is being sent,
-                                                        // and then necessary change due to last_move will be taken care of in constructor.
-
-        int future_evaluation = pt->evaluation;
+        int future_evaluation = evaluation_seen_from_parent(pt->evaluation); // a forced win in pt is 1 move further from here.
 
         bool is_child_pruned = pt->is_a_pruned_branch; // stores true if pt (this node's child) got pruned from alpha-beta.
                                                        // This is important to know since if this node's final evaluation actually
-                                                       // = child's, it is unstable (and shouldn't be stored in the TT).
+                                                       // = child's, it is unstable (it's only a bound).
+
+        int future_lower_bound = evaluation_seen_from_parent(pt->lower_bound);
+        int future_upper_bound = evaluation_seen_from_parent(pt->upper_bound);
+
+        if (is_comp_turn)
+        {
+            bound_from_worst_case = max(bound_from_worst_case, future_lower_bound);
+            bound_from_best_case = max(bound_from_best_case, future_upper_bound);
+        }
+
+        else
+        {
+            bound_from_worst_case = min(bound_from_worst_case, future_upper_bound);
+            bound_from_best_case = min(bound_from_best_case, future_lower_bound);
+        }
 
         future_positions.push_back(move(pt));
 
         future_positions_size ++;
 
-        // Test if a winning move was found for the comp or user:
+        // Test if a move that wins right away was found for the comp or user. Nothing can be better than that.
+        // (Slower forced wins don't stop the loop, since another move might win faster.)
 
-        if (future_evaluation == INT_MAX && is_comp_turn) // so the comp can make a move that wins...
+        if (future_evaluation == INT_MAX - 1 && is_comp_turn && !(depth == 0 && state->multi_pv_count > 1)) // so the comp can make a move that wins...
         {
-            evaluation = INT_MAX;
+            evaluation = future_evaluation;
+
+            lower_bound = evaluation;
+            upper_bound = evaluation;
 
             add_position_to_transposition_table(true);
 
             return;
         }
 
-        if (future_evaluation == INT_MIN && !is_comp_turn) // so the user can make a move that wins for them...
+        if (future_evaluation == INT_MIN + 1 && !is_comp_turn) // so the user can make a move that wins for them...
         {
-            evaluation = INT_MIN;
+            evaluation = future_evaluation;
+
+            lower_bound = evaluation;
+            upper_bound = evaluation;
 
             add_position_to_transposition_table(true);
 
@@ -2233,6 +3138,14 @@ void position::minimax()
 
                 // So, this branch will be TRIMMED.
 
+                lower_bound = bound_from_worst_case;
+                upper_bound = INT_MAX; // the moves not looked at could be even better.
+
+                add_position_to_transposition_table(false); // the bounds are still useful later (e.g., for MTD(f)).
+
+                state->statistics.beta_cutoffs ++;
+                state->statistics.beta_cutoffs_by_move_index[i] ++;
+
                 evaluation++; // To ensure this branch is not favoured over the previous good branch
                               // with the value of beta (since beta could = evaluation right now). The parent MIN node of this current MAX node will
                               // not choose this node since it can choose a node with at least 1 lower evaluation than this node.
@@ -2243,7 +3156,29 @@ void position::minimax()
             }
 
             // SEE IF ALPHA SHOULD BE RESET (or given a value, if it doesn't have one yet):
-            if (alpha == UNDEFINED || evaluation > alpha)
+            if (depth == 0 && state->multi_pv_count > 1)
+            {
+                // MULTI-PV: alpha is 1 below the multi_pv_count'th best evaluation so far, instead of the best one. So any move that
+                // could still be among the best multi_pv_count (even by tying) gets an exact evaluation, while the rest are still cut
+                // off by alpha.
+
+                vector<int> future_evaluations;
+
+                for (const unique_ptr<position>& pos: future_positions)
+                {
+                    future_evaluations.push_back(evaluation_seen_from_parent(pos->evaluation));
+                }
+
+                if (static_cast<int>(future_evaluations.size()) >= state->multi_pv_count)
+                {
+                    nth_element(future_evaluations.begin(), future_evaluations.begin() + state->multi_pv_count - 1, future_evaluations.end(),
+                                greater<int>());
+
+                    alpha = future_evaluations[state->multi_pv_count - 1] - 1; // a forced loss is INT_MIN + n (n > 0), so this can't overflow.
+                }
+            }
+
+            else if (alpha == UNDEFINED || evaluation > alpha)
             {
                 alpha = evaluation;
             }
@@ -2264,6 +3199,14 @@ void position::minimax()
 
                 // So, this branch will be TRIMMED.
 
+                lower_bound = INT_MIN; // the moves not looked at could be even better for the user.
+                upper_bound = bound_from_worst_case;
+
+                add_position_to_transposition_table(false); // the bounds are still useful later (e.g., for MTD(f)).
+
+                state->statistics.beta_cutoffs ++;
+                state->statistics.beta_cutoffs_by_move_index[i] ++;
+
                 evaluation--; // To ensure this branch is not favoured over the previous good branch
                               // with the value of alpha. The parent MAX node of this current MIN node will
                               // not choose this node since there's another node with at least 1 greater evaluation than this node.
@@ -2281,15 +3224,372 @@ void position::minimax()
         }
     }
 
-    // Now, before adding this position to the transposition table, ensure that it didn't get its evaluation from a pruned child node:
+    // Every move was looked at. If this position got its evaluation from a pruned child node, the bounds won't be equal,
+    // so the TT will only use them as bounds.
+
+    lower_bound = is_comp_turn ? bound_from_worst_case : bound_from_best_case;
+    upper_bound = is_comp_turn ? bound_from_best_case : bound_from_worst_case;
+
+    add_position_to_transposition_table(false); // since at the end of this minimax() function, evaluation has been finalized.
+}
+
+void position::sort_frontier_moves(const bitboard& current_bitboard)
+{
+    vector<uint64_t> move_bits;
+
+    for (const coordinate& current: possible_moves)
+    {
+        move_bits.push_back(1ULL << bitboard::bit_index(current.row, current.col));
+    }
+
+    vector<int> scores;
+
+    batch_evaluator::evaluate_moves(current_bitboard, move_bits, scores);
+
+    vector<int> order(possible_moves.size());
+
+    for (int i = 0; i < static_cast<int>(order.size()); i++)
+    {
+        order[i] = i;
+    }
+
+    stable_sort(order.begin(), order.end(), [&](int first, int second) {return scores[first] > scores[second];});
+
+    vector<coordinate> sorted_moves;
+
+    for (int i: order)
+    {
+        sorted_moves.push_back(possible_moves[i]);
+    }
+
+    possible_moves = sorted_moves;
+}
+
+void position::quiescence_search()
+{
+    // Past depth_limit, only forced play is looked at, so the search can't blow up there. Whoever is to move:
+        // 1) Can win right away: that's the evaluation.
+        // 2) Can't, and the opponent has 2+ squares to win on next move: only one can be blocked, so it's a loss.
+        // 3) Can't, and the opponent has exactly 1 square: blocking it is the only move that doesn't lose right away,
+        //    so it's the only move searched (with minimax(), so the TT and alpha-beta work as usual).
+    // Every other move in 2) and 3) loses at least as fast, so this gives the same evaluation the full search would.
+    // 3) can repeat many times, so after quiescence_ply_limit plies past depth_limit, the static evaluation is used instead.
+
+    state->quiescence_counter ++;
+    state->statistics.quiescence_nodes ++;
+
+    bitboard current(board, is_comp_turn ? 'C' : 'U');
+
+    uint64_t playable_squares = current.possible();
+
+    if (current.winning_squares_of_player_to_move() & playable_squares)
+    {
+        evaluation = is_comp_turn ? INT_MAX - 1 : INT_MIN + 1;
+
+        add_position_to_transposition_table(true);
+
+        return;
+    }
+
+    uint64_t squares_to_block = current.winning_squares_of_opponent() & playable_squares;
+
+    if (bitboard::population_count(squares_to_block) >= 2)
+    {
+        evaluation = is_comp_turn ? INT_MIN + 2 : INT_MAX - 2;
+
+        add_position_to_transposition_table(true);
+
+        return;
+    }
+
+    if (squares_to_block == 0 || -calculation_depth_from_this_position >= state->quiescence_ply_limit)
+    {
+        // Either the critical moves were made impossible (e.g., a square needed is already taken), or the chain of forced
+        // blocks is too long to follow. Either way, settle for the static evaluation.
+
+        if (squares_to_block != 0)
+        {
+            state->quiescence_ply_limit_counter ++;
+        }
+
+        evaluate_at_depth_limit();
+
+        add_position_to_transposition_table(false);
+
+        return;
+    }
+
+    // Put the block at the front of possible_moves, and search only it:
+
+    for (const coordinate& current_move: possible_moves)
+    {
+        if (squares_to_block & (1ULL << bitboard::bit_index(current_move.row, current_move.col)))
+        {
+            rearrange_possible_moves({current_move});
+
+            break;
+        }
+    }
+
+    minimax(true);
+}
+
+void position::find_principal_variation(vector<coordinate>& moves) const
+{
+    // Follow the future position with the best evaluation for whoever's turn it is (the first one, if several are tied):
+
+    const position* best = nullptr;
+
+    for (const unique_ptr<position>& pos: future_positions)
+    {
+        if (best == nullptr || (is_comp_turn && pos->evaluation > best->evaluation) || (!is_comp_turn && pos->evaluation < best->evaluation))
+        {
+            best = pos.get();
+        }
+    }
+
+    if (best != nullptr)
+    {
+        moves.push_back(best->last_move);
+
+        best->find_principal_variation(moves);
+    }
+}
+
+void position::set_evaluation_from_outcome(int outcome)
+{
+    if (outcome == 0)
+    {
+        evaluation = 0;
+    }
+
+    else if ((outcome == 1) == is_comp_turn) // comp to move and winning, or user to move and losing.
+    {
+        evaluation = INT_MAX - unknown_win_distance;
+    }
+
+    else
+    {
+        evaluation = INT_MIN + unknown_win_distance;
+    }
+}
+
+void position::evaluate_at_depth_limit()
+{
+    state->statistics.leaf_nodes ++;
+
+    if (state->settings.evaluator == PATTERN_TABLE_EVALUATION)
+    {
+        evaluation = pattern_table_evaluator::evaluate(board, num_pieces_per_column);
+    }
+
+    else if (state->settings.use_evaluation_cache)
+    {
+        uint64_t key = find_evaluation_cache_key();
+
+        if (!state->smart_evaluation_cache.find(key, evaluation))
+        {
+            smart_evaluation();
+
+            state->smart_evaluation_cache.store(key, evaluation);
+        }
+    }
 
-    if (!got_value_from_pruned_child)
+    else
     {
-        add_position_to_transposition_table(false); // since at the end of this minimax() function, evaluation has been finalized.
+        smart_evaluation();
     }
 }
 
 void position::smart_evaluation()
+{
+    PROFILE_SEARCH_PHASE(PHASE_SMART_EVALUATION);
+
+    // Works out exactly what smart_evaluation_with_board_copies() does, but without copying the board: a square marked 'A' in a
+    // player's copy of the board is a bit in their marks here, and the row barriers are the squares allowed for play.
+    // The values need the marks of both players, so each player's amplifying vectors are gone through twice: once to find
+    // their marks, then again (once all the marks are known) to add up the values, in the same order as before.
+
+    bitboard current_bitboard(board, 'C'); // current_pieces are the comp's pieces.
+
+    uint64_t comp_pieces = current_bitboard.current_pieces;
+    uint64_t user_pieces = current_bitboard.all_pieces ^ comp_pieces;
+    uint64_t empty_squares = bitboard::board_mask & ~current_bitboard.all_pieces;
+    uint64_t allowed_squares = find_squares_allowed_for_play(current_bitboard);
+
+    uint64_t comp_marks = mark_amplifying_squares(squares_amplifying_comp_3, squares_amplifying_comp_2, comp_pieces, empty_squares, allowed_squares,
+                                                  nullptr, true, 0, 0);
+    uint64_t user_marks = mark_amplifying_squares(squares_amplifying_user_3, squares_amplifying_user_2, user_pieces, empty_squares, allowed_squares,
+                                                  nullptr, false, 0, 0);
+
+    double temp_evaluation_as_double = 0.0;
+
+    mark_amplifying_squares(squares_amplifying_comp_3, squares_amplifying_comp_2, comp_pieces, empty_squares, allowed_squares,
+                            &temp_evaluation_as_double, true, comp_marks, user_marks);
+    mark_amplifying_squares(squares_amplifying_user_3, squares_amplifying_user_2, user_pieces, empty_squares, allowed_squares,
+                            &temp_evaluation_as_double, false, user_marks, comp_marks);
+
+    evaluation = round(temp_evaluation_as_double);
+
+    if (state->check_smart_evaluation)
+    {
+        int bitmask_evaluation = evaluation;
+
+        smart_evaluation_with_board_copies();
+
+        state->smart_evaluation_check_counter ++;
+
+        if (evaluation != bitmask_evaluation)
+        {
+            throw runtime_error("smart_evaluation() gave " + to_string(bitmask_evaluation) + ", but smart_evaluation_with_board_copies() gave " +
+                                to_string(evaluation) + "\n");
+        }
+    }
+}
+
+uint64_t position::mark_amplifying_squares(const vector<treasure_spot>& squares_amplifying_3, const vector<treasure_spot>& squares_amplifying_2,
+                                           uint64_t own_pieces, uint64_t empty_squares, uint64_t allowed_squares,
+                                           double* evaluation_as_double, bool is_comp, uint64_t own_final_marks, uint64_t opponent_final_marks) const
+{
+    const int big_amount = state->settings.parameters.big_amount;
+    const int small_amount = state->settings.parameters.small_amount;
+    const int stacked_threat_coefficient = state->settings.parameters.stacked_threat_coefficient;
+
+    uint64_t marks = 0; // the squares marked with 'A' so far.
+
+    auto square_bit = [](const coordinate& square)
+    {
+        return 1ULL << bitboard::bit_index(square.row, square.col);
+    };
+
+    auto is_open = [&](uint64_t bit) // the same as a ' ' in the copy of the board, in a square allowed for play.
+    {
+        return (bit & empty_squares & allowed_squares & ~marks) != 0;
+    };
+
+    auto is_stacked = [&](uint64_t bit) // whether the square above or below is marked (the sentinel bits above each column never are).
+    {
+        return (marks & ((bit << 1) | (bit >> 1))) != 0;
+    };
+
+    auto add_value = [&](const coordinate& square, uint64_t bit, int value)
+    {
+        if (evaluation_as_double == nullptr)
+        {
+            return;
+        }
+
+        double weighted_value = value;
+
+        if (square.row + 1 <= max_row_index && (opponent_final_marks & (bit >> 1)) != 0)
+        {
+            weighted_value = static_cast<double>(value) * state->settings.parameters.threat_below_opponent_threat_coefficient;
+        }
+
+        else if (square.row + 2 <= max_row_index && (own_final_marks & (bit >> 2)) != 0)
+        {
+            weighted_value = static_cast<double>(value) * state->settings.parameters.threat_above_own_threat_coefficient;
+        }
+
+        if (is_comp)
+        {
+            *evaluation_as_double += weighted_value;
+        }
+
+        else
+        {
+            *evaluation_as_double -= weighted_value;
+        }
+    };
+
+    for (const treasure_spot& space: squares_amplifying_3) // running through squares completing a 3-in-a-row.
+    {
+        const coordinate& current_square = space.current_square;
+
+        uint64_t current_bit = square_bit(current_square);
+
+        if (is_open(current_bit))
+        {
+            int value = big_amount * (current_square.row + 1 + num_pieces_per_column[current_square.col]);
+
+            if (is_stacked(current_bit))
+            {
+                value *= stacked_threat_coefficient;
+            }
+
+            marks |= current_bit;
+
+            add_value(current_square, current_bit, value);
+        }
+    }
+
+    for (const treasure_spot& space: squares_amplifying_2) // running through spaces completing a 2-in-a-row.
+    {
+        const coordinate& current_square = space.current_square;
+
+        uint64_t current_bit = square_bit(current_square);
+
+        if (!is_open(current_bit))
+        {
+            continue;
+        }
+
+        uint64_t next_bits = (is_in_bounds(space.next_square) ? square_bit(space.next_square) : 0) |
+                             (is_in_bounds(space.other_next_square) ? square_bit(space.other_next_square) : 0);
+
+        if ((next_bits & own_pieces) != 0) // filling current_square makes a 4-in-a-row.
+        {
+            int value = big_amount * (current_square.row + 1 + num_pieces_per_column[current_square.col]);
+
+            if (is_stacked(current_bit))
+            {
+                value *= stacked_threat_coefficient;
+            }
+
+            marks |= current_bit;
+
+            add_value(current_square, current_bit, value);
+        }
+
+        else if (is_open(next_bits)) // only a 3-in-a-row, but one that can still become a 4-in-a-row (not marked).
+        {
+            add_value(current_square, current_bit, small_amount * (current_square.row + 1 + num_pieces_per_column[current_square.col]));
+        }
+    }
+
+    return marks;
+}
+
+uint64_t position::find_squares_allowed_for_play(const bitboard& current_bitboard)
+{
+    PROFILE_SEARCH_PHASE(PHASE_INITIALIZE_ROW_BARRIERS);
+
+    // Like initialize_row_barriers(): no square above (visually) the lowest square that gives both comp AND user a 4-in-a-row.
+
+    uint64_t comp_pieces = current_bitboard.current_pieces;
+    uint64_t user_pieces = current_bitboard.all_pieces ^ comp_pieces;
+
+    uint64_t barricade_squares = bitboard::compute_winning_squares(comp_pieces, current_bitboard.all_pieces) &
+                                 bitboard::compute_winning_squares(user_pieces, current_bitboard.all_pieces);
+
+    uint64_t allowed_squares = bitboard::board_mask;
+
+    for (int col = 0; col <= max_col_index; col++)
+    {
+        uint64_t barricades_in_column = barricade_squares & bitboard::column_mask(col);
+
+        if (barricades_in_column != 0)
+        {
+            uint64_t lowest_barricade = barricades_in_column & -barricades_in_column;
+
+            allowed_squares &= ~bitboard::column_mask(col) | ((lowest_barricade << 1) - 1);
+        }
+    }
+
+    return allowed_squares;
+}
+
+void position::smart_evaluation_with_board_copies()
 {
     initialize_row_barriers(); // implements finished column algorithm, by finding the squares in each
                                // column that is as far as play can possibly go (due to a square allowing comp AND user to win).
@@ -2320,12 +3620,12 @@ void position::smart_evaluation()
     {
         if (current.square.row + 1 <= max_row_index && copy_board_for_user[current.square.row + 1][current.square.col] == 'A')
         {
-            temp_evaluation_as_double += (static_cast<double>(current.value) * 0.25);
+            temp_evaluation_as_double += (static_cast<double>(current.value) * state->settings.parameters.threat_below_opponent_threat_coefficient);
         }
 
         else if (current.square.row + 2 <= max_row_index && copy_board_for_comp[current.square.row + 2][current.square.col] == 'A')
         {
-            temp_evaluation_as_double += (static_cast<double>(current.value) * 0.75);
+            temp_evaluation_as_double += (static_cast<double>(current.value) * state->settings.parameters.threat_above_own_threat_coefficient);
         }
 
         else
@@ -2338,12 +3638,12 @@ void position::smart_evaluation()
     {
         if (current.square.row + 1 <= max_row_index && copy_board_for_comp[current.square.row + 1][current.square.col] == 'A')
         {
-            temp_evaluation_as_double -= (static_cast<double>(current.value) * 0.25);
+            temp_evaluation_as_double -= (static_cast<double>(current.value) * state->settings.parameters.threat_below_opponent_threat_coefficient);
         }
 
         else if (current.square.row + 2 <= max_row_index && copy_board_for_user[current.square.row + 2][current.square.col] == 'A')
         {
-            temp_evaluation_as_double -= (static_cast<double>(current.value) * 0.75);
+            temp_evaluation_as_double -= (static_cast<double>(current.value) * state->settings.parameters.threat_above_own_threat_coefficient);
         }
 
         else
@@ -2355,6 +3655,43 @@ void position::smart_evaluation()
     evaluation = round(temp_evaluation_as_double);
 }
 
+uint64_t position::find_evaluation_cache_key() const
+{
+    // smart_evaluation() reads the board and the 4 amplifying vectors (everything else it uses is worked out from the board).
+    // The amplifying vectors depend on the moves that reached the board, and their order matters too (it decides which
+    // squares count as stacked threats, and a 2-in-a-row can be in squares_amplifying_2 more than once). So the key is
+    // the board's bitboard key (with the comp's pieces as the "current" pieces, so it's the same whoever's turn it is),
+    // mixed with an FNV-1a hash of every coordinate in the 4 vectors, in order.
+
+    uint64_t amplifying_hash = 0xCBF29CE484222325ULL;
+
+    auto add_to_hash = [&](int value)
+    {
+        amplifying_hash ^= static_cast<uint32_t>(value);
+        amplifying_hash *= 0x100000001B3ULL;
+    };
+
+    for (const vector<treasure_spot>* current_vector: {&squares_amplifying_comp_2, &squares_amplifying_comp_3,
+                                                       &squares_amplifying_user_2, &squares_amplifying_user_3})
+    {
+        add_to_hash(static_cast<int>(current_vector->size())); // so the same spots split differently between the vectors give a different hash.
+
+        for (const treasure_spot& current: *current_vector)
+        {
+            add_to_hash(current.current_square.row);
+            add_to_hash(current.current_square.col);
+            add_to_hash(current.next_square.row);
+            add_to_hash(current.next_square.col);
+            add_to_hash(current.other_next_square.row);
+            add_to_hash(current.other_next_square.col);
+        }
+    }
+
+    uint64_t key = bitboard(board, 'C').key() ^ (amplifying_hash * 0x9E3779B97F4A7C15ULL);
+
+    return (key == 0) ? 1 : key; // 0 is the cache's empty slot key.
+}
+
 void position::find_individual_player_evaluation(const vector<treasure_spot>& squares_amplifying_3,
                                                 const vector<treasure_spot>& squares_amplifying_2, char piece,
                                                 vector<vector<char>>& copy_board, vector<coordinate_and_value>& recorder) const
@@ -2364,11 +3701,10 @@ void position::find_individual_player_evaluation(const vector<treasure_spot>& sq
 
     // Use row_barriers private member vector when seeing if an amplifying square should be counted.
 
-    const int big_amount = 10; // how many points to add if there is an amplifying square completes a 3-in-a-row.
-    const int small_amount = 3; // NOTE: if you change this to a double, recorder (and its parent in prev. function) should store coordinate and DOUBLE.
-                                // and calculations done in this function should be in doubles, not ints whatsoever. how many points to add if an amplifying square completes a 2-in-a-row.
-    const int stacked_threat_coefficient = 5; // What to multiply the normal value of a square that let's a 3-in-a-row be
-                                              // completed into a 4-in-a-row, if there's a similar square above/below it.
+    const int big_amount = state->settings.parameters.big_amount; // how many points to add if there is an amplifying square completes a 3-in-a-row.
+    const int small_amount = state->settings.parameters.small_amount; // how many points to add if an amplifying square completes a 2-in-a-row.
+    const int stacked_threat_coefficient = state->settings.parameters.stacked_threat_coefficient;
+    // What to multiply the normal value of a square that let's a 3-in-a-row be completed into a 4-in-a-row, if there's a similar square above/below it.
 
     for (const treasure_spot& space: squares_amplifying_3) // running through squares completing a 3-in-a-row.
     {
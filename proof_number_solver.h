@@ -0,0 +1,428 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+#include "bitboard.h"
+
+using namespace std;
+
+struct proof_number_solver_result // What the proof-number solver returns for a "can the player to move win quickly?" query.
+{
+    int number_of_moves; // how many moves (counting both players) the fastest forced win takes, including the winning move itself.
+                         // -1 if there's no forced win within the limit.
+    int best_column; // the first move of that win. -1 if there's no forced win within the limit.
+};
+
+struct proof_number_solver_TT_entry // One slot of the proof-number solver's table.
+{
+    uint64_t key; // bitboard key of the position stored in this slot (0 if the slot is empty).
+    bool is_or_node; // true if the attacker (the player trying to win) is the one to move in the position.
+    int proven_depth; // the attacker is known to win within this many moves (INT_MAX if no proof is known)...
+    int disproven_depth; // ...and known NOT to be able to win within this many moves (-1 if no disproof is known).
+    int depth; // the number of moves the attacker had left to win in when the unfinished numbers below were stored.
+    uint32_t proof_number; // minimum number of leaves that still need to be proven for the attacker to win within depth moves...
+    uint32_t disproof_number; // ...and the minimum number that need to be disproven to show it can't be done.
+};
+
+class proof_number_solver // Depth-bounded df-pn (depth-first proof-number search), for finding the quickest forced win.
+{
+public:
+    // A node is an OR node when the attacker is to move (the attacker needs just ONE move that wins), and an AND node when the
+    // defender is to move (the attacker has to win against EVERY defender move). A proof_number of 0 means proven (attacker wins),
+    // a disproof_number of 0 means disproven.
+    // Results depend on how many moves the attacker has left, so depth is part of what's stored. A proof within depth moves
+    // also holds for any larger depth, and a disproof within depth moves also holds for any smaller depth. This lets
+    // proofs be shared between queries for different depths and different root moves, so the table is kept between calls.
+
+    // Constructors:
+
+    proof_number_solver(int TT_size_log_2P = default_TT_size_log_2); // the table gets 2 to the power of TT_size_log_2P slots.
+
+    // Helpers:
+    proof_number_solver_result find_quickest_win(const bitboard& current, int max_number_of_moves);
+    // Finds the fastest forced win for the player to move in current that takes at most max_number_of_moves
+    // (counting both players, including the winning move). Nobody may have won already in current.
+    // The first call allocates the table.
+
+    long long get_number_of_nodes() const; // how many nodes the solver has expanded (over all calls, PURELY FOR TESTING!).
+
+    // Public static variables:
+    static const int default_TT_size_log_2;
+    static const uint32_t infinity; // proof/disproof number of a node that is disproven/proven.
+
+private:
+    // Private variables:
+    vector<proof_number_solver_TT_entry> transposition_table; // direct-mapped, like the endgame solver's.
+    int TT_size_log_2;
+    long long number_of_nodes;
+
+    // Private methods:
+    void multiple_iterative_deepening(const bitboard& current, bool is_or_node, int depth,
+                                      uint32_t proof_number_threshold, uint32_t disproof_number_threshold);
+    // Searches current until its proof number reaches proof_number_threshold or its disproof number reaches
+    // disproof_number_threshold (one of them is 0 once the node is solved). Stores the result in the table.
+
+    bool is_terminal(const bitboard& current, bool is_or_node, int depth, uint64_t& moves, uint32_t& proof_number,
+                     uint32_t& disproof_number) const;
+    // Returns true (and sets the numbers) if current is solved without looking at children.
+    // Otherwise returns false, and sets moves to the children worth searching.
+
+    void look_up(const bitboard& current, bool is_or_node, int depth, uint32_t& proof_number, uint32_t& disproof_number) const;
+    void store_in_TT(const bitboard& current, bool is_or_node, int depth, uint32_t proof_number, uint32_t disproof_number);
+    size_t find_index_in_TT(uint64_t key, bool is_or_node) const;
+
+    // Private static methods:
+    static uint32_t add_capped(uint32_t a, uint32_t b); // a + b, but never more than infinity.
+};
+
+// Initializing the static variables:
+
+const int proof_number_solver::default_TT_size_log_2 = 20;
+const uint32_t proof_number_solver::infinity = 100000000;
+
+// CONSTRUCTORS:
+
+proof_number_solver::proof_number_solver(int TT_size_log_2P)
+{
+    TT_size_log_2 = TT_size_log_2P;
+
+    // transposition_table is left empty until the first call to find_quickest_win(), so an engine that never has to prove a
+    // win doesn't pay for it.
+
+    number_of_nodes = 0;
+}
+
+// HELPERS:
+
+proof_number_solver_result proof_number_solver::find_quickest_win(const bitboard& current, int max_number_of_moves)
+{
+    proof_number_solver_result result;
+    result.number_of_moves = -1;
+    result.best_column = -1;
+
+    if (max_number_of_moves < 1)
+    {
+        return result;
+    }
+
+    if (transposition_table.empty())
+    {
+        transposition_table.resize(size_t(1) << TT_size_log_2, {0, false, INT_MAX, -1, 0, 1, 1});
+    }
+
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        if (current.can_play(col) && current.is_winning_move(col))
+        {
+            result.number_of_moves = 1;
+            result.best_column = col;
+
+            return result;
+        }
+    }
+
+    // No immediate win. The attacker's wins take an odd number of moves (attacker, defender, ..., attacker), so try
+    // each possible length from shortest to longest. Each search reuses the proofs and disproofs of the ones before it.
+
+    for (int depth = 3; depth <= max_number_of_moves; depth += 2)
+    {
+        multiple_iterative_deepening(current, true, depth, infinity, infinity);
+
+        uint32_t proof_number, disproof_number;
+
+        look_up(current, true, depth, proof_number, disproof_number);
+
+        if (proof_number != 0)
+        {
+            continue;
+        }
+
+        // Proven. Now find the move that does it (again, almost always answered straight from the table):
+
+        uint64_t moves = current.possible_non_losing_moves();
+
+        for (int col = 0; col < bitboard::width; col++)
+        {
+            uint64_t move_bit = moves & bitboard::column_mask(col);
+
+            if (!move_bit)
+            {
+                continue;
+            }
+
+            bitboard child = current;
+            child.play_move_bit(move_bit);
+
+            multiple_iterative_deepening(child, false, depth - 1, infinity, infinity);
+
+            look_up(child, false, depth - 1, proof_number, disproof_number);
+
+            if (proof_number == 0)
+            {
+                result.number_of_moves = depth;
+                result.best_column = col;
+
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+long long proof_number_solver::get_number_of_nodes() const
+{
+    return number_of_nodes;
+}
+
+// PRIVATE METHODS:
+
+void proof_number_solver::multiple_iterative_deepening(const bitboard& current, bool is_or_node, int depth,
+                                                       uint32_t proof_number_threshold, uint32_t disproof_number_threshold)
+{
+    uint32_t proof_number, disproof_number;
+
+    look_up(current, is_or_node, depth, proof_number, disproof_number);
+
+    if (proof_number == 0 || disproof_number == 0 ||
+        proof_number >= proof_number_threshold || disproof_number >= disproof_number_threshold)
+    {
+        return;
+    }
+
+    uint64_t moves = 0;
+
+    if (is_terminal(current, is_or_node, depth, moves, proof_number, disproof_number))
+    {
+        store_in_TT(current, is_or_node, depth, proof_number, disproof_number);
+
+        return;
+    }
+
+    number_of_nodes ++;
+
+    vector<bitboard> children;
+
+    for (int col: {3, 2, 4, 1, 5, 0, 6}) // center first, as in the endgame solver.
+    {
+        uint64_t move_bit = moves & bitboard::column_mask(col);
+
+        if (move_bit)
+        {
+            children.push_back(current);
+            children.back().play_move_bit(move_bit);
+        }
+    }
+
+    while (true)
+    {
+        // Work out the node's proof and disproof numbers from its children's, and find the most promising child
+        // (the one with the smallest proof number at an OR node, or smallest disproof number at an AND node):
+
+        proof_number = is_or_node ? infinity : 0;
+        disproof_number = is_or_node ? 0 : infinity;
+
+        int best_child_index = -1;
+        uint32_t best_child_number = infinity + 1;
+        uint32_t second_best_child_number = infinity;
+        uint32_t best_child_proof_number = 0, best_child_disproof_number = 0;
+
+        for (int i = 0; i < static_cast<int>(children.size()); i++)
+        {
+            uint32_t child_proof_number, child_disproof_number;
+
+            look_up(children[i], !is_or_node, depth - 1, child_proof_number, child_disproof_number);
+
+            uint32_t child_number = is_or_node ? child_proof_number : child_disproof_number;
+
+            if (is_or_node)
+            {
+                proof_number = min(proof_number, child_proof_number);
+                disproof_number = add_capped(disproof_number, child_disproof_number);
+            }
+
+            else
+            {
+                proof_number = add_capped(proof_number, child_proof_number);
+                disproof_number = min(disproof_number, child_disproof_number);
+            }
+
+            if (child_number < best_child_number)
+            {
+                second_best_child_number = best_child_number;
+                best_child_number = child_number;
+                best_child_index = i;
+                best_child_proof_number = child_proof_number;
+                best_child_disproof_number = child_disproof_number;
+            }
+
+            else if (child_number < second_best_child_number)
+            {
+                second_best_child_number = child_number;
+            }
+        }
+
+        if (proof_number >= proof_number_threshold || disproof_number >= disproof_number_threshold)
+        {
+            break; // also catches a solved node, as one of its numbers is then 0 and the other is infinity.
+        }
+
+        // Search the best child until it's no longer the best (its number passes the second best child's), or until this
+        // node's own thresholds would be reached:
+
+        uint32_t child_proof_number_threshold, child_disproof_number_threshold;
+
+        if (is_or_node)
+        {
+            child_proof_number_threshold = min(proof_number_threshold, add_capped(second_best_child_number, 1));
+            child_disproof_number_threshold = add_capped(disproof_number_threshold - disproof_number, best_child_disproof_number);
+        }
+
+        else
+        {
+            child_proof_number_threshold = add_capped(proof_number_threshold - proof_number, best_child_proof_number);
+            child_disproof_number_threshold = min(disproof_number_threshold, add_capped(second_best_child_number, 1));
+        }
+
+        multiple_iterative_deepening(children[best_child_index], !is_or_node, depth - 1,
+                                     child_proof_number_threshold, child_disproof_number_threshold);
+    }
+
+    store_in_TT(current, is_or_node, depth, proof_number, disproof_number);
+}
+
+bool proof_number_solver::is_terminal(const bitboard& current, bool is_or_node, int depth, uint64_t& moves,
+                                      uint32_t& proof_number, uint32_t& disproof_number) const
+{
+    // depth is the number of moves the attacker has left to win in, counting the move about to be made in current.
+
+    proof_number = 0;
+    disproof_number = infinity;
+
+    if (is_or_node)
+    {
+        if (depth >= 1 && current.can_win_next())
+        {
+            return true; // proven.
+        }
+
+        moves = current.possible_non_losing_moves(); // 0 if the board is full, or if every attacker move lets the defender win.
+
+        if (depth < 3 || moves == 0)
+        {
+            swap(proof_number, disproof_number); // disproven.
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if (current.can_win_next()) // the defender wins.
+    {
+        swap(proof_number, disproof_number);
+
+        return true;
+    }
+
+    moves = current.possible_non_losing_moves();
+
+    if (moves == 0)
+    {
+        if (current.number_of_moves == bitboard::width * bitboard::height || depth < 2) // draw, or no time left to win.
+        {
+            swap(proof_number, disproof_number);
+        }
+
+        return true; // otherwise, the attacker wins on the next move whatever the defender does.
+    }
+
+    if (depth < 4) // after any defender move, the attacker would have to win immediately, which is only possible if moves was 0.
+    {
+        swap(proof_number, disproof_number);
+
+        return true;
+    }
+
+    return false;
+}
+
+void proof_number_solver::look_up(const bitboard& current, bool is_or_node, int depth, uint32_t& proof_number,
+                                  uint32_t& disproof_number) const
+{
+    uint64_t key = current.key();
+
+    const proof_number_solver_TT_entry& entry = transposition_table[find_index_in_TT(key, is_or_node)];
+
+    proof_number = 1;
+    disproof_number = 1;
+
+    if (entry.key != key || entry.is_or_node != is_or_node)
+    {
+        return;
+    }
+
+    if (entry.proven_depth <= depth)
+    {
+        proof_number = 0;
+        disproof_number = infinity;
+    }
+
+    else if (entry.disproven_depth >= depth)
+    {
+        proof_number = infinity;
+        disproof_number = 0;
+    }
+
+    else if (entry.depth == depth)
+    {
+        proof_number = entry.proof_number;
+        disproof_number = entry.disproof_number;
+    }
+}
+
+void proof_number_solver::store_in_TT(const bitboard& current, bool is_or_node, int depth, uint32_t proof_number,
+                                      uint32_t disproof_number)
+{
+    uint64_t key = current.key();
+
+    proof_number_solver_TT_entry& entry = transposition_table[find_index_in_TT(key, is_or_node)];
+
+    if (entry.key != key || entry.is_or_node != is_or_node) // slot held another node, so replace it.
+    {
+        entry = {key, is_or_node, INT_MAX, -1, 0, 1, 1};
+    }
+
+    if (proof_number == 0)
+    {
+        entry.proven_depth = min(entry.proven_depth, depth);
+    }
+
+    else if (disproof_number == 0)
+    {
+        entry.disproven_depth = max(entry.disproven_depth, depth);
+    }
+
+    else
+    {
+        entry.depth = depth;
+        entry.proof_number = proof_number;
+        entry.disproof_number = disproof_number;
+    }
+}
+
+size_t proof_number_solver::find_index_in_TT(uint64_t key, bool is_or_node) const
+{
+    // Fibonacci hashing: the key's low bits only describe the first few columns, so they can't be used as the index directly.
+
+    return ((key * 2 + (is_or_node ? 1 : 0)) * 0x9E3779B97F4A7C15ULL) >> (64 - TT_size_log_2);
+}
+
+// PRIVATE STATIC METHODS:
+
+uint32_t proof_number_solver::add_capped(uint32_t a, uint32_t b)
+{
+    return min(infinity, a + b);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+// Timers and counters for the expensive phases of a search, for finding where the time goes without an external profiler.
+
+// They're only compiled in with SEARCH_PROFILER defined (e.g., -DSEARCH_PROFILER). Otherwise PROFILE_SEARCH_PHASE() is
+// nothing, so the search runs exactly as fast as before.
+
+// A phase's time is exclusive: while a phase inside it runs (e.g., add_position_to_transposition_table() inside
+// analyze_last_move()), its own clock is paused. The rest of analyze_last_move() (and so minimax(), quiescence_search(), etc.)
+// is the "other search" phase, so child allocation only counts creating a child up to the point its own search starts.
+// think_on_game_position() resets the profile, so it's always for the last search on the thread.
+
+enum search_phase
+{
+    PHASE_TT_PROBE, // the TT lookup at the start of analyze_last_move().
+    PHASE_ANALYZE_HORIZONTAL,
+    PHASE_ANALYZE_VERTICAL,
+    PHASE_ANALYZE_POSITIVE_SLOPE_DIAGONAL,
+    PHASE_ANALYZE_NEGATIVE_SLOPE_DIAGONAL,
+    PHASE_FIND_CRITICAL_MOVES,
+    PHASE_REARRANGE_POSSIBLE_MOVES,
+    PHASE_SMART_EVALUATION, // not counting initialize_row_barriers(), which is its own phase.
+    PHASE_INITIALIZE_ROW_BARRIERS,
+    PHASE_ADD_TO_TT,
+    PHASE_CHILD_ALLOCATION, // minimax() creating a future position (copying the board and vectors), up to its analyze_last_move().
+    PHASE_OTHER_SEARCH, // everything else analyze_last_move() does (or calls).
+    NUMBER_OF_SEARCH_PHASES
+};
+
+struct search_profile
+{
+    long long calls[NUMBER_OF_SEARCH_PHASES];
+    long long nanoseconds[NUMBER_OF_SEARCH_PHASES];
+};
+
+class search_phase_timer // Times one phase, from its construction until it goes out of scope.
+{
+public:
+    // Constructors:
+
+    search_phase_timer(search_phase phaseP);
+
+    ~search_phase_timer();
+
+    // Public static variables:
+    static thread_local search_profile profile;
+
+    // Public static methods:
+    static void print_profile(ostream& output, const search_profile& profile_to_print, const string& line_prefix);
+    // A line per phase (starting with line_prefix): its calls, total time, share of all the phases' time, and time per call.
+
+private:
+    // Private variables:
+    search_phase phase;
+    steady_clock::time_point start_time; // when the clock (re)started.
+    long long nanoseconds; // counted before the clock was last paused.
+    search_phase_timer* enclosing_timer; // the timer paused while this one runs (nullptr if none).
+
+    // Private static variables:
+    static thread_local search_phase_timer* innermost_timer;
+    static const char* const phase_names[NUMBER_OF_SEARCH_PHASES];
+};
+
+#ifdef SEARCH_PROFILER
+#define PROFILE_SEARCH_PHASE(phase) search_phase_timer current_phase_timer(phase)
+#else
+#define PROFILE_SEARCH_PHASE(phase)
+#endif
+
+// Initializing the static variables:
+
+thread_local search_profile search_phase_timer::profile = {};
+
+thread_local search_phase_timer* search_phase_timer::innermost_timer = nullptr;
+
+const char* const search_phase_timer::phase_names[NUMBER_OF_SEARCH_PHASES] =
+{
+    "TT probe", "analyze horizontal", "analyze vertical", "analyze positive diagonal", "analyze negative diagonal",
+    "find_critical_moves", "rearrange_possible_moves", "smart_evaluation", "initialize_row_barriers", "add to TT",
+    "child allocation", "other search"
+};
+
+// CONSTRUCTORS:
+
+search_phase_timer::search_phase_timer(search_phase phaseP)
+{
+    phase = phaseP;
+
+    start_time = steady_clock::now();
+
+    nanoseconds = 0;
+
+    enclosing_timer = innermost_timer;
+
+    if (enclosing_timer)
+    {
+        enclosing_timer->nanoseconds += duration_cast<std::chrono::nanoseconds>(start_time - enclosing_timer->start_time).count();
+    }
+
+    innermost_timer = this;
+}
+
+search_phase_timer::~search_phase_timer()
+{
+    steady_clock::time_point end_time = steady_clock::now();
+
+    profile.calls[phase] ++;
+
+    profile.nanoseconds[phase] += nanoseconds + duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    innermost_timer = enclosing_timer;
+
+    if (enclosing_timer)
+    {
+        enclosing_timer->start_time = end_time;
+    }
+}
+
+// PUBLIC STATIC METHODS:
+
+void search_phase_timer::print_profile(ostream& output, const search_profile& profile_to_print, const string& line_prefix)
+{
+    long long total_nanoseconds = 0;
+
+    for (int p = 0; p < NUMBER_OF_SEARCH_PHASES; p++)
+    {
+        total_nanoseconds += profile_to_print.nanoseconds[p];
+    }
+
+    for (int p = 0; p < NUMBER_OF_SEARCH_PHASES; p++)
+    {
+        output << line_prefix << left << setw(27) << phase_names[p] << right << setw(12) << profile_to_print.calls[p] << " calls"
+               << fixed << setprecision(3) << setw(11) << profile_to_print.nanoseconds[p] / 1e6 << " ms"
+               << setprecision(1) << setw(7) << 100.0 * profile_to_print.nanoseconds[p] / max(total_nanoseconds, 1LL) << "%"
+               << setw(9) << static_cast<double>(profile_to_print.nanoseconds[p]) / max(profile_to_print.calls[p], 1LL) << " ns/call\n";
+    }
+
+    output.unsetf(ios::floatfield);
+
+    output << setprecision(6);
+}
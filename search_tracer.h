@@ -0,0 +1,406 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+// Records the nodes of searches to a file, for looking at how the pruning actually went (see engine_state::tracer in position.h).
+
+// Each node visit (every call of analyze_last_move()) becomes a fixed-size trace_record once the node is done: its ply, the move
+// reaching it, alpha and beta before and after, its evaluation, why its search stopped, and what the TT had for it. The records
+// go into blocks in memory, and full blocks are written to the file by the tracer's own thread, so the search never waits for
+// the disk. The file is the header below followed by the records, in the order the nodes finished (children before their parent).
+
+// Sampling: every node less than sample_ply plies deep is recorded, but at sample_ply only 1 in every sample_rate subtrees is
+// (the whole subtree). So the records always form whole subtrees, and with a big enough sample_rate the tracer can be left on
+// for real searches. A sample_rate of 1 records everything.
+
+// The file can be converted to Chrome's trace format (open it at chrome://tracing or in Perfetto: each node is a slice
+// nested in its parent's), or to an indented tree of text. The file uses the machine's byte order.
+
+enum trace_stop_reason : uint8_t // Why a node's search ended where it did.
+{
+    TRACE_SEARCHED, // minimax() looked at every move (or found a move that wins right away).
+    TRACE_ALPHA_BETA_CUTOFF, // minimax() pruned it (its evaluation got nudged by 1, with is_a_pruned_branch).
+    TRACE_TT_CUTOFF, // the TT had an exact evaluation, or bounds that prune it.
+    TRACE_WIN, // the last move made a 4-in-a-row.
+    TRACE_DRAW, // the board is full.
+    TRACE_ENDGAME_DATABASE,
+    TRACE_THREAT_PARITY, // threat_parity_analyzer proved the outcome.
+    TRACE_LEAF, // evaluated at depth_limit.
+    TRACE_QUIESCENCE // handled by quiescence_search().
+};
+
+enum trace_TT_hit : uint8_t // What analyze_last_move() found in the TT for a node.
+{
+    TRACE_TT_MISS,
+    TRACE_TT_EXACT, // an exact (or indisputable) evaluation.
+    TRACE_TT_LOWER_BOUND, // a lower bound >= beta (fail high).
+    TRACE_TT_UPPER_BOUND, // an upper bound <= alpha (fail low).
+    TRACE_TT_MOVE_ORDER // nothing that settles it, but the move order of an earlier search.
+};
+
+struct trace_record
+{
+    uint64_t start_nanoseconds; // since the tracer was made.
+    uint64_t duration_nanoseconds;
+    uint32_t node_id; // 1, 2, 3, ... in the order the nodes were entered.
+    uint32_t parent_id; // 0 for a root (or a node whose parent isn't recorded).
+    int32_t alpha_in; // no_bound if there isn't one.
+    int32_t beta_in;
+    int32_t alpha_out;
+    int32_t beta_out;
+    int32_t score; // the evaluation, from the comp's perspective.
+    int8_t ply; // the position's depth (0 for the root).
+    int8_t depth_limit;
+    int8_t move_col; // the column of the move that reached the position (-1 if none).
+    uint8_t stop_reason; // a trace_stop_reason.
+    uint8_t TT_hit; // a trace_TT_hit.
+    uint8_t flags; // the bits below.
+    uint8_t moves_searched; // future positions made.
+    uint8_t number_of_moves; // possible moves.
+
+    static const int32_t no_bound = INT_MAX; // for position::UNDEFINED (alpha and beta are never INT_MAX).
+    static const uint8_t is_comp_turn_flag = 1;
+    static const uint8_t got_value_from_pruned_child_flag = 2;
+};
+
+class search_tracer
+{
+public:
+    // Constructors:
+
+    search_tracer(const string& file_name, int sample_rateP, int sample_plyP); // throws runtime_error if the file can't be opened.
+
+    ~search_tracer(); // writes the rest of the records, and waits for the file to be written.
+
+    // Helpers (for position::trace_scope, from the searching thread):
+    bool enter_node(int ply, trace_record& record, bool& was_sampling_subtree);
+    // Returns true if the node is to be recorded, and then fills in record's ids and start time, and makes it the current parent.
+    // was_sampling_subtree is for exit_node().
+
+    void exit_node(trace_record& record, bool was_sampling_subtree); // fills in the record's times, and adds it.
+
+    // Getters:
+    long long get_number_of_records() const;
+
+    // Public static variables:
+    static const char file_magic[8];
+    static const int records_per_block;
+
+    // Public static methods:
+    static void read_records(const string& file_name, vector<trace_record>& records); // throws runtime_error for a bad file.
+    static void write_chrome_trace(const vector<trace_record>& records, ostream& output);
+    static void write_tree(const vector<trace_record>& records, ostream& output);
+
+private:
+    // Private variables (used by the searching thread):
+    int sample_rate;
+    int sample_ply;
+    steady_clock::time_point creation_time;
+    uint32_t next_node_id;
+    uint32_t current_node_id; // the innermost node being recorded (0 if none).
+    bool is_sampling_subtree; // true while inside a subtree (at sample_ply) that is being recorded.
+    long long number_of_subtrees_seen; // at sample_ply.
+    long long number_of_records;
+    vector<trace_record> current_block;
+
+    // Private variables (shared with the writer thread):
+    mutex blocks_mutex; // guards the 2 variables below.
+    deque<vector<trace_record>> full_blocks;
+    bool is_done;
+    condition_variable blocks_changed;
+    ofstream fout;
+    thread writer;
+
+    // Private methods:
+    void run_writer();
+    void send_current_block();
+
+    // Private static methods:
+    static const char* get_stop_reason_name(int stop_reason);
+    static const char* get_TT_hit_name(int TT_hit);
+    static string format_bound(int32_t bound); // "-" for no_bound.
+};
+
+// Initializing the static variables:
+
+const char search_tracer::file_magic[8] = {'C', '4', 'T', 'R', 'A', 'C', 'E', '1'};
+
+const int search_tracer::records_per_block = 1 << 14; // 896 KB.
+
+// CONSTRUCTORS:
+
+search_tracer::search_tracer(const string& file_name, int sample_rateP, int sample_plyP) : fout(file_name, ios::binary)
+{
+    if (fout.fail())
+    {
+        throw runtime_error("Couldn't open " + file_name + " in search_tracer's constructor\n");
+    }
+
+    const uint32_t record_size = sizeof(trace_record);
+
+    fout.write(file_magic, sizeof(file_magic));
+    fout.write(reinterpret_cast<const char*>(&record_size), sizeof(record_size));
+
+    sample_rate = max(1, sample_rateP);
+    sample_ply = max(0, sample_plyP);
+
+    creation_time = steady_clock::now();
+
+    next_node_id = 1;
+    current_node_id = 0;
+
+    is_sampling_subtree = false;
+
+    number_of_subtrees_seen = 0;
+    number_of_records = 0;
+
+    current_block.reserve(records_per_block);
+
+    is_done = false;
+
+    writer = thread(&search_tracer::run_writer, this);
+}
+
+search_tracer::~search_tracer()
+{
+    send_current_block();
+
+    {
+        lock_guard<mutex> lock(blocks_mutex);
+
+        is_done = true;
+    }
+
+    blocks_changed.notify_one();
+
+    writer.join();
+}
+
+// HELPERS:
+
+bool search_tracer::enter_node(int ply, trace_record& record, bool& was_sampling_subtree)
+{
+    was_sampling_subtree = is_sampling_subtree;
+
+    if (ply == sample_ply && !is_sampling_subtree)
+    {
+        is_sampling_subtree = (number_of_subtrees_seen++ % sample_rate == 0);
+
+        if (!is_sampling_subtree)
+        {
+            return false;
+        }
+    }
+
+    else if (ply > sample_ply && !is_sampling_subtree)
+    {
+        return false;
+    }
+
+    record.node_id = next_node_id++;
+
+    record.parent_id = current_node_id;
+
+    record.start_nanoseconds = duration_cast<nanoseconds>(steady_clock::now() - creation_time).count();
+
+    current_node_id = record.node_id;
+
+    return true;
+}
+
+void search_tracer::exit_node(trace_record& record, bool was_sampling_subtree)
+{
+    const long long now = duration_cast<nanoseconds>(steady_clock::now() - creation_time).count();
+
+    record.duration_nanoseconds = now - record.start_nanoseconds;
+
+    current_node_id = record.parent_id;
+
+    is_sampling_subtree = was_sampling_subtree;
+
+    current_block.push_back(record);
+
+    number_of_records ++;
+
+    if (current_block.size() == records_per_block)
+    {
+        send_current_block();
+    }
+}
+
+// GETTERS:
+
+long long search_tracer::get_number_of_records() const
+{
+    return number_of_records;
+}
+
+// PUBLIC STATIC METHODS:
+
+void search_tracer::read_records(const string& file_name, vector<trace_record>& records)
+{
+    ifstream fin(file_name, ios::binary);
+
+    char magic[sizeof(file_magic)];
+
+    uint32_t record_size = 0;
+
+    fin.read(magic, sizeof(magic));
+    fin.read(reinterpret_cast<char*>(&record_size), sizeof(record_size));
+
+    if (fin.fail() || memcmp(magic, file_magic, sizeof(magic)) != 0 || record_size != sizeof(trace_record))
+    {
+        throw runtime_error(file_name + " isn't a trace written by search_tracer (on a machine like this one)\n");
+    }
+
+    records.clear();
+
+    trace_record record;
+
+    while (fin.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        records.push_back(record);
+    }
+}
+
+void search_tracer::write_chrome_trace(const vector<trace_record>& records, ostream& output)
+{
+    // "Complete" events on one thread: the viewer nests each node's slice inside its parent's, since it's within its time.
+
+    output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+    for (int i = 0; i < static_cast<int>(records.size()); i++)
+    {
+        const trace_record& record = records[i];
+
+        output << (i > 0 ? ",\n" : "") << "{\"name\":\"" << (record.move_col >= 0 ? string(1, 'a' + record.move_col) : string("root"))
+               << " " << get_stop_reason_name(record.stop_reason) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+               << record.start_nanoseconds / 1000.0 << ",\"dur\":" << record.duration_nanoseconds / 1000.0
+               << ",\"args\":{\"id\":" << record.node_id << ",\"parent\":" << record.parent_id
+               << ",\"ply\":" << static_cast<int>(record.ply) << ",\"depth_limit\":" << static_cast<int>(record.depth_limit)
+               << ",\"alpha_in\":\"" << format_bound(record.alpha_in) << "\",\"beta_in\":\"" << format_bound(record.beta_in)
+               << "\",\"alpha_out\":\"" << format_bound(record.alpha_out) << "\",\"beta_out\":\"" << format_bound(record.beta_out)
+               << "\",\"score\":" << record.score << ",\"TT\":\"" << get_TT_hit_name(record.TT_hit)
+               << "\",\"comp_to_move\":" << ((record.flags & trace_record::is_comp_turn_flag) ? "true" : "false")
+               << ",\"value_from_pruned_child\":" << ((record.flags & trace_record::got_value_from_pruned_child_flag) ? "true" : "false")
+               << ",\"moves\":\"" << static_cast<int>(record.moves_searched) << "/" << static_cast<int>(record.number_of_moves) << "\"}}";
+    }
+
+    output << "\n]}\n";
+}
+
+void search_tracer::write_tree(const vector<trace_record>& records, ostream& output)
+{
+    // A line per node, indented by its ply, with its children (in the order they were searched) under it.
+
+    vector<int> order(records.size()); // indices into records, by node_id (the order the nodes were entered).
+
+    for (int i = 0; i < static_cast<int>(order.size()); i++)
+    {
+        order[i] = i;
+    }
+
+    sort(order.begin(), order.end(), [&](int first, int second) {return records[first].node_id < records[second].node_id;});
+
+    for (int i: order)
+    {
+        const trace_record& record = records[i];
+
+        output << string(2 * record.ply, ' ') << (record.move_col >= 0 ? string(1, 'a' + record.move_col) : string("root"))
+               << " ply " << static_cast<int>(record.ply) << " (depth_limit " << static_cast<int>(record.depth_limit) << ") "
+               << ((record.flags & trace_record::is_comp_turn_flag) ? "C" : "U") << " to move: score " << record.score
+               << ", window [" << format_bound(record.alpha_in) << ", " << format_bound(record.beta_in) << "] -> ["
+               << format_bound(record.alpha_out) << ", " << format_bound(record.beta_out) << "], "
+               << get_stop_reason_name(record.stop_reason) << ", TT " << get_TT_hit_name(record.TT_hit) << ", "
+               << static_cast<int>(record.moves_searched) << "/" << static_cast<int>(record.number_of_moves) << " moves"
+               << ((record.flags & trace_record::got_value_from_pruned_child_flag) ? ", value from pruned child" : "")
+               << ", " << record.duration_nanoseconds << " ns\n";
+    }
+}
+
+// PRIVATE METHODS:
+
+void search_tracer::run_writer()
+{
+    unique_lock<mutex> lock(blocks_mutex);
+
+    while (true)
+    {
+        blocks_changed.wait(lock, [this]() {return !full_blocks.empty() || is_done;});
+
+        if (full_blocks.empty()) // so is_done.
+        {
+            break;
+        }
+
+        vector<trace_record> block = move(full_blocks.front());
+
+        full_blocks.pop_front();
+
+        lock.unlock(); // the searching thread can send more blocks while this one is written.
+
+        fout.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(trace_record));
+
+        lock.lock();
+    }
+
+    fout.close();
+}
+
+void search_tracer::send_current_block()
+{
+    if (current_block.empty())
+    {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(blocks_mutex);
+
+        full_blocks.push_back(move(current_block));
+    }
+
+    blocks_changed.notify_one();
+
+    current_block = vector<trace_record>();
+
+    current_block.reserve(records_per_block);
+}
+
+// PRIVATE STATIC METHODS:
+
+const char* search_tracer::get_stop_reason_name(int stop_reason)
+{
+    static const char* const names[] = {"searched", "alpha-beta cutoff", "TT cutoff", "win", "draw", "endgame database",
+                                        "threat parity", "leaf", "quiescence"};
+
+    return (stop_reason >= 0 && stop_reason <= TRACE_QUIESCENCE) ? names[stop_reason] : "?";
+}
+
+const char* search_tracer::get_TT_hit_name(int TT_hit)
+{
+    static const char* const names[] = {"miss", "exact", "lower bound", "upper bound", "move order"};
+
+    return (TT_hit >= 0 && TT_hit <= TRACE_TT_MOVE_ORDER) ? names[TT_hit] : "?";
+}
+
+string search_tracer::format_bound(int32_t bound)
+{
+    return (bound == trace_record::no_bound) ? "-" : to_string(bound);
+}
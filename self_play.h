@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "position.h"
+#include "engine.h"
+
+using namespace std;
+
+// Engine vs engine games, for checking that a change to the search (e.g., a new pruning method) doesn't cost games.
+// Both sides are played by the same engine, just with different settings (see engine_settings in position.h): before each move,
+// the settings of the side to move are given to the engine. The side to move always thinks as 'C' (its pieces get swapped to 'C'
+// if it's playing 'U'), since the position class only finds moves for the comp.
+
+struct match_result // Results of a match, from the perspective of the first engine.
+{
+    int wins;
+    int draws;
+    int losses;
+};
+
+class self_play
+{
+public:
+    // Public static methods:
+
+    static int play_game(engine& game_engine, const unique_ptr<position>& start, const engine_settings& engine_with_C,
+                         const engine_settings& engine_with_U);
+    // Plays out start (where it must be 'C' to move) until the game ends. Returns +1 if engine_with_C wins, 0 for a draw,
+    // -1 if engine_with_U wins. Both sides think with game_engine, with an empty TT on every move, and with its thinking_time
+    // and max_depth_limit (set max_depth_limit or max_nodes_per_move, and a large thinking_time, for games that don't depend on the
+    // speed of the machine). game_engine's settings are put back afterwards.
+
+    static match_result play_match(engine& game_engine, const vector<unique_ptr<position>>& starts, const engine_settings& first,
+                                   const engine_settings& second);
+    // Plays each starting position twice, with first as 'C' and then with second as 'C'.
+
+    static vector<vector<char>> swap_pieces(const vector<vector<char>>& board); // returns board with every 'C' and 'U' swapped.
+};
+
+// PUBLIC STATIC METHODS:
+
+int self_play::play_game(engine& game_engine, const unique_ptr<position>& start, const engine_settings& engine_with_C,
+                         const engine_settings& engine_with_U)
+{
+    if (!start->get_is_comp_turn())
+    {
+        throw runtime_error("It must be C's turn in the starting position sent to self_play::play_game()\n");
+    }
+
+    const engine_settings old_settings = game_engine.get_settings();
+
+    vector<vector<char>> board = start->get_board();
+
+    vector<treasure_spot> squares_amplifying_C_2 = start->get_squares_amplifying_comp_2();
+    vector<treasure_spot> squares_amplifying_C_3 = start->get_squares_amplifying_comp_3();
+    vector<treasure_spot> squares_amplifying_U_2 = start->get_squares_amplifying_user_2();
+    vector<treasure_spot> squares_amplifying_U_3 = start->get_squares_amplifying_user_3();
+
+    coordinate last_move = start->get_last_move();
+
+    bool is_C_turn = true;
+
+    int result = 0;
+
+    while (true)
+    {
+        unique_ptr<position> pt;
+
+        if (is_C_turn)
+        {
+            game_engine.set_settings(engine_with_C);
+
+            pt = game_engine.think_on_game_position(board, true, last_move, squares_amplifying_C_2, squares_amplifying_C_3,
+                                                    squares_amplifying_U_2, squares_amplifying_U_3, true);
+        }
+
+        else // U's pieces become the comp's pieces:
+        {
+            game_engine.set_settings(engine_with_U);
+
+            pt = game_engine.think_on_game_position(swap_pieces(board), true, last_move, squares_amplifying_U_2, squares_amplifying_U_3,
+                                                    squares_amplifying_C_2, squares_amplifying_C_3, true);
+        }
+
+        last_move = game_engine.find_best_move_for_comp(*pt);
+
+        board[last_move.row][last_move.col] = is_C_turn ? 'C' : 'U';
+
+        // Now get the position after the move (with no thinking), to see if the game is over and to update the amplifying vectors:
+
+        const double old_thinking_time = game_engine.get_thinking_time();
+
+        game_engine.set_thinking_time(0);
+
+        unique_ptr<position> after_move = game_engine.think_on_game_position(board, !is_C_turn, last_move, squares_amplifying_C_2,
+                                                                             squares_amplifying_C_3, squares_amplifying_U_2,
+                                                                             squares_amplifying_U_3, true);
+
+        game_engine.set_thinking_time(old_thinking_time);
+
+        if (after_move->did_computer_win() || after_move->did_opponent_win() || after_move->is_game_drawn())
+        {
+            result = after_move->did_computer_win() ? 1 : (after_move->did_opponent_win() ? -1 : 0);
+
+            break;
+        }
+
+        squares_amplifying_C_2 = after_move->get_squares_amplifying_comp_2();
+        squares_amplifying_C_3 = after_move->get_squares_amplifying_comp_3();
+        squares_amplifying_U_2 = after_move->get_squares_amplifying_user_2();
+        squares_amplifying_U_3 = after_move->get_squares_amplifying_user_3();
+
+        is_C_turn = !is_C_turn;
+    }
+
+    game_engine.set_settings(old_settings);
+
+    return result;
+}
+
+match_result self_play::play_match(engine& game_engine, const vector<unique_ptr<position>>& starts, const engine_settings& first,
+                                   const engine_settings& second)
+{
+    match_result result = {0, 0, 0};
+
+    for (const unique_ptr<position>& start: starts)
+    {
+        for (int game = 0; game < 2; game++)
+        {
+            int outcome = (game == 0) ? play_game(game_engine, start, first, second) : -play_game(game_engine, start, second, first);
+
+            if (outcome == 1)
+            {
+                result.wins ++;
+            }
+
+            else if (outcome == 0)
+            {
+                result.draws ++;
+            }
+
+            else
+            {
+                result.losses ++;
+            }
+        }
+    }
+
+    return result;
+}
+
+vector<vector<char>> self_play::swap_pieces(const vector<vector<char>>& board)
+{
+    vector<vector<char>> swapped = board;
+
+    for (vector<char>& row: swapped)
+    {
+        for (char& square: row)
+        {
+            if (square == 'C')
+            {
+                square = 'U';
+            }
+
+            else if (square == 'U')
+            {
+                square = 'C';
+            }
+        }
+    }
+
+    return swapped;
+}
@@ -0,0 +1,631 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include "engine.h"
+#include "game_session.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#define SESSION_SERVER_HAS_SOCKETS
+#endif
+
+using namespace std;
+
+// Plays many games against clients at once, on one machine: a server on a Unix domain socket (or a TCP port on localhost).
+// Each connection is a session with its own game_session, and the comp's searches are shared among a fixed number of worker
+// threads, each with its own engine. So however many sessions there are, at most number_of_workers searches run at a time, and
+// the memory used for TTs doesn't grow with the sessions. It does grow with the workers: up to about 76 MB each (an engine; see engine.h).
+
+// Each line a client sends gets one line back:
+// "new <comp|user> [<time budget>]" -> starts a new game, where "comp" or "user" goes first. The comp gets time budget seconds
+//                                      for all its moves (see game_session.h), or the server's default. The answer is "ok", or
+//                                      "move <column>" if the comp goes first.
+// "move <column>"                   -> the user's move (a-g). The answer is the comp's move, "move <column>", with " result comp"
+//                                      or " result draw" after it if that ended the game. If the user's move ended the game, it's
+//                                      "result user" or "result draw" instead.
+// "quit"                            -> closes the connection (so does the client closing it).
+// "shutdown"                        -> stops the server, once the searches running now are done.
+// Anything wrong with a line gets "error <reason>".
+
+// One thread waits on all the sockets (with poll()) and reads the lines. A session's lines are handled in order, one at a time,
+// by whichever worker is free, and the sessions with lines waiting take turns (first come, first served). A worker remembers
+// which game its engine's TT is from (game_session::get_TT_generation()), and resets it when it moves on to another game.
+
+struct server_session // The server's side of one connection.
+{
+    int socket;
+    unique_ptr<game_session> game; // nullptr until the first "new".
+    string unread_input; // what's been received after the last complete line.
+    deque<string> waiting_lines; // complete lines that haven't been handled yet.
+    bool is_queued; // true while the session is in waiting_sessions or a worker is handling one of its lines.
+    bool is_closed; // the client has gone. The socket is closed once is_queued is false too.
+};
+
+class session_server
+{
+public:
+    // Constructors:
+
+    session_server(const string& addressP, int number_of_workersP, double default_time_budgetP, const engine_settings& search_settingsP);
+    // addressP is the path of a Unix domain socket, or "tcp:<port>" for a TCP port on 127.0.0.1. The workers' engines search
+    // with search_settingsP.
+
+    // Helpers:
+    void run(); // listens on the address, and returns after a client sends "shutdown".
+
+    // Public static methods (also for clients, like load_generator.h):
+    static int open_connection(const string& address); // returns the connected socket, or throws runtime_error.
+    static void send_line(int socket, const string& line);
+    static bool receive_line(int socket, string& unread_input, string& line); // returns false if the connection has been closed.
+    static void close_connection(int socket);
+
+private:
+    // Private variables:
+    string address;
+    int number_of_workers;
+    double default_time_budget;
+    engine_settings search_settings;
+
+    mutex sessions_mutex; // guards all the server_sessions, and the variables below.
+    condition_variable sessions_changed;
+    deque<shared_ptr<server_session>> waiting_sessions; // sessions with lines waiting, in the order they started waiting.
+    bool is_shutting_down;
+
+    // Private methods:
+    void run_worker();
+    string handle_line(server_session& session, const string& line, engine& worker_engine, long long& worker_TT_generation);
+    // Returns the answer to line. Only called by one worker at a time for a session, without sessions_mutex.
+
+    void add_lines(const shared_ptr<server_session>& session, const string& received); // called with sessions_mutex locked.
+    void finish_with(const shared_ptr<server_session>& session); // closes the socket if the session is closed and not queued.
+
+    int open_listening_socket();
+};
+
+// CONSTRUCTORS:
+
+session_server::session_server(const string& addressP, int number_of_workersP, double default_time_budgetP,
+                               const engine_settings& search_settingsP)
+{
+    address = addressP;
+
+    number_of_workers = max(1, number_of_workersP);
+
+    default_time_budget = default_time_budgetP;
+
+    search_settings = search_settingsP;
+
+    is_shutting_down = false;
+}
+
+// HELPERS:
+
+#ifdef SESSION_SERVER_HAS_SOCKETS
+
+void session_server::run()
+{
+    int listening_socket = open_listening_socket();
+
+    is_shutting_down = false;
+
+    vector<thread> workers;
+
+    for (int t = 0; t < number_of_workers; t++)
+    {
+        workers.push_back(thread(&session_server::run_worker, this));
+    }
+
+    vector<shared_ptr<server_session>> sessions; // the open connections, in the same order as their sockets in the poll() list.
+
+    char buffer[4096];
+
+    while (true)
+    {
+        vector<pollfd> sockets = {{listening_socket, POLLIN, 0}};
+
+        for (const shared_ptr<server_session>& session: sessions)
+        {
+            sockets.push_back({session->socket, POLLIN, 0});
+        }
+
+        // The timeout is so that a "shutdown" handled by a worker is noticed, even if no client sends anything after it.
+
+        if (poll(sockets.data(), sockets.size(), 100) <= 0)
+        {
+            lock_guard<mutex> lock(sessions_mutex);
+
+            if (is_shutting_down)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        vector<shared_ptr<server_session>> still_open;
+
+        for (int i = 0; i < static_cast<int>(sessions.size()); i++)
+        {
+            const shared_ptr<server_session>& session = sessions[i];
+
+            if (sockets[i + 1].revents == 0)
+            {
+                still_open.push_back(session);
+
+                continue;
+            }
+
+            ssize_t received = recv(session->socket, buffer, sizeof(buffer), 0);
+
+            lock_guard<mutex> lock(sessions_mutex);
+
+            if (received <= 0)
+            {
+                session->is_closed = true;
+
+                finish_with(session);
+
+                continue;
+            }
+
+            add_lines(session, string(buffer, received));
+
+            if (!session->is_closed)
+            {
+                still_open.push_back(session);
+            }
+        }
+
+        if (sockets[0].revents & POLLIN)
+        {
+            int client_socket = accept(listening_socket, nullptr, nullptr);
+
+            if (client_socket >= 0)
+            {
+                shared_ptr<server_session> session = make_shared<server_session>();
+                session->socket = client_socket;
+                session->is_queued = false;
+                session->is_closed = false;
+
+                still_open.push_back(session);
+            }
+        }
+
+        sessions = still_open;
+
+        lock_guard<mutex> lock(sessions_mutex);
+
+        if (is_shutting_down)
+        {
+            break;
+        }
+    }
+
+    sessions_changed.notify_all();
+
+    for (thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    for (const shared_ptr<server_session>& session: sessions)
+    {
+        session->is_closed = true;
+        session->is_queued = false; // the workers are done, so nothing is handled any more.
+
+        finish_with(session);
+    }
+
+    close(listening_socket);
+
+    if (address.compare(0, 4, "tcp:") != 0)
+    {
+        unlink(address.c_str());
+    }
+}
+
+// PUBLIC STATIC METHODS:
+
+int session_server::open_connection(const string& address)
+{
+    int connection = -1;
+
+    if (address.compare(0, 4, "tcp:") == 0)
+    {
+        sockaddr_in server_address = {};
+        server_address.sin_family = AF_INET;
+        server_address.sin_port = htons(stoi(address.substr(4)));
+        server_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        connection = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&server_address), sizeof(server_address)) != 0)
+        {
+            throw runtime_error("Could not connect in session_server::open_connection()\n");
+        }
+    }
+
+    else
+    {
+        sockaddr_un server_address = {};
+        server_address.sun_family = AF_UNIX;
+        strncpy(server_address.sun_path, address.c_str(), sizeof(server_address.sun_path) - 1);
+
+        connection = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&server_address), sizeof(server_address)) != 0)
+        {
+            throw runtime_error("Could not connect in session_server::open_connection()\n");
+        }
+    }
+
+    return connection;
+}
+
+void session_server::send_line(int socket, const string& line)
+{
+    string message = line + "\n";
+
+    size_t sent = 0;
+
+    while (sent < message.size())
+    {
+        ssize_t result = send(socket, message.data() + sent, message.size() - sent, MSG_NOSIGNAL); // no SIGPIPE if the other side has gone.
+
+        if (result <= 0)
+        {
+            return; // the other side has gone, which the reading side finds out about.
+        }
+
+        sent += result;
+    }
+}
+
+bool session_server::receive_line(int socket, string& unread_input, string& line)
+{
+    char buffer[4096];
+
+    size_t end_of_line = unread_input.find('\n');
+
+    while (end_of_line == string::npos)
+    {
+        ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        unread_input.append(buffer, received);
+
+        end_of_line = unread_input.find('\n');
+    }
+
+    line = unread_input.substr(0, end_of_line);
+
+    unread_input.erase(0, end_of_line + 1);
+
+    return true;
+}
+
+void session_server::close_connection(int socket)
+{
+    close(socket);
+}
+
+// PRIVATE METHODS:
+
+int session_server::open_listening_socket()
+{
+    int listening_socket = -1;
+
+    int result = -1;
+
+    if (address.compare(0, 4, "tcp:") == 0)
+    {
+        sockaddr_in server_address = {};
+        server_address.sin_family = AF_INET;
+        server_address.sin_port = htons(stoi(address.substr(4)));
+        server_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // only this machine can connect.
+
+        listening_socket = socket(AF_INET, SOCK_STREAM, 0);
+
+        int reuse_address = 1;
+
+        setsockopt(listening_socket, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+
+        result = ::bind(listening_socket, reinterpret_cast<sockaddr*>(&server_address), sizeof(server_address));
+    }
+
+    else
+    {
+        sockaddr_un server_address = {};
+        server_address.sun_family = AF_UNIX;
+        strncpy(server_address.sun_path, address.c_str(), sizeof(server_address.sun_path) - 1);
+
+        unlink(address.c_str()); // in case an earlier server didn't get to remove it.
+
+        listening_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        result = ::bind(listening_socket, reinterpret_cast<sockaddr*>(&server_address), sizeof(server_address));
+    }
+
+    if (listening_socket < 0 || result != 0 || listen(listening_socket, SOMAXCONN) != 0)
+    {
+        throw runtime_error("Could not listen on the address sent to the session_server constructor\n");
+    }
+
+    return listening_socket;
+}
+
+void session_server::finish_with(const shared_ptr<server_session>& session)
+{
+    if (session->is_closed && !session->is_queued && session->socket >= 0)
+    {
+        close(session->socket);
+
+        session->socket = -1;
+    }
+}
+
+#else // no sockets to serve on, e.g. on Windows.
+
+void session_server::run()
+{
+    throw runtime_error("session_server::run() needs POSIX sockets\n");
+}
+
+int session_server::open_connection(const string& address)
+{
+    throw runtime_error("session_server::open_connection() needs POSIX sockets\n");
+}
+
+void session_server::send_line(int socket, const string& line)
+{
+    throw runtime_error("session_server::send_line() needs POSIX sockets\n");
+}
+
+bool session_server::receive_line(int socket, string& unread_input, string& line)
+{
+    throw runtime_error("session_server::receive_line() needs POSIX sockets\n");
+}
+
+void session_server::close_connection(int socket)
+{
+}
+
+int session_server::open_listening_socket()
+{
+    throw runtime_error("session_server::open_listening_socket() needs POSIX sockets\n");
+}
+
+void session_server::finish_with(const shared_ptr<server_session>& session)
+{
+}
+
+#endif
+
+void session_server::run_worker()
+{
+    engine worker_engine;
+
+    worker_engine.set_settings(search_settings);
+
+    worker_engine.set_number_of_defence_threads(1); // the other workers are busy with their own sessions.
+
+    long long worker_TT_generation = -1; // the game worker_engine's TT is from (none yet).
+
+    while (true)
+    {
+        shared_ptr<server_session> session;
+
+        string line;
+
+        {
+            unique_lock<mutex> lock(sessions_mutex);
+
+            sessions_changed.wait(lock, [this]() {return !waiting_sessions.empty() || is_shutting_down;});
+
+            if (is_shutting_down)
+            {
+                return;
+            }
+
+            session = waiting_sessions.front();
+
+            waiting_sessions.pop_front();
+
+            line = session->waiting_lines.front();
+
+            session->waiting_lines.pop_front();
+        }
+
+        string answer = handle_line(*session, line, worker_engine, worker_TT_generation);
+
+        lock_guard<mutex> lock(sessions_mutex);
+
+        if (answer == "shutdown")
+        {
+            is_shutting_down = true;
+
+            sessions_changed.notify_all();
+        }
+
+        else if (!session->is_closed)
+        {
+            send_line(session->socket, answer);
+        }
+
+        if (!session->waiting_lines.empty() && !session->is_closed)
+        {
+            waiting_sessions.push_back(session); // to the back, so the other sessions get their turn first.
+
+            sessions_changed.notify_one();
+        }
+
+        else
+        {
+            session->is_queued = false;
+
+            finish_with(session);
+        }
+    }
+}
+
+string session_server::handle_line(server_session& session, const string& line, engine& worker_engine, long long& worker_TT_generation)
+{
+    istringstream words(line);
+
+    string command;
+
+    words >> command;
+
+    try
+    {
+        if (command == "new")
+        {
+            string first_player;
+
+            words >> first_player;
+
+            if (first_player != "comp" && first_player != "user")
+            {
+                throw runtime_error("Expected comp or user after new");
+            }
+
+            double time_budget = default_time_budget;
+
+            words >> time_budget;
+
+            session.game = make_unique<game_session>(first_player == "comp", vector<coordinate>(), time_budget);
+
+            session.game->start(worker_engine); // resets the TT.
+
+            worker_TT_generation = session.game->get_TT_generation();
+
+            if (!session.game->is_comp_turn())
+            {
+                return "ok";
+            }
+
+            coordinate comp_move = session.game->play_comp_move(worker_engine);
+
+            return string("move ") + static_cast<char>('a' + comp_move.col);
+        }
+
+        if (command == "move")
+        {
+            string column;
+
+            words >> column;
+
+            if (!session.game)
+            {
+                throw runtime_error("No game has been started with new");
+            }
+
+            if (column.size() != 1)
+            {
+                throw runtime_error("Expected a column from a to g after move");
+            }
+
+            session.game->play_user_move(tolower(column[0]) - 'a');
+
+            session.game->think(worker_engine, worker_TT_generation != session.game->get_TT_generation());
+
+            worker_TT_generation = session.game->get_TT_generation();
+
+            if (session.game->is_game_over())
+            {
+                return session.game->did_user_win() ? "result user" : "result draw";
+            }
+
+            coordinate comp_move = session.game->play_comp_move(worker_engine);
+
+            string answer = string("move ") + static_cast<char>('a' + comp_move.col);
+
+            if (session.game->is_game_over())
+            {
+                answer += session.game->did_comp_win() ? " result comp" : " result draw";
+            }
+
+            return answer;
+        }
+
+        if (command == "shutdown")
+        {
+            return "shutdown";
+        }
+
+        throw runtime_error("Unknown command " + command);
+    }
+
+    catch (const exception& error)
+    {
+        string reason = error.what();
+
+        reason.erase(remove(reason.begin(), reason.end(), '\n'), reason.end());
+
+        return "error " + reason;
+    }
+}
+
+void session_server::add_lines(const shared_ptr<server_session>& session, const string& received)
+{
+    session->unread_input += received;
+
+    size_t end_of_line = session->unread_input.find('\n');
+
+    while (end_of_line != string::npos)
+    {
+        string line = session->unread_input.substr(0, end_of_line);
+
+        session->unread_input.erase(0, end_of_line + 1);
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (line == "quit")
+        {
+            session->is_closed = true;
+
+            finish_with(session);
+
+            return;
+        }
+
+        if (!line.empty())
+        {
+            session->waiting_lines.push_back(line);
+        }
+
+        end_of_line = session->unread_input.find('\n');
+    }
+
+    if (!session->waiting_lines.empty() && !session->is_queued)
+    {
+        session->is_queued = true;
+
+        waiting_sessions.push_back(session);
+
+        sessions_changed.notify_one();
+    }
+}
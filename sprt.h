@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// A sequential probability ratio test, for deciding a match (see versus_sim.h) as soon as the games so far are enough.
+
+// H0 is that the first player is elo0 Elo stronger than the second, and H1 that it's elo1 stronger (elo1 > elo0). The test
+// accepts H1 once the log likelihood ratio of H1 to H0 reaches log((1 - beta) / alpha), and H0 once it's down to
+// log(beta / (1 - alpha)). So alpha is the chance of accepting H1 when H0 is true, and beta the chance of the reverse.
+
+// The games come in pairs (an opening played with each colour), so the test counts pairs by the first player's score in them
+// (0, 0.5, 1, 1.5 or 2): the pentanomial. Scoring the pairs instead of the games takes out most of the noise from the openings
+// (which favour one colour or the other), so it usually decides with far fewer games. The ratio uses the normal approximation
+// for the mean pair score, with the variance measured from the pairs.
+
+struct sprt_settings
+{
+    double elo0;
+    double elo1;
+    double alpha;
+    double beta;
+};
+
+enum sprt_status
+{
+    SPRT_UNDECIDED,
+    SPRT_H0_ACCEPTED,
+    SPRT_H1_ACCEPTED
+};
+
+class sprt
+{
+public:
+    // Public static variables:
+    static const int number_of_pair_scores = 5; // the size of a pentanomial. Index i is a pair score of i / 2.
+
+    // Public static methods:
+    static double log_likelihood_ratio(const int pentanomial[number_of_pair_scores], const sprt_settings& settings);
+    // 0 with no pairs. The mean and variance include one pretend pair (see below), so the variance is never 0.
+
+    static sprt_status get_status(const int pentanomial[number_of_pair_scores], const sprt_settings& settings);
+
+    static double get_lower_bound(const sprt_settings& settings); // of the log likelihood ratio, where H0 is accepted.
+    static double get_upper_bound(const sprt_settings& settings); // where H1 is accepted.
+
+    static void estimate_elo(const int pentanomial[number_of_pair_scores], double& elo, double& error_margin);
+    // The first player's Elo difference from the mean pair score, and the margin of its 95% confidence interval.
+
+private:
+    // Private static methods:
+    static double elo_to_score(double elo); // the expected score per game.
+    static double score_to_elo(double score);
+    static void find_mean_and_variance(const int pentanomial[number_of_pair_scores], int& number_of_pairs, double& mean, double& variance);
+    // Of the score per game in each pair (so between 0 and 1).
+};
+
+// PUBLIC STATIC METHODS:
+
+double sprt::log_likelihood_ratio(const int pentanomial[number_of_pair_scores], const sprt_settings& settings)
+{
+    int number_of_pairs;
+
+    double mean, variance;
+
+    find_mean_and_variance(pentanomial, number_of_pairs, mean, variance);
+
+    if (number_of_pairs == 0)
+    {
+        return 0;
+    }
+
+    // Without a variance floor, a match whose pairs all score the same (e.g., every pair won, or every game drawn) would have no
+    // variance, and never be decided. So one pretend pair is added: half of it scoring 0, and half scoring 2. It also keeps a
+    // handful of identical pairs from deciding the test, and counts for less and less as real pairs come in.
+
+    const double mean_of_squares = (number_of_pairs * (variance + mean * mean) + 0.5) / (number_of_pairs + 1);
+
+    mean = (number_of_pairs * mean + 0.5) / (number_of_pairs + 1);
+
+    variance = mean_of_squares - mean * mean;
+
+    number_of_pairs ++;
+
+    const double score0 = elo_to_score(settings.elo0);
+    const double score1 = elo_to_score(settings.elo1);
+
+    return number_of_pairs * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+}
+
+sprt_status sprt::get_status(const int pentanomial[number_of_pair_scores], const sprt_settings& settings)
+{
+    const double llr = log_likelihood_ratio(pentanomial, settings);
+
+    if (llr >= get_upper_bound(settings))
+    {
+        return SPRT_H1_ACCEPTED;
+    }
+
+    if (llr <= get_lower_bound(settings))
+    {
+        return SPRT_H0_ACCEPTED;
+    }
+
+    return SPRT_UNDECIDED;
+}
+
+double sprt::get_lower_bound(const sprt_settings& settings)
+{
+    return log(settings.beta / (1 - settings.alpha));
+}
+
+double sprt::get_upper_bound(const sprt_settings& settings)
+{
+    return log((1 - settings.beta) / settings.alpha);
+}
+
+void sprt::estimate_elo(const int pentanomial[number_of_pair_scores], double& elo, double& error_margin)
+{
+    int number_of_pairs;
+
+    double mean, variance;
+
+    find_mean_and_variance(pentanomial, number_of_pairs, mean, variance);
+
+    if (number_of_pairs == 0)
+    {
+        elo = 0;
+
+        error_margin = 0;
+
+        return;
+    }
+
+    const double mean_error_margin = 1.96 * sqrt(variance / number_of_pairs);
+
+    // A score of 0 or 1 is an infinite Elo difference, so the scores are kept just inside:
+
+    const double min_score = 1e-6;
+
+    elo = score_to_elo(min(max(mean, min_score), 1 - min_score));
+
+    error_margin = (score_to_elo(min(mean + mean_error_margin, 1 - min_score)) - score_to_elo(max(mean - mean_error_margin, min_score))) / 2;
+}
+
+// PRIVATE STATIC METHODS:
+
+double sprt::elo_to_score(double elo)
+{
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+double sprt::score_to_elo(double score)
+{
+    return -400 * log10(1 / score - 1);
+}
+
+void sprt::find_mean_and_variance(const int pentanomial[number_of_pair_scores], int& number_of_pairs, double& mean, double& variance)
+{
+    number_of_pairs = 0;
+
+    mean = 0;
+
+    variance = 0;
+
+    for (int i = 0; i < number_of_pair_scores; i++)
+    {
+        number_of_pairs += pentanomial[i];
+
+        mean += pentanomial[i] * (i / 4.0);
+    }
+
+    if (number_of_pairs == 0)
+    {
+        return;
+    }
+
+    mean /= number_of_pairs;
+
+    for (int i = 0; i < number_of_pair_scores; i++)
+    {
+        variance += pentanomial[i] * (i / 4.0 - mean) * (i / 4.0 - mean);
+    }
+
+    variance /= number_of_pairs;
+}
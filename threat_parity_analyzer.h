@@ -0,0 +1,318 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "bitboard.h"
+
+using namespace std;
+
+// Static threat analysis following Allis's rules for Connect Four, applied to quiet positions.
+
+// The idea: the player who did NOT just get the turn (call them the follower) can often answer every move of the player to move
+// according to a fixed plan, no matter what the player to move does:
+    // - Claimeven: in a column with an even number of empty squares, the follower always plays directly on top of the other
+    //   player's move. The follower ends up with every second square of that column, starting with the second empty one.
+    //   (When every column is like this, these are exactly the even rows, which is why even threats favour the follower.)
+    // - Baseinverse: the bottom empty squares of two columns that each have an odd number of empty squares can be paired up.
+    //   Whenever the other player takes one of them, the follower takes the other. After that, both columns have an even number
+    //   of empty squares left, and claimeven takes over in them.
+
+// If, under such a plan, every line of 4 still open to the player to move contains a square the follower will get
+// (or both squares of one baseinverse pair), the player to move can never win. If the follower also has a line of 4
+// using only squares the plan gives them, the follower wins. This is the "zugzwang" at the end of the game that decides
+// most Connect Four games, worked out without searching.
+
+class threat_parity_analyzer
+{
+public:
+    // Public static methods:
+
+    static bool find_proven_outcome(const bitboard& current, int& outcome);
+    // Returns true if the analysis proves the outcome of current, and sets outcome to +1 (win), 0 (draw) or -1 (loss) from the
+    // perspective of the player to move. Returns false (outcome untouched) if nothing could be proven.
+
+    static vector<uint64_t> find_all_windows(); // the 69 groups of 4 squares in a line on the board.
+
+    static uint64_t find_open_windows_mask(uint64_t opponent_pieces, vector<uint64_t>& open_windows);
+    // Fills open_windows with the windows that don't contain an opponent piece (the lines of 4 that are still possible for the player).
+
+    // Public static variables:
+    static const vector<uint64_t> windows;
+
+private:
+    // Private static methods:
+
+    static void find_column_pairings(const vector<int>& odd_columns, vector<vector<pair<int, int>>>& pairings,
+                                      vector<pair<int, int>>& current_pairing, vector<bool>& used);
+    // Fills pairings with every way of splitting odd_columns into pairs (for baseinverse).
+
+    static int apply_follow_up_plan(const bitboard& current, const vector<pair<int, int>>& pairing,
+                                    const vector<uint64_t>& open_windows_of_player_to_move,
+                                    const vector<uint64_t>& open_windows_of_follower);
+    // Returns -1 if the plan makes the follower win, 0 if it only stops the player to move from ever winning, and
+    // 1 if it fails (the player to move still has a line of 4 the plan doesn't cover).
+};
+
+// Initializing the static variables:
+
+const vector<uint64_t> threat_parity_analyzer::windows = threat_parity_analyzer::find_all_windows();
+
+// PUBLIC STATIC METHODS:
+
+bool threat_parity_analyzer::find_proven_outcome(const bitboard& current, int& outcome)
+{
+    uint64_t pieces_of_player_to_move = current.current_pieces;
+    uint64_t pieces_of_follower = current.current_pieces ^ current.all_pieces;
+
+    vector<uint64_t> open_windows_of_player_to_move;
+    vector<uint64_t> open_windows_of_follower;
+
+    find_open_windows_mask(pieces_of_follower, open_windows_of_player_to_move);
+    find_open_windows_mask(pieces_of_player_to_move, open_windows_of_follower);
+
+    if (open_windows_of_player_to_move.empty() && open_windows_of_follower.empty()) // nobody can ever make a 4-in-a-row.
+    {
+        outcome = 0;
+
+        return true;
+    }
+
+    // Find the columns with an odd number of empty squares. They have to be paired up with baseinverse for the plan to work,
+    // which needs an even number of them (i.e., an even number of empty squares on the board, so the follower moves last).
+
+    vector<int> odd_columns;
+
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        int empty_squares_in_column = bitboard::population_count(bitboard::column_mask(col) & ~current.all_pieces);
+
+        if (empty_squares_in_column % 2 != 0)
+        {
+            odd_columns.push_back(col);
+        }
+    }
+
+    if (odd_columns.size() % 2 != 0)
+    {
+        return false;
+    }
+
+    vector<vector<pair<int, int>>> pairings;
+    vector<pair<int, int>> current_pairing;
+    vector<bool> used(odd_columns.size(), false);
+
+    find_column_pairings(odd_columns, pairings, current_pairing, used);
+
+    bool can_follower_draw = false;
+
+    for (const vector<pair<int, int>>& pairing: pairings)
+    {
+        int result = apply_follow_up_plan(current, pairing, open_windows_of_player_to_move, open_windows_of_follower);
+
+        if (result == -1)
+        {
+            outcome = -1;
+
+            return true;
+        }
+
+        if (result == 0)
+        {
+            can_follower_draw = true;
+        }
+    }
+
+    // The player to move can't win. If the follower can't ever make a 4-in-a-row either, it's a draw:
+
+    if (can_follower_draw && open_windows_of_follower.empty())
+    {
+        outcome = 0;
+
+        return true;
+    }
+
+    return false;
+}
+
+vector<uint64_t> threat_parity_analyzer::find_all_windows()
+{
+    vector<uint64_t> all_windows;
+
+    // (row step, col step) for vertical, horizontal, and the two diagonals. Heights count up from the bottom here.
+
+    const int directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {-1, 1}};
+
+    for (const auto& direction: directions)
+    {
+        for (int col = 0; col < bitboard::width; col++)
+        {
+            for (int height = 0; height < bitboard::height; height++)
+            {
+                int end_col = col + 3 * direction[1];
+                int end_height = height + 3 * direction[0];
+
+                if (end_col >= bitboard::width || end_height < 0 || end_height >= bitboard::height)
+                {
+                    continue;
+                }
+
+                uint64_t window = 0;
+
+                for (int i = 0; i < 4; i++)
+                {
+                    window |= 1ULL << ((col + i * direction[1]) * (bitboard::height + 1) + height + i * direction[0]);
+                }
+
+                all_windows.push_back(window);
+            }
+        }
+    }
+
+    return all_windows;
+}
+
+uint64_t threat_parity_analyzer::find_open_windows_mask(uint64_t opponent_pieces, vector<uint64_t>& open_windows)
+{
+    uint64_t squares_in_open_windows = 0;
+
+    for (uint64_t window: windows)
+    {
+        if ((window & opponent_pieces) == 0)
+        {
+            open_windows.push_back(window);
+
+            squares_in_open_windows |= window;
+        }
+    }
+
+    return squares_in_open_windows;
+}
+
+// PRIVATE STATIC METHODS:
+
+void threat_parity_analyzer::find_column_pairings(const vector<int>& odd_columns, vector<vector<pair<int, int>>>& pairings,
+                                                   vector<pair<int, int>>& current_pairing, vector<bool>& used)
+{
+    int first_unused = -1;
+
+    for (int i = 0; i < static_cast<int>(odd_columns.size()); i++)
+    {
+        if (!used[i])
+        {
+            first_unused = i;
+
+            break;
+        }
+    }
+
+    if (first_unused == -1) // every column is paired up.
+    {
+        pairings.push_back(current_pairing);
+
+        return;
+    }
+
+    used[first_unused] = true;
+
+    for (int i = first_unused + 1; i < static_cast<int>(odd_columns.size()); i++)
+    {
+        if (!used[i])
+        {
+            used[i] = true;
+            current_pairing.push_back({odd_columns[first_unused], odd_columns[i]});
+
+            find_column_pairings(odd_columns, pairings, current_pairing, used);
+
+            current_pairing.pop_back();
+            used[i] = false;
+        }
+    }
+
+    used[first_unused] = false;
+}
+
+int threat_parity_analyzer::apply_follow_up_plan(const bitboard& current, const vector<pair<int, int>>& pairing,
+                                                 const vector<uint64_t>& open_windows_of_player_to_move,
+                                                 const vector<uint64_t>& open_windows_of_follower)
+{
+    // Work out which empty squares the plan gives to each player. The bottom squares of paired columns go to whichever
+    // player the player to move chooses, so they belong to neither.
+
+    uint64_t squares_of_follower = 0;
+    uint64_t paired_squares = 0;
+
+    vector<uint64_t> pair_masks; // both squares of each baseinverse pair.
+
+    for (const pair<int, int>& columns: pairing)
+    {
+        uint64_t first = (current.all_pieces + bitboard::bottom_mask_col(columns.first)) & bitboard::column_mask(columns.first);
+        uint64_t second = (current.all_pieces + bitboard::bottom_mask_col(columns.second)) & bitboard::column_mask(columns.second);
+
+        paired_squares |= first | second;
+
+        pair_masks.push_back(first | second);
+    }
+
+    for (int col = 0; col < bitboard::width; col++)
+    {
+        uint64_t square = (current.all_pieces + bitboard::bottom_mask_col(col)) & bitboard::column_mask(col); // lowest empty square.
+
+        if (square & paired_squares) // claimeven starts one square higher, above the baseinverse square.
+        {
+            square <<= 1;
+        }
+
+        bool is_follower_square = false; // claimeven gives the first square to the player to move, the next to the follower, etc.
+
+        while (square & bitboard::column_mask(col))
+        {
+            if (is_follower_square)
+            {
+                squares_of_follower |= square;
+            }
+
+            is_follower_square = !is_follower_square;
+
+            square <<= 1;
+        }
+    }
+
+    // Now every open line of the player to move has to contain a follower square, or both squares of a baseinverse pair:
+
+    for (uint64_t window: open_windows_of_player_to_move)
+    {
+        if (window & squares_of_follower)
+        {
+            continue;
+        }
+
+        bool is_refuted_by_baseinverse = false;
+
+        for (uint64_t pair_mask: pair_masks)
+        {
+            if ((window & pair_mask) == pair_mask)
+            {
+                is_refuted_by_baseinverse = true;
+
+                break;
+            }
+        }
+
+        if (!is_refuted_by_baseinverse)
+        {
+            return 1;
+        }
+    }
+
+    // The player to move can never win with this plan. See if it also hands the follower a complete line of 4:
+
+    for (uint64_t window: open_windows_of_follower)
+    {
+        if ((window & ~current.all_pieces & ~squares_of_follower) == 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+
+#include "position.h"
+#include "moves_reaching_positions.h"
+#include "versus_sim.h"
+
+using namespace std;
+
+// The "Versus Sim" build target: plays a match between two engine configurations (see versus_sim.h).
+
+// Usage: VersusSim <first player> <second player> [time=<seconds>] [depth=<n>] [nodes=<n>] [threads=<n>] [trials=<n>]
+//                  [sprt=<elo0>,<elo1>] [alpha=<a>] [beta=<b>]
+// A player is a list of options separated by commas, each changing the default engine (what main.cpp plays with):
+//     default, alphabeta, mtdf, pvs, lmr, no_lmr, futility, no_futility, smart, pattern, frontier_ordering,
+//     no_frontier_ordering, cache, no_cache, params=<file of evaluation parameters>, time=<seconds>, depth=<n>, nodes=<n>
+// E.g. "VersusSim mtdf,depth=8 default,depth=8 trials=200". The limits after the players are for both, unless a player has
+// their own. If there's a depth or node limit but no time limit, there's no time limit at all (like in "analyze").
+// There's a trial for each opening in MovesReachingPositions.txt (or the first <trials> of them). With sprt, the match stops
+// as soon as an SPRT of the first player being elo0 vs elo1 Elo stronger is decided (see sprt.h). alpha and beta default to 0.05.
+
+void parse_limit(const string& option, double& thinking_time, int& max_depth_limit, int& max_nodes_per_move, bool& has_time_limit)
+{
+    // Sets the limit option is for. Throws runtime_error if option isn't a limit.
+
+    const string name = option.substr(0, option.find('='));
+
+    const string value = option.substr(option.find('=') + 1);
+
+    if (name == "time")
+    {
+        thinking_time = atof(value.c_str());
+
+        has_time_limit = true;
+    }
+
+    else if (name == "depth")
+    {
+        max_depth_limit = atoi(value.c_str());
+    }
+
+    else if (name == "nodes")
+    {
+        max_nodes_per_move = atoi(value.c_str());
+    }
+
+    else
+    {
+        throw runtime_error("Unknown option \"" + option + "\" sent to the Versus Sim\n");
+    }
+}
+
+versus_player parse_player(const string& description, const engine_settings& default_settings, double thinking_time, int max_depth_limit,
+                           int max_nodes_per_move, bool has_time_limit)
+{
+    // The settings and limits sent are the default engine's and the match's, which the player's own options can change.
+
+    versus_player player = {description, default_settings, thinking_time, max_depth_limit, max_nodes_per_move};
+
+    stringstream options(description);
+
+    string option;
+
+    while (getline(options, option, ','))
+    {
+        if (option == "default")
+        {
+            continue;
+        }
+
+        else if (option == "alphabeta" || option == "mtdf" || option == "pvs")
+        {
+            player.settings.search_driver = (option == "mtdf") ? MTD_F : (option == "pvs") ? PVS : ALPHA_BETA;
+        }
+
+        else if (option == "lmr" || option == "no_lmr")
+        {
+            player.settings.use_late_move_reductions = (option == "lmr");
+        }
+
+        else if (option == "futility" || option == "no_futility")
+        {
+            player.settings.use_futility_pruning = (option == "futility");
+        }
+
+        else if (option == "smart")
+        {
+            player.settings.evaluator = SMART_EVALUATION;
+        }
+
+        else if (option == "pattern")
+        {
+            player.settings.evaluator = PATTERN_TABLE_EVALUATION;
+        }
+
+        else if (option == "frontier_ordering" || option == "no_frontier_ordering")
+        {
+            player.settings.order_frontier_moves = (option == "frontier_ordering");
+        }
+
+        else if (option == "cache" || option == "no_cache")
+        {
+            player.settings.use_evaluation_cache = (option == "cache");
+        }
+
+        else if (option.compare(0, 7, "params=") == 0)
+        {
+            if (!evaluation_parameters::load(option.substr(7), player.settings.parameters))
+            {
+                throw runtime_error("Couldn't read the evaluation parameters in \"" + option + "\" sent to the Versus Sim\n");
+            }
+        }
+
+        else
+        {
+            parse_limit(option, player.thinking_time, player.max_depth_limit, player.max_nodes_per_move, has_time_limit);
+        }
+    }
+
+    if (!has_time_limit && (player.max_depth_limit < 42 || player.max_nodes_per_move > 0))
+    {
+        player.thinking_time = 1000000;
+    }
+
+    return player;
+}
+
+void print_player_statistics(const versus_sim_result& result, int p, const string& name)
+{
+    int moves = max(1, result.moves_made[p]);
+
+    cout << name << ": " << result.moves_made[p] << " moves, time per move: mean " << result.total_move_time[p] / moves * 1000
+         << " ms, max " << result.max_move_time[p] * 1000 << " ms (find_best_move_for_comp(): mean "
+         << result.total_find_best_move_time[p] / moves * 1000 << " ms, max " << result.max_find_best_move_time[p] * 1000 << " ms)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: VersusSim <first player> <second player> [time=<seconds>] [depth=<n>] [nodes=<n>] [threads=<n>] [trials=<n>]\n";
+
+        return 1;
+    }
+
+    double thinking_time = engine_state::default_thinking_time;
+
+    int max_depth_limit = 42;
+
+    int max_nodes_per_move = 0;
+
+    bool has_time_limit = false;
+
+    int number_of_threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+
+    int number_of_trials = INT_MAX;
+
+    bool has_sprt = false;
+
+    sprt_settings sprt_test = {0, 5, 0.05, 0.05};
+
+    for (int i = 3; i < argc; i++)
+    {
+        const string argument = argv[i];
+
+        if (argument.compare(0, 8, "threads=") == 0)
+        {
+            number_of_threads = atoi(argument.c_str() + 8);
+        }
+
+        else if (argument.compare(0, 7, "trials=") == 0)
+        {
+            number_of_trials = atoi(argument.c_str() + 7);
+        }
+
+        else if (argument.compare(0, 5, "sprt=") == 0 && argument.find(',') != string::npos)
+        {
+            has_sprt = true;
+
+            sprt_test.elo0 = atof(argument.c_str() + 5);
+
+            sprt_test.elo1 = atof(argument.c_str() + argument.find(',') + 1);
+        }
+
+        else if (argument.compare(0, 6, "alpha=") == 0)
+        {
+            sprt_test.alpha = atof(argument.c_str() + 6);
+        }
+
+        else if (argument.compare(0, 5, "beta=") == 0)
+        {
+            sprt_test.beta = atof(argument.c_str() + 5);
+        }
+
+        else
+        {
+            parse_limit(argument, thinking_time, max_depth_limit, max_nodes_per_move, has_time_limit);
+        }
+    }
+
+    position::precomputed_endgame_database.load("EndgameDatabase.bin");
+
+    engine_settings default_settings;
+
+    evaluation_parameters::load("EvaluationParameters.txt", default_settings.parameters); // the default player's weights.
+
+    versus_player first = parse_player(argv[1], default_settings, thinking_time, max_depth_limit, max_nodes_per_move, has_time_limit);
+
+    versus_player second = parse_player(argv[2], default_settings, thinking_time, max_depth_limit, max_nodes_per_move, has_time_limit);
+
+    vector<vector<coordinate>> openings;
+
+    read_file_into_vector(openings);
+
+    if (!are_all_moves_valid(openings))
+    {
+        throw runtime_error("Found invalid move(s) in MovesReachingPositions.txt in the Versus Sim\n");
+    }
+
+    if (static_cast<int>(openings.size()) > number_of_trials)
+    {
+        openings.resize(max(number_of_trials, 0));
+    }
+
+    if (has_sprt && (sprt_test.elo1 <= sprt_test.elo0 || sprt_test.alpha <= 0 || sprt_test.alpha >= 1 ||
+                     sprt_test.beta <= 0 || sprt_test.beta >= 1))
+    {
+        throw runtime_error("The Versus Sim's SPRT needs elo0 < elo1, and alpha and beta between 0 and 1\n");
+    }
+
+    versus_sim sim(first, second, number_of_threads);
+
+    if (has_sprt)
+    {
+        sim.set_sprt(sprt_test);
+    }
+
+    versus_sim_result result = sim.play(openings);
+
+    int games = result.wins[0] + result.wins[1] + result.draws;
+
+    cout << first.name << " vs " << second.name << ": " << result.trials << " trials (" << games << " games) in " << result.seconds
+         << " seconds on " << number_of_threads << " threads.\n";
+
+    cout << "Score for " << first.name << ": +" << result.wins[0] << " =" << result.draws << " -" << result.wins[1] << " ("
+         << (result.wins[0] + 0.5 * result.draws) / max(1, games) * 100 << "%)\n";
+
+    cout << "Uneven trials: " << result.uneven_trials << " out of " << result.trials << "\n";
+
+    cout << "Pentanomial (trials where " << first.name << " scored 0, 0.5, 1, 1.5, 2):";
+
+    for (int i = 0; i < sprt::number_of_pair_scores; i++)
+    {
+        cout << " " << result.pentanomial[i];
+    }
+
+    double elo, error_margin;
+
+    sprt::estimate_elo(result.pentanomial, elo, error_margin);
+
+    cout << "\nElo difference: " << elo << " +/- " << error_margin << "\n";
+
+    if (has_sprt)
+    {
+        cout << "SPRT (elo0 " << sprt_test.elo0 << ", elo1 " << sprt_test.elo1 << ", alpha " << sprt_test.alpha << ", beta "
+             << sprt_test.beta << "): LLR " << result.log_likelihood_ratio << " (" << sprt::get_lower_bound(sprt_test) << ", "
+             << sprt::get_upper_bound(sprt_test) << "), ";
+
+        if (result.status == SPRT_H1_ACCEPTED)
+        {
+            cout << "H1 accepted";
+        }
+
+        else if (result.status == SPRT_H0_ACCEPTED)
+        {
+            cout << "H0 accepted";
+        }
+
+        else
+        {
+            cout << "undecided (the openings ran out)";
+        }
+
+        cout << " after " << result.trials << " trials.\n";
+    }
+
+    cout << "Average game length (in moves): " << first.name << " won " << static_cast<double>(result.total_length_of_won_games[0]) / max(1, result.wins[0])
+         << ", " << second.name << " won " << static_cast<double>(result.total_length_of_won_games[1]) / max(1, result.wins[1])
+         << ", drawn " << static_cast<double>(result.total_length_of_drawn_games) / max(1, result.draws) << "\n";
+
+    print_player_statistics(result, 0, first.name);
+
+    print_player_statistics(result, 1, second.name);
+
+    return 0;
+}
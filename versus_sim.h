@@ -0,0 +1,359 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "position.h"
+#include "engine.h"
+#include "self_play.h"
+#include "sprt.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// The Versus Sim: a match between two engine configurations, with the statistics notes.cpp records for each version.
+// (The Versus Sim the notes refer to plays different versions of the position class against each other, through tool and
+// call_static_think_on_game_position(). This one plays configurations of this version, through the engine class.)
+
+// Each opening is a trial: 2 games from the position it reaches, with each player moving first once. The trials are shared among
+// number_of_threads threads, each with an engine per player (so the players have their own TTs, kept between their moves in a
+// game, like in play_game()), plus one for getting the position after each move. A game only depends on its opening and
+// the players, so with depth or node limits the results don't depend on the number of threads. With 3 engines, each thread
+// takes up to about 230 MB (see engine.h), but the one for getting the positions never thinks, so it never uses its solvers.
+
+// With an SPRT (see sprt.h), the match stops as soon as the test is decided: no more trials are started, and the ones still
+// being played aren't counted. The trials are started in the order of the openings, but which ones are done by the time the
+// test is decided can depend on the threads.
+
+struct versus_player // One side of a Versus Sim match.
+{
+    string name;
+    engine_settings settings;
+    double thinking_time;
+    int max_depth_limit;
+    int max_nodes_per_move; // 0 for no limit.
+};
+
+struct versus_sim_result // Indices 0 and 1 are the first and second player sent to the versus_sim constructor.
+{
+    int trials;
+    int uneven_trials; // trials where a player scored more than the other (in their 2 games).
+    int pentanomial[sprt::number_of_pair_scores]; // trials by the first player's score in them (index 0 for 0, up to 4 for 2).
+    int wins[2];
+    int draws;
+    long long total_length_of_won_games[2]; // in moves (every piece on the board at the end, including the opening's).
+    long long total_length_of_drawn_games;
+    int moves_made[2]; // the moves the players chose (not counting the openings).
+    double total_move_time[2]; // thinking on the position plus choosing the move, in seconds.
+    double max_move_time[2];
+    double total_find_best_move_time[2]; // just find_best_move_for_comp().
+    double max_find_best_move_time[2];
+    double seconds; // for the whole match.
+    sprt_status status; // SPRT_UNDECIDED if there's no SPRT (or it didn't finish before the openings ran out).
+    double log_likelihood_ratio; // of the SPRT (0 if there's no SPRT).
+};
+
+class versus_sim
+{
+public:
+    // Constructors:
+
+    versus_sim(const versus_player& firstP, const versus_player& secondP, int number_of_threadsP);
+
+    // Helpers:
+    versus_sim_result play(const vector<vector<coordinate>>& openings); // one trial per opening.
+
+    // Setters:
+    void set_sprt(const sprt_settings& sprt_testP); // play() stops as soon as this test is decided.
+
+private:
+    // Private variables:
+    versus_player players[2];
+    int number_of_threads;
+    bool has_sprt;
+    sprt_settings sprt_test;
+
+    // Private methods:
+    void run_worker(const vector<vector<coordinate>>& openings, atomic<int>& next_trial, versus_sim_result& result, mutex& result_mutex);
+
+    int play_game(const vector<coordinate>& opening, int player_to_move, engine player_engines[2], engine& referee, versus_sim_result& result);
+    // player_to_move moves first after the opening. Returns the winner (0 or 1), or -1 for a draw, and adds to result's move statistics.
+
+    // Private static methods:
+    static versus_sim_result empty_result();
+    static void add_result(versus_sim_result& total, const versus_sim_result& addition);
+};
+
+// CONSTRUCTORS:
+
+versus_sim::versus_sim(const versus_player& firstP, const versus_player& secondP, int number_of_threadsP)
+{
+    players[0] = firstP;
+    players[1] = secondP;
+
+    number_of_threads = max(1, number_of_threadsP);
+
+    has_sprt = false;
+}
+
+// HELPERS:
+
+versus_sim_result versus_sim::play(const vector<vector<coordinate>>& openings)
+{
+    versus_sim_result result = empty_result();
+
+    mutex result_mutex;
+
+    atomic<int> next_trial(0);
+
+    steady_clock::time_point start_time = steady_clock::now();
+
+    vector<thread> workers;
+
+    for (int t = 0; t < number_of_threads; t++)
+    {
+        workers.push_back(thread(&versus_sim::run_worker, this, cref(openings), ref(next_trial), ref(result), ref(result_mutex)));
+    }
+
+    for (thread& worker: workers)
+    {
+        worker.join();
+    }
+
+    result.seconds = duration_cast<duration<double>>(steady_clock::now() - start_time).count();
+
+    return result;
+}
+
+// SETTERS:
+
+void versus_sim::set_sprt(const sprt_settings& sprt_testP)
+{
+    has_sprt = true;
+
+    sprt_test = sprt_testP;
+}
+
+// PRIVATE METHODS:
+
+void versus_sim::run_worker(const vector<vector<coordinate>>& openings, atomic<int>& next_trial, versus_sim_result& result, mutex& result_mutex)
+{
+    engine player_engines[2];
+
+    engine referee;
+
+    for (int p = 0; p < 2; p++)
+    {
+        player_engines[p].set_settings(players[p].settings);
+        player_engines[p].set_thinking_time(players[p].thinking_time);
+        player_engines[p].set_max_depth_limit(players[p].max_depth_limit);
+        player_engines[p].set_max_nodes_per_move(players[p].max_nodes_per_move);
+        player_engines[p].set_number_of_defence_threads(1); // the other cores are busy with their own games.
+    }
+
+    referee.set_thinking_time(0);
+
+    while (true)
+    {
+        int trial = next_trial++;
+
+        if (trial >= static_cast<int>(openings.size()))
+        {
+            return;
+        }
+
+        {
+            lock_guard<mutex> lock(result_mutex);
+
+            if (result.status != SPRT_UNDECIDED)
+            {
+                return;
+            }
+        }
+
+        versus_sim_result trial_result = empty_result();
+
+        trial_result.trials = 1;
+
+        int first_player_score = 0; // 2 for a win, 1 for a draw.
+
+        for (int player_to_move = 0; player_to_move < 2; player_to_move++)
+        {
+            int winner = play_game(openings[trial], player_to_move, player_engines, referee, trial_result);
+
+            first_player_score += (winner == -1) ? 1 : (winner == 0 ? 2 : 0);
+        }
+
+        trial_result.uneven_trials = (first_player_score != 2) ? 1 : 0;
+
+        trial_result.pentanomial[first_player_score] = 1;
+
+        lock_guard<mutex> lock(result_mutex);
+
+        if (result.status != SPRT_UNDECIDED) // decided while this trial was being played.
+        {
+            return;
+        }
+
+        add_result(result, trial_result);
+
+        if (has_sprt)
+        {
+            result.log_likelihood_ratio = sprt::log_likelihood_ratio(result.pentanomial, sprt_test);
+
+            result.status = sprt::get_status(result.pentanomial, sprt_test);
+        }
+    }
+}
+
+int versus_sim::play_game(const vector<coordinate>& opening, int player_to_move, engine player_engines[2], engine& referee,
+                          versus_sim_result& result)
+{
+    // Like self_play::play_game(), the player who moves first after the opening has the 'C' pieces, and the other player thinks
+    // with the pieces swapped. The referee gets the position after each move, with no thinking (so its endgame solver doesn't run)
+    // and an empty TT (so neither player's TT gets boards from the other's point of view). It's sent with the real turn, since that
+    // decides whose amplifying vectors the move's threats go in.
+
+    unique_ptr<position> pt = referee.think_on_game_position(opening.size() % 2 == 0, true);
+
+    vector<vector<char>> board = pt->get_board();
+
+    for (const coordinate& current_move: opening)
+    {
+        board[current_move.row][current_move.col] = pt->get_is_comp_turn() ? 'C' : 'U';
+
+        pt = referee.think_on_game_position(board, !pt->get_is_comp_turn(), current_move, pt->get_squares_amplifying_comp_2(),
+                                            pt->get_squares_amplifying_comp_3(), pt->get_squares_amplifying_user_2(),
+                                            pt->get_squares_amplifying_user_3(), true);
+    }
+
+    vector<treasure_spot> squares_amplifying_C_2 = pt->get_squares_amplifying_comp_2();
+    vector<treasure_spot> squares_amplifying_C_3 = pt->get_squares_amplifying_comp_3();
+    vector<treasure_spot> squares_amplifying_U_2 = pt->get_squares_amplifying_user_2();
+    vector<treasure_spot> squares_amplifying_U_3 = pt->get_squares_amplifying_user_3();
+
+    coordinate last_move = opening.back();
+
+    bool is_C_turn = true;
+
+    bool has_moved[2] = {false, false}; // each player's TT is reset before their first move of the game.
+
+    while (true)
+    {
+        const int mover = is_C_turn ? player_to_move : 1 - player_to_move;
+
+        engine& mover_engine = player_engines[mover];
+
+        steady_clock::time_point start_time = steady_clock::now();
+
+        unique_ptr<position> root;
+
+        if (is_C_turn)
+        {
+            root = mover_engine.think_on_game_position(board, true, last_move, squares_amplifying_C_2, squares_amplifying_C_3,
+                                                       squares_amplifying_U_2, squares_amplifying_U_3, !has_moved[mover]);
+        }
+
+        else // U's pieces become the comp's pieces:
+        {
+            root = mover_engine.think_on_game_position(self_play::swap_pieces(board), true, last_move, squares_amplifying_U_2,
+                                                       squares_amplifying_U_3, squares_amplifying_C_2, squares_amplifying_C_3,
+                                                       !has_moved[mover]);
+        }
+
+        steady_clock::time_point find_best_move_start_time = steady_clock::now();
+
+        last_move = mover_engine.find_best_move_for_comp(*root);
+
+        steady_clock::time_point end_time = steady_clock::now();
+
+        has_moved[mover] = true;
+
+        double move_time = duration_cast<duration<double>>(end_time - start_time).count();
+        double find_best_move_time = duration_cast<duration<double>>(end_time - find_best_move_start_time).count();
+
+        result.moves_made[mover] ++;
+        result.total_move_time[mover] += move_time;
+        result.max_move_time[mover] = max(result.max_move_time[mover], move_time);
+        result.total_find_best_move_time[mover] += find_best_move_time;
+        result.max_find_best_move_time[mover] = max(result.max_find_best_move_time[mover], find_best_move_time);
+
+        board[last_move.row][last_move.col] = is_C_turn ? 'C' : 'U';
+
+        unique_ptr<position> after_move = referee.think_on_game_position(board, !is_C_turn, last_move, squares_amplifying_C_2,
+                                                                         squares_amplifying_C_3, squares_amplifying_U_2,
+                                                                         squares_amplifying_U_3, true);
+
+        if (after_move->did_computer_win() || after_move->did_opponent_win() || after_move->is_game_drawn())
+        {
+            int length = 0;
+
+            for (const vector<char>& row: board)
+            {
+                length += count_if(row.begin(), row.end(), [](char square) {return square != ' ';});
+            }
+
+            if (after_move->is_game_drawn() && !after_move->did_computer_win() && !after_move->did_opponent_win())
+            {
+                result.draws ++;
+
+                result.total_length_of_drawn_games += length;
+
+                return -1;
+            }
+
+            result.wins[mover] ++; // only the player who just moved can have won.
+
+            result.total_length_of_won_games[mover] += length;
+
+            return mover;
+        }
+
+        squares_amplifying_C_2 = after_move->get_squares_amplifying_comp_2();
+        squares_amplifying_C_3 = after_move->get_squares_amplifying_comp_3();
+        squares_amplifying_U_2 = after_move->get_squares_amplifying_user_2();
+        squares_amplifying_U_3 = after_move->get_squares_amplifying_user_3();
+
+        is_C_turn = !is_C_turn;
+    }
+}
+
+// PRIVATE STATIC METHODS:
+
+versus_sim_result versus_sim::empty_result()
+{
+    versus_sim_result result = {};
+
+    result.status = SPRT_UNDECIDED;
+
+    return result;
+}
+
+void versus_sim::add_result(versus_sim_result& total, const versus_sim_result& addition)
+{
+    total.trials += addition.trials;
+    total.uneven_trials += addition.uneven_trials;
+    total.draws += addition.draws;
+    total.total_length_of_drawn_games += addition.total_length_of_drawn_games;
+
+    for (int i = 0; i < sprt::number_of_pair_scores; i++)
+    {
+        total.pentanomial[i] += addition.pentanomial[i];
+    }
+
+    for (int p = 0; p < 2; p++)
+    {
+        total.wins[p] += addition.wins[p];
+        total.total_length_of_won_games[p] += addition.total_length_of_won_games[p];
+        total.moves_made[p] += addition.moves_made[p];
+        total.total_move_time[p] += addition.total_move_time[p];
+        total.max_move_time[p] = max(total.max_move_time[p], addition.max_move_time[p]);
+        total.total_find_best_move_time[p] += addition.total_find_best_move_time[p];
+        total.max_find_best_move_time[p] = max(total.max_find_best_move_time[p], addition.max_find_best_move_time[p]);
+    }
+}